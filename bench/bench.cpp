@@ -0,0 +1,327 @@
+// vibe_fi_bench: the numbers quoted for the library scanner, the onset detector
+// and the waveform reducer, reproducible on any machine, and the check that
+// drawing the status panel allocates nothing. Built with -DVIBE_FI_BENCH=ON;
+// see --help.
+#include "library_scanner.hpp"
+#include "onset.hpp"
+#include "track_analyzer.hpp"
+#include "waveform.hpp"
+#include "status_line.hpp"
+#include <sys/resource.h>
+#include <unistd.h>
+#include <time.h>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <stdexcept>
+#include <atomic>
+#include <new>
+
+namespace fs = std::filesystem;
+
+// Every heap allocation the process makes, for the frames check
+static std::atomic<size_t> allocations{0};
+
+void* operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* memory = std::malloc(size ? size : 1)) return memory;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    std::free(memory);
+}
+
+// What goes through the pipe from ffmpeg at a time
+static const size_t FEED_SAMPLES = 16384;
+
+struct Options {
+    bool scan = false;
+    bool onset = false;
+    bool waveform = false;
+    bool frames = false;
+    int frame_count = 100000;
+    int max_threads = 0;             // 0: the scanner's default
+    int runs = 3;                    // the best run is reported
+    std::vector<std::string> roots;  // empty: a generated tree
+    int tree[4] = {20, 20, 5, 20};   // artists, albums, discs, tracks per disc
+    double seconds = 240.0;          // length of the synthetic track
+    std::string file;                // also time the ffmpeg decode of this file
+};
+
+static double wall_seconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static double thread_cpu_seconds() {
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static double children_cpu_seconds() {
+    rusage usage;
+    getrusage(RUSAGE_CHILDREN, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+// The library layout the scanner is tuned for: artist/album/disc/track, with a
+// cover next to each disc's tracks
+static size_t generate_tree(const std::string& root, const int shape[4]) {
+    size_t files = 0;
+    char name[64];
+    for (int a = 0; a < shape[0]; ++a) {
+        for (int b = 0; b < shape[1]; ++b) {
+            for (int c = 0; c < shape[2]; ++c) {
+                std::string dir = root + "/artist" + std::to_string(a) + "/album" + std::to_string(b) +
+                                  "/disc" + std::to_string(c);
+                fs::create_directories(dir);
+                for (int t = 0; t < shape[3]; ++t) {
+                    snprintf(name, sizeof(name), "/track%02d.mp3", t);
+                    std::ofstream(dir + name);
+                    files++;
+                }
+                std::ofstream(dir + "/cover.jpg");
+            }
+        }
+    }
+    return files;
+}
+
+static void bench_scan(const Options& options) {
+    std::vector<std::string> roots = options.roots;
+    std::string generated;
+    if (roots.empty()) {
+        char pattern[] = "/tmp/vibe_fi_bench.XXXXXX";
+        if (!mkdtemp(pattern)) throw std::runtime_error("cannot create a directory under /tmp");
+        generated = pattern;
+        double start = wall_seconds();
+        size_t files = generate_tree(generated, options.tree);
+        printf("scan: generated %zu files under %s in %.1f s\n", files, generated.c_str(), wall_seconds() - start);
+        roots.push_back(generated);
+    }
+
+    int max_threads = options.max_threads > 0 ? options.max_threads : LibraryScanner().thread_count();
+    std::vector<int> counts;
+    for (int threads = 1; threads < max_threads; threads *= 2) counts.push_back(threads);
+    counts.push_back(max_threads);
+
+    // A first walk warms the dentry cache, so every run below sees the same one
+    LibraryScanner::Stats expected = LibraryScanner(1).scan(roots, [](const std::vector<LibraryItem>&) {});
+    printf("scan: %zu directories, %zu audio files, best of %d runs\n", expected.directories, expected.files, options.runs);
+    printf("%8s %10s %14s %10s\n", "threads", "ms", "dirs/s", "speedup");
+    double single = 0.0;
+    for (int threads : counts) {
+        LibraryScanner scanner(threads);
+        double best = 1e9;
+        for (int run = 0; run < options.runs; ++run) {
+            double start = wall_seconds();
+            LibraryScanner::Stats stats = scanner.scan(roots, [](const std::vector<LibraryItem>&) {});
+            best = std::min(best, wall_seconds() - start);
+            if (stats.files != expected.files) {
+                fprintf(stderr, "scan: %d threads found %zu files, not %zu\n", threads, stats.files, expected.files);
+            }
+        }
+        if (threads == 1) single = best;
+        printf("%8d %10.1f %14.0f %9.2fx\n", threads, best * 1000.0, expected.directories / best,
+               single > 0.0 ? single / best : 1.0);
+    }
+    if (!generated.empty()) fs::remove_all(generated);
+}
+
+// Clicks at 120 BPM over quiet noise, so the detector has beats to find and
+// the spectrum is never empty
+static std::vector<int16_t> synthetic_track(double seconds) {
+    int rate = TrackAnalyzer::SAMPLE_RATE;
+    std::vector<int16_t> samples(static_cast<size_t>(seconds * rate));
+    uint32_t noise = 12345;
+    int beat = rate / 2;
+    for (size_t i = 0; i < samples.size(); ++i) {
+        noise = noise * 1664525u + 1013904223u;
+        double value = (static_cast<int32_t>(noise >> 16) - 32768) / 32768.0 * 0.02;
+        size_t since = i % beat;
+        if (since < 400) value += std::exp(-since / 60.0) * std::sin(i * 0.9) * 0.8;
+        samples[i] = static_cast<int16_t>(std::max(-1.0, std::min(1.0, value)) * 32767.0);
+    }
+    return samples;
+}
+
+// CPU seconds `consume` takes over the whole track, fed the way the decode pipe delivers it
+template <typename Consume>
+static double time_feed(const std::vector<int16_t>& samples, int runs, Consume consume) {
+    double best = 1e9;
+    for (int run = 0; run < runs; ++run) {
+        double start = thread_cpu_seconds();
+        consume(samples);
+        best = std::min(best, thread_cpu_seconds() - start);
+    }
+    return best;
+}
+
+static void bench_onset(const Options& options, const std::vector<int16_t>& samples) {
+    double bpm = 0.0;
+    double cpu = time_feed(samples, options.runs, [&](const std::vector<int16_t>& audio) {
+        OnsetDetector detector;
+        for (size_t at = 0; at < audio.size(); at += FEED_SAMPLES) {
+            detector.feed(audio.data() + at, std::min(FEED_SAMPLES, audio.size() - at));
+        }
+        bpm = detector.finish().bpm;
+    });
+    printf("onset: %.0f s track at %d Hz: %.1f ms CPU, %.4f%% of a core over the track's length, %.1f BPM found (120 expected)\n",
+           options.seconds, TrackAnalyzer::SAMPLE_RATE, cpu * 1000.0, cpu / options.seconds * 100.0, bpm);
+}
+
+static void bench_waveform(const Options& options, const std::vector<int16_t>& samples) {
+    double cpu = time_feed(samples, options.runs, [&](const std::vector<int16_t>& audio) {
+        WaveformReducer reducer(TrackAnalyzer::SAMPLE_RATE);
+        for (size_t at = 0; at < audio.size(); at += FEED_SAMPLES) {
+            reducer.feed(audio.data() + at, std::min(FEED_SAMPLES, audio.size() - at));
+        }
+        if (reducer.finish().size() != WaveformReducer::SLICES) throw std::runtime_error("waveform: no slices");
+    });
+    printf("waveform: %.0f s track: %.2f ms CPU, %.0f tracks/s/core\n", options.seconds, cpu * 1000.0, 1.0 / cpu);
+}
+
+// What the UI does for the status panel and the message line every frame:
+// a track with a waveform, a resize, a track without one, messages coming
+// and going. None of it may touch the heap.
+static void bench_frames(const Options& options) {
+    std::vector<uint8_t> levels(WaveformReducer::SLICES);
+    for (size_t i = 0; i < levels.size(); ++i) levels[i] = static_cast<uint8_t>(i * 7 % 256);
+    const std::vector<uint8_t> none;
+    const char* wave_glyphs = "_.-=#";
+    const char* titles[] = {"Artist - A Track With A Waveform", "Artist - A Stream Still Being Measured"};
+    const std::string posted[] = {"Shuffle: ON", "Playlist 'road trip' saved with 214 tracks, 3 skipped as unavailable"};
+
+    StatusLine line;
+    MessageRing messages;
+    auto now = std::chrono::steady_clock::now();
+    size_t shown = 0;
+    size_t before = allocations.load();
+    double start = thread_cpu_seconds();
+    for (int frame = 0; frame < options.frame_count; ++frame) {
+        bool second_half = frame >= options.frame_count / 2;
+        int width = frame < options.frame_count / 4 ? 120 : 100;
+        double position = (frame % 14400) / 60.0;
+        line.update(width, titles[second_half], position, 240.0, second_half ? none : levels, wave_glyphs, '=',
+                    second_half ? 0 : 128, 80);
+        if (frame % 500 == 0) messages.push(posted[(frame / 500) % 2]);
+        now += std::chrono::microseconds(16667);
+        if (messages.current(now)) shown++;
+    }
+    double cpu = thread_cpu_seconds() - start;
+    size_t made = allocations.load() - before;
+    printf("frames: %d status updates and message reads, %zu with a message: %zu heap allocations, %.0f ns/frame\n",
+           options.frame_count, shown, made, cpu / options.frame_count * 1e9);
+    if (made != 0) throw std::runtime_error("frames: drawing allocated");
+}
+
+// One decode feeding everything, against a decode per analysis as it used to
+// be: onsets and waveform each from their own samples, loudness with -f null
+static void bench_decode(const Options& options) {
+    auto decode = [&](bool samples, bool loudness) {
+        OnsetDetector detector;
+        WaveformReducer reducer(TrackAnalyzer::SAMPLE_RATE);
+        TrackAnalysis measured;
+        TrackAnalyzer::Samples feed;
+        if (samples) {
+            feed = [&](const int16_t* data, size_t count) {
+                detector.feed(data, count);
+                reducer.feed(data, count);
+            };
+        }
+        return TrackAnalyzer::decode(options.file, feed, loudness ? &measured : nullptr);
+    };
+    auto report = [](const char* label, double wall, double cpu, bool ok) {
+        printf("decode: %-28s %8.0f ms wall %8.0f ms ffmpeg CPU%s\n", label, (wall_seconds() - wall) * 1000.0,
+               (children_cpu_seconds() - cpu) * 1000.0, ok ? "" : "  (ffmpeg failed)");
+    };
+
+    double wall = wall_seconds();
+    double cpu = children_cpu_seconds();
+    bool ok = decode(true, false);
+    ok = decode(true, false) && ok;
+    ok = decode(false, true) && ok;
+    report("one run per analysis (3)", wall, cpu, ok);
+
+    wall = wall_seconds();
+    cpu = children_cpu_seconds();
+    ok = decode(true, true);
+    report("one run for all", wall, cpu, ok);
+}
+
+static void usage() {
+    printf("usage: vibe_fi_bench [scan] [onset] [waveform] [frames] [options]   (all if none is named)\n"
+           "  --threads N        scan with 1, 2, 4 ... N threads (default: the scanner's default)\n"
+           "  --root PATH        scan PATH instead of a generated tree; repeat for several roots\n"
+           "  --tree A,B,C,T     generated tree: A artists x B albums x C discs x T tracks (default 20,20,5,20)\n"
+           "  --seconds S        length of the synthetic track (default 240)\n"
+           "  --file PATH        also time ffmpeg decoding PATH once for everything vs once per analysis\n"
+           "  --runs N           runs per measurement, best reported (default 3)\n"
+           "  --frames N         status panel frames to draw, failing on any allocation (default 100000)\n");
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "scan") {
+            options.scan = true;
+        } else if (arg == "onset") {
+            options.onset = true;
+        } else if (arg == "waveform") {
+            options.waveform = true;
+        } else if (arg == "frames") {
+            options.frames = true;
+        } else if (arg == "--frames" && has_value) {
+            options.frame_count = std::max(1, atoi(argv[++i]));
+        } else if (arg == "--threads" && has_value) {
+            options.max_threads = std::max(1, atoi(argv[++i]));
+        } else if (arg == "--root" && has_value) {
+            options.roots.push_back(argv[++i]);
+        } else if (arg == "--tree" && has_value) {
+            if (sscanf(argv[++i], "%d,%d,%d,%d", &options.tree[0], &options.tree[1], &options.tree[2], &options.tree[3]) != 4) {
+                usage();
+                return 1;
+            }
+        } else if (arg == "--seconds" && has_value) {
+            options.seconds = std::max(1.0, atof(argv[++i]));
+        } else if (arg == "--file" && has_value) {
+            options.file = argv[++i];
+        } else if (arg == "--runs" && has_value) {
+            options.runs = std::max(1, atoi(argv[++i]));
+        } else {
+            usage();
+            return arg == "--help" || arg == "-h" ? 0 : 1;
+        }
+    }
+    if (!options.scan && !options.onset && !options.waveform && !options.frames) {
+        options.scan = options.onset = options.waveform = options.frames = true;
+    }
+
+    try {
+        printf("%ld cores online\n", sysconf(_SC_NPROCESSORS_ONLN));
+        if (options.scan) bench_scan(options);
+        if (options.onset || options.waveform) {
+            std::vector<int16_t> samples = synthetic_track(options.seconds);
+            if (options.onset) bench_onset(options, samples);
+            if (options.waveform) bench_waveform(options, samples);
+        }
+        if (options.frames) bench_frames(options);
+        if (!options.file.empty()) bench_decode(options);
+    } catch (const std::exception& e) {
+        fprintf(stderr, "vibe_fi_bench: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,145 @@
+#include "audio_cache.hpp"
+#include "utils.hpp"
+#include <filesystem>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdio>
+
+namespace fs = std::filesystem;
+
+AudioCache::AudioCache() : max_bytes(0), hits(0), misses(0) {
+    cache_dir = get_vibe_dir() + "/cache";
+
+    const char* cap = getenv("VIBE_FI_AUDIO_CACHE_MB");
+    if (cap) {
+        try {
+            long long mb = std::stoll(cap);
+            if (mb > 0) max_bytes = static_cast<uint64_t>(mb) * 1024 * 1024;
+        } catch (...) {
+            max_bytes = 0;
+        }
+    }
+}
+
+bool AudioCache::enabled() const {
+    return max_bytes > 0;
+}
+
+std::string AudioCache::entry_path(const std::string& webpage_url) {
+    // Matroska takes whatever codec YouTube hands out (opus, aac, vorbis)
+    return cache_dir + "/" + hash_hex(webpage_url) + ".mka";
+}
+
+std::string AudioCache::lookup(const std::string& webpage_url) {
+    if (!enabled()) return "";
+    std::lock_guard<std::mutex> lock(mutex);
+
+    std::string path = entry_path(webpage_url);
+    std::error_code ec;
+    if (fs::exists(path, ec) && fs::file_size(path, ec) > 0) {
+        // mtime doubles as the LRU clock
+        fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+        hits++;
+        return path;
+    }
+    misses++;
+    return "";
+}
+
+bool AudioCache::contains(const std::string& webpage_url) {
+    if (!enabled()) return false;
+    std::error_code ec;
+    return fs::exists(entry_path(webpage_url), ec);
+}
+
+std::string AudioCache::cached_path(const std::string& webpage_url) {
+    return contains(webpage_url) ? entry_path(webpage_url) : "";
+}
+
+std::string AudioCache::recording_path(const std::string& webpage_url) {
+    std::error_code ec;
+    fs::create_directories(cache_dir, ec);
+    // mpv's recorder picks the container from the extension, so it has to stay last
+    return cache_dir + "/" + hash_hex(webpage_url) + ".part.mka";
+}
+
+void AudioCache::commit(const std::string& webpage_url) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::string part = recording_path(webpage_url);
+    std::error_code ec;
+    if (!fs::exists(part, ec) || fs::file_size(part, ec) == 0) {
+        fs::remove(part, ec);
+        return;
+    }
+    fs::rename(part, entry_path(webpage_url), ec);
+    evict();
+}
+
+void AudioCache::discard(const std::string& webpage_url) {
+    std::error_code ec;
+    fs::remove(recording_path(webpage_url), ec);
+}
+
+bool AudioCache::insert(const std::string& webpage_url, const std::string& file_path) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::error_code ec;
+    fs::create_directories(cache_dir, ec);
+    fs::rename(file_path, entry_path(webpage_url), ec);
+    if (ec) return false;
+    evict();
+    return true;
+}
+
+uint64_t AudioCache::disk_usage() {
+    uint64_t total = 0;
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(cache_dir, ec)) {
+        if (entry.is_regular_file(ec)) total += entry.file_size(ec);
+    }
+    return total;
+}
+
+void AudioCache::evict() {
+    struct Entry {
+        fs::path path;
+        uint64_t size;
+        fs::file_time_type mtime;
+    };
+    std::vector<Entry> entries;
+    uint64_t total = 0;
+    std::error_code ec;
+
+    for (const auto& entry : fs::directory_iterator(cache_dir, ec)) {
+        // Recordings in progress end in .part.mka; only committed entries count
+        if (!entry.is_regular_file(ec) || entry.path().extension() != ".mka" ||
+            entry.path().stem().extension() == ".part") continue;
+        Entry e{entry.path(), entry.file_size(ec), entry.last_write_time(ec)};
+        total += e.size;
+        entries.push_back(e);
+    }
+    if (total <= max_bytes) return;
+
+    // Least recently played first
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.mtime < b.mtime;
+    });
+    for (const auto& e : entries) {
+        if (total <= max_bytes) break;
+        if (fs::remove(e.path, ec)) total -= e.size;
+    }
+}
+
+std::string AudioCache::stats() {
+    if (!enabled()) return "Audio cache is off (set VIBE_FI_AUDIO_CACHE_MB)";
+    uint64_t usage = disk_usage();
+    std::lock_guard<std::mutex> lock(mutex);
+
+    int lookups = hits + misses;
+    int rate = lookups > 0 ? (hits * 100) / lookups : 0;
+    char buffer[128];
+    snprintf(buffer, sizeof(buffer), "Cache: %d/%d hits (%d%%), %.1f of %llu MB",
+             hits, lookups, rate, usage / (1024.0 * 1024.0),
+             static_cast<unsigned long long>(max_bytes / (1024 * 1024)));
+    return std::string(buffer);
+}
@@ -0,0 +1,47 @@
+#ifndef AUDIO_CACHE_HPP
+#define AUDIO_CACHE_HPP
+
+#include <string>
+#include <cstdint>
+#include <mutex>
+
+// Size-capped LRU cache of streamed audio under ~/.vibe-fi/cache, keyed by the
+// webpage URL. Opt-in: enabled by VIBE_FI_AUDIO_CACHE_MB=<cap in megabytes>.
+// Thread-safe; background downloads insert while the UI looks up.
+class AudioCache {
+public:
+    AudioCache();
+
+    bool enabled() const;
+
+    // Path of the cached audio for this URL, or "" on a miss. Counts towards the hit rate.
+    std::string lookup(const std::string& webpage_url);
+    // Same, without touching the LRU clock or the statistics
+    bool contains(const std::string& webpage_url);
+    std::string cached_path(const std::string& webpage_url);
+
+    // Where mpv should record the stream while it plays: <hash>.part.mka, renamed on commit
+    std::string recording_path(const std::string& webpage_url);
+
+    // A recorded stream played through: move it into the cache and evict down to the cap
+    void commit(const std::string& webpage_url);
+    void discard(const std::string& webpage_url);
+
+    // Adds an already complete file (e.g. a background download) under this URL
+    bool insert(const std::string& webpage_url, const std::string& file_path);
+
+    uint64_t disk_usage();
+    std::string stats();
+
+private:
+    std::string cache_dir;
+    uint64_t max_bytes;
+    int hits;
+    int misses;
+    std::mutex mutex;
+
+    std::string entry_path(const std::string& webpage_url);
+    void evict();
+};
+
+#endif // AUDIO_CACHE_HPP
@@ -0,0 +1,508 @@
+#include "daemon.hpp"
+#include "utils.hpp"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <csignal>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <thread>
+#include <stdexcept>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+#ifdef MSG_NOSIGNAL
+static const int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+static const int SEND_FLAGS = 0;
+#endif
+
+// A client that sends this much without a newline is dropped
+static const size_t MAX_LINE = 64 * 1024;
+// And so is one that leaves this much of its replies unread
+static const size_t MAX_OUTPUT = 8 * 1024 * 1024;
+
+static volatile sig_atomic_t stop_received = 0;
+
+static void on_stop_signal(int) {
+    stop_received = 1;
+}
+
+static bool send_line(int fd, const std::string& line) {
+    std::string data = line + "\n";
+    const char* p = data.data();
+    size_t left = data.size();
+    while (left > 0) {
+        ssize_t sent = send(fd, p, left, SEND_FLAGS);
+        if (sent <= 0) return false;
+        p += sent;
+        left -= static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+static sockaddr_un socket_address(const std::string& path) {
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) throw std::runtime_error("socket path too long: " + path);
+    memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return addr;
+}
+
+static int connect_socket(const std::string& path) {
+    sockaddr_un addr = socket_address(path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static std::string ok_json() {
+    return "{\"ok\":true}";
+}
+
+static std::string error_json(const std::string& message) {
+    return "{\"ok\":false,\"error\":" + json_quote(message) + "}";
+}
+
+std::string Daemon::socket_path() {
+    const char* path = getenv("VIBE_FI_SOCKET");
+    if (path && *path) return path;
+    return get_vibe_dir() + "/daemon.sock";
+}
+
+Daemon::Daemon(Player& p)
+    : player(p), warmer(stream_resolver, audio_cache, 1), stream_proxy(stream_resolver, audio_cache),
+      loudness(library_index, false), current(-1), failures(0), listen_fd(-1), running(true) {}
+
+Daemon::~Daemon() {
+    for (auto& client : clients) close(client.fd);
+    if (listen_fd >= 0) {
+        close(listen_fd);
+        unlink(socket_path().c_str());
+    }
+}
+
+void Daemon::open_socket() {
+    std::string path = socket_path();
+    std::error_code ec;
+    fs::create_directories(fs::path(path).parent_path(), ec);
+
+    // A socket file nobody answers on is left over from a crash
+    int existing = connect_socket(path);
+    if (existing >= 0) {
+        close(existing);
+        throw std::runtime_error("a daemon is already listening on " + path);
+    }
+    unlink(path.c_str());
+
+    sockaddr_un addr = socket_address(path);
+    listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0) throw std::runtime_error("socket() failed");
+    fcntl(listen_fd, F_SETFD, FD_CLOEXEC);
+    // Only this user may control the player
+    mode_t old_mask = umask(077);
+    int status = bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    umask(old_mask);
+    if (status != 0 || listen(listen_fd, 16) != 0) {
+        close(listen_fd);
+        listen_fd = -1;
+        throw std::runtime_error("cannot listen on " + path);
+    }
+}
+
+void Daemon::run() {
+    open_socket();
+
+    struct sigaction stop = {};
+    stop.sa_handler = on_stop_signal;
+    sigemptyset(&stop.sa_mask);
+    sigaction(SIGINT, &stop, nullptr);
+    sigaction(SIGTERM, &stop, nullptr);
+
+    int wakeup = player.wakeup_fd();
+    events.listen_on(EventHub::socket_path());
+
+    std::vector<pollfd> fds;
+    while (running && !stop_received) {
+        fds.clear();
+        fds.push_back({listen_fd, POLLIN, 0});
+        fds.push_back({wakeup, POLLIN, 0});
+        // Clients with replies still to go wait for room; one about to subscribe only for that
+        for (const auto& client : clients) {
+            short wanted = client.subscribe_interval >= 0 ? POLLOUT : client.output.empty() ? POLLIN : POLLIN | POLLOUT;
+            fds.push_back({client.fd, wanted, 0});
+        }
+        size_t client_end = fds.size();
+        events.add_pollfds(fds);
+
+        // Asleep until something happens, apart from a stream URL being resolved,
+        // a seek held back behind the previous one, or a subscriber's next position update
+        int timeout = events.next_due_ms();
+        if ((resolving.valid() || player.seek_pending()) && (timeout < 0 || timeout > 100)) timeout = 100;
+        if (poll(fds.data(), fds.size(), timeout) < 0 && errno != EINTR) break;
+
+        if (fds[1].revents) {
+            player.clear_wakeup();
+            process_player_events();
+        }
+        poll_resolving();
+
+        // Clients were polled in order; walk back so erasing keeps indices valid
+        for (size_t i = client_end; i-- > 2;) {
+            Client& client = clients[i - 2];
+            short revents = fds[i].revents;
+            if (!revents) continue;
+            bool keep = true;
+            if (revents & POLLOUT) keep = flush_client(client);
+            if (keep && client.subscribe_interval < 0 && (revents & ~POLLOUT)) keep = read_client(client);
+            if (keep && client.subscribe_interval >= 0 && client.output.empty()) {
+                // Everything it asked for is out; from here on it only gets events
+                events.add(client.fd, client.subscribe_interval);
+                client.fd = -1;
+                keep = false;
+            }
+            if (!keep) {
+                if (client.fd >= 0) close(client.fd);
+                clients.erase(clients.begin() + (i - 2));
+            }
+        }
+        if (fds[0].revents & POLLIN) accept_client();
+        // Seeks from every command this round go out as one
+        player.flush_seek();
+
+        // One position read serves every subscriber that is due
+        events.poll();
+        if (events.position_due()) events.position(player.get_display_position(), player.get_duration());
+        // Where the track was when the loop last woke, in case it is the last word on it
+        if (current != -1 && !resolving.valid()) history.update(player.get_position(), player.get_duration());
+    }
+    history.update(player.get_position(), player.get_duration());
+    history.end();
+}
+
+void Daemon::accept_client() {
+    int fd = accept(listen_fd, nullptr, nullptr);
+    if (fd < 0) return;
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    // Never blocks the loop: a client that does not read has its replies held back
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    clients.push_back({fd, "", "", -1});
+}
+
+bool Daemon::read_client(Client& client) {
+    char buffer[4096];
+    ssize_t n = recv(client.fd, buffer, sizeof(buffer), 0);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+    if (n <= 0) return false;
+    client.input.append(buffer, n);
+
+    size_t newline;
+    while ((newline = client.input.find('\n')) != std::string::npos) {
+        std::string line = client.input.substr(0, newline);
+        client.input.erase(0, newline + 1);
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (!line.empty()) handle_command(client, line);
+        if (client.fd < 0) return false; // Its replies could not be sent
+        if (client.subscribe_interval >= 0) break; // Anything after is for the event hub
+    }
+    return client.input.size() <= MAX_LINE;
+}
+
+void Daemon::reply(Client& client, const std::string& json) {
+    if (client.fd < 0) return;
+    client.output += json;
+    client.output += '\n';
+    if (!flush_client(client)) {
+        close(client.fd);
+        client.fd = -1;
+    }
+}
+
+bool Daemon::flush_client(Client& client) {
+    while (!client.output.empty()) {
+        ssize_t sent = send(client.fd, client.output.data(), client.output.size(), SEND_FLAGS);
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (sent <= 0) return false;
+        client.output.erase(0, static_cast<size_t>(sent));
+    }
+    return client.output.size() <= MAX_OUTPUT;
+}
+
+void Daemon::handle_command(Client& client, const std::string& line) {
+    // "<command> [argument]"; the argument is the rest of the line, spaces and all
+    size_t space = line.find(' ');
+    std::string command = line.substr(0, space);
+    std::string arg = space == std::string::npos ? "" : line.substr(space + 1);
+
+    try {
+        if (command == "play" && !arg.empty()) {
+            queue.assign(1, arg);
+            order.reset(1, 0);
+            start(0);
+        } else if (command == "play" || command == "resume") {
+            player.play();
+        } else if (command == "enqueue" && !arg.empty()) {
+            enqueue(arg);
+        } else if (command == "pause") {
+            player.pause();
+        } else if (command == "toggle") {
+            player.toggle_pause();
+        } else if (command == "next" || command == "prev") {
+            int index = command == "next" ? order.skip() : order.previous();
+            if (index == -1) {
+                reply(client, error_json("no " + command + " track"));
+                return;
+            }
+            start(index);
+        } else if (command == "stop") {
+            resolving = std::future<std::string>();
+            current = -1;
+            history.update(player.get_position(), player.get_duration());
+            history.end();
+            player.stop();
+        } else if (command == "seek" && !arg.empty()) {
+            // "<±seconds>", "@<seconds>" or "<percent>%", optionally followed by "exact"
+            std::istringstream words(arg);
+            std::string target, precision;
+            words >> target >> precision;
+            SeekMode mode = SeekMode::RELATIVE;
+            if (!target.empty() && target[0] == '@') {
+                mode = SeekMode::ABSOLUTE;
+                target.erase(0, 1);
+            } else if (!target.empty() && target.back() == '%') {
+                mode = SeekMode::PERCENT;
+                target.pop_back();
+            }
+            player.seek(std::stod(target), mode, precision == "exact" ? SeekPrecision::EXACT : SeekPrecision::KEYFRAMES);
+        } else if (command == "shuffle") {
+            // "shuffle [on|off]"; toggles without an argument
+            order.set_shuffle(arg.empty() ? !order.shuffle() : arg == "on");
+            prefetch_next();
+        } else if (command == "repeat" && (arg == "off" || arg == "all" || arg == "one")) {
+            order.set_repeat(arg == "all" ? RepeatMode::ALL : arg == "one" ? RepeatMode::ONE : RepeatMode::OFF);
+            prefetch_next();
+        } else if (command == "volume" && !arg.empty()) {
+            player.set_volume(std::max(0, std::min(100, std::stoi(arg))));
+        } else if (command == "status") {
+            reply(client, status_json());
+            return;
+        } else if (command == "queue") {
+            std::string json = "{\"ok\":true,\"current\":" + std::to_string(current) + ",\"queue\":[";
+            for (size_t i = 0; i < queue.size(); ++i) json += (i ? "," : "") + json_quote(queue[i]);
+            reply(client, json + "]}");
+            return;
+        } else if (command == "subscribe") {
+            // "subscribe [seconds]": position events every N seconds, 0 for none
+            // The event hub takes the socket once the replies before it are out
+            int interval = arg.empty() ? 1 : std::stoi(arg);
+            reply(client, ok_json());
+            client.subscribe_interval = std::max(0, interval);
+            return;
+        } else if (command == "quit") {
+            running = false;
+        } else {
+            reply(client, error_json("unknown command: " + line));
+            return;
+        }
+        reply(client, ok_json());
+    } catch (const std::exception& e) {
+        reply(client, error_json(e.what()));
+    }
+}
+
+void Daemon::enqueue(const std::string& input) {
+    queue.push_back(input);
+    order.append();
+    // Joining an idle player starts right away; otherwise it may be next up
+    int index = static_cast<int>(queue.size()) - 1;
+    if (current == -1) {
+        order.jump(index);
+        start(index);
+    } else if (order.peek_next() == index) {
+        prefetch_next();
+    }
+}
+
+void Daemon::start(int index) {
+    current = index;
+    resolving = std::future<std::string>();
+    const std::string& input = queue[index];
+    title = is_url(input) ? input : fs::path(input).filename().string();
+    history.update(player.get_position(), player.get_duration());
+    history.begin(input, title, is_url(input) ? PlaySource::STREAM : PlaySource::LOCAL);
+
+    // Local files, cached downloads and prefetched stream URLs load right away
+    std::string cached = is_url(input) ? audio_cache.lookup(input) : input;
+    // Measured once, so later plays start at the target loudness
+    loudness.request(input, cached);
+    ResolvedStream stream;
+    if (cached.empty() && stream_resolver.lookup(input, stream)) {
+        cached = stream_proxy.enabled() ? stream_proxy.register_track(input, stream.stream_url) : "";
+        if (cached.empty()) cached = stream.stream_url;
+    }
+    if (!cached.empty()) {
+        load(cached);
+        return;
+    }
+
+    // Resolved off the loop so clients stay responsive; a newer start() drops the result
+    auto promise = std::make_shared<std::promise<std::string>>();
+    resolving = promise->get_future();
+    std::thread([promise, input]() {
+        try {
+            promise->set_value(get_youtube_stream_url(input));
+        } catch (...) {
+            promise->set_exception(std::current_exception());
+        }
+    }).detach();
+}
+
+void Daemon::poll_resolving() {
+    if (!resolving.valid() || resolving.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return;
+    try {
+        ResolvedStream stream;
+        stream.stream_url = resolving.get();
+        stream.expires = StreamResolver::parse_expiry(stream.stream_url);
+        stream_resolver.remember(queue[current], stream);
+        const std::string& stream_url = stream.stream_url;
+        std::string proxied = stream_proxy.enabled() ? stream_proxy.register_track(queue[current], stream_url) : "";
+        load(proxied.empty() ? stream_url : proxied);
+    } catch (const std::exception& e) {
+        events.publish("{\"event\":\"error\",\"index\":" + std::to_string(current) + ",\"error\":" + json_quote(e.what()) + "}");
+        advance(true);
+    }
+}
+
+void Daemon::advance(bool failed) {
+    // On repeat, a queue where nothing plays would otherwise go round forever;
+    // a failed track is skipped even on repeat-one
+    failures = failed ? failures + 1 : 0;
+    int next = -1;
+    if (failures < static_cast<int>(queue.size())) next = failed ? order.skip() : order.next();
+    if (next == -1) {
+        current = -1;
+        failures = 0;
+        return;
+    }
+    start(next);
+}
+
+void Daemon::load(const std::string& url) {
+    double gain = 0.0;
+    loudness.gain_for(queue[current], gain);
+    player.set_gain(gain);
+    player.load(url);
+    player.set_property("force-media-title", title);
+    player.play();
+    events.track(title, 0.0); // Duration follows with the position events
+    prefetch_next();
+}
+
+void Daemon::prefetch_next() {
+    // The next stream URL is resolved, or the next local file measured, while this track plays
+    int next = order.peek_next();
+    if (current == -1 || next == -1 || next == current) return;
+    if (!is_url(queue[next])) {
+        loudness.request(queue[next], queue[next]);
+        return;
+    }
+    warmer.warm({PlaylistSong(queue[next], queue[next], 0)}, false);
+}
+
+void Daemon::process_player_events() {
+    PlayerEvent event;
+    while (player.poll_event(event)) {
+        if (event.type == PlayerEventType::FILE_ENDED) {
+            // Replacing a track ends the old one too, but not with eof or error
+            if (!(event.eof || event.error) || resolving.valid()) continue;
+            history.end(event.eof);
+            advance(event.error);
+        } else if (event.type == PlayerEventType::PAUSE_CHANGED) {
+            history.set_paused(event.paused);
+            events.paused(event.paused);
+        } else if (event.type == PlayerEventType::IDLE) {
+            if (current == -1) events.publish("{\"event\":\"idle\"}");
+        }
+    }
+}
+
+std::string Daemon::status_json() {
+    const char* state = player.is_idle() ? "idle" : player.is_paused() ? "paused" : "playing";
+    if (resolving.valid()) state = "loading";
+    const char* repeat = order.repeat() == RepeatMode::ALL ? "all" : order.repeat() == RepeatMode::ONE ? "one" : "off";
+
+    // The daemon's own footprint, so idle cost can be watched from outside
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    long cpu_ms = (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000 +
+                  (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000;
+    long rss_kb = 0;
+    std::ifstream statm("/proc/self/statm");
+    long pages_total, pages_resident;
+    if (statm >> pages_total >> pages_resident) rss_kb = pages_resident * (sysconf(_SC_PAGESIZE) / 1024);
+
+    char numbers[160];
+    snprintf(numbers, sizeof(numbers), "\"position\":%.1f,\"duration\":%.1f,\"volume\":%d,\"cpu_ms\":%ld,\"rss_kb\":%ld",
+             player.get_display_position(), player.get_duration(), player.get_volume(), cpu_ms, rss_kb);
+    return std::string("{\"ok\":true,\"state\":\"") + state + "\",\"title\":" + json_quote(current == -1 ? "" : title) +
+           ",\"index\":" + std::to_string(current) + ",\"queue\":" + std::to_string(queue.size()) +
+           ",\"shuffle\":" + (order.shuffle() ? "true" : "false") + ",\"repeat\":\"" + repeat + "\"," + numbers + "}";
+}
+
+int run_control_client(const std::vector<std::string>& words) {
+    if (words.empty()) {
+        fprintf(stderr, "usage: vibe_fi --ctl <play|enqueue|pause|resume|toggle|next|prev|stop|seek|shuffle|repeat|volume|status|queue|subscribe|quit> [argument]\n");
+        return 2;
+    }
+    std::string path = Daemon::socket_path();
+    int fd = connect_socket(path);
+    if (fd < 0) {
+        fprintf(stderr, "vibe-fi: no daemon listening on %s\n", path.c_str());
+        return 1;
+    }
+
+    std::string line;
+    for (size_t i = 0; i < words.size(); ++i) line += (i ? " " : "") + words[i];
+    if (!send_line(fd, line)) {
+        close(fd);
+        return 1;
+    }
+
+    // One reply line, or for "subscribe" the reply and then events until the daemon closes
+    bool follow = words[0] == "subscribe";
+    std::string pending;
+    char buffer[4096];
+    int status = 1;
+    bool replied = false;
+    ssize_t n;
+    while ((n = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+        pending.append(buffer, n);
+        size_t newline;
+        bool done = false;
+        while ((newline = pending.find('\n')) != std::string::npos) {
+            std::string reply = pending.substr(0, newline);
+            pending.erase(0, newline + 1);
+            printf("%s\n", reply.c_str());
+            fflush(stdout);
+            if (!replied) status = reply.find("\"ok\":true") != std::string::npos ? 0 : 1;
+            replied = true;
+            done = !follow;
+        }
+        if (done) break;
+    }
+    close(fd);
+    return status;
+}
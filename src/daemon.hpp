@@ -0,0 +1,85 @@
+#ifndef DAEMON_HPP
+#define DAEMON_HPP
+
+#include "player.hpp"
+#include "audio_cache.hpp"
+#include "stream_resolver.hpp"
+#include "playlist_warmer.hpp"
+#include "stream_proxy.hpp"
+#include "event_hub.hpp"
+#include "library_index.hpp"
+#include "track_analyzer.hpp"
+#include "play_queue.hpp"
+#include "play_history.hpp"
+#include <string>
+#include <vector>
+#include <future>
+
+// Headless player for `vibe_fi --daemon`: mpv, a play queue with autoplay and
+// prefetching of the next stream, and no curses at all. It is driven over a
+// Unix socket, one command per line; every reply and event is one JSON object
+// per line. The loop sleeps in poll() until a client, mpv or a resolve needs it.
+class Daemon {
+public:
+    Daemon(Player& player);
+    ~Daemon();
+
+    void enqueue(const std::string& input);
+    // Returns when a client sends "quit" or on SIGINT/SIGTERM
+    void run();
+
+    // VIBE_FI_SOCKET, or ~/.vibe-fi/daemon.sock
+    static std::string socket_path();
+
+private:
+    struct Client {
+        int fd;
+        std::string input;       // bytes after the last complete line
+        std::string output;      // replies the socket has not taken yet
+        int subscribe_interval;  // -1, or "subscribe" was sent and the event hub takes over
+    };
+
+    Player& player;
+    AudioCache audio_cache;
+    StreamResolver stream_resolver;
+    PlaylistWarmer warmer;
+    StreamProxy stream_proxy;
+    LibraryIndex library_index;
+    TrackAnalyzer loudness; // no waveforms without a seek bar
+    EventHub events; // "subscribe" clients move here
+    PlayHistory history;
+
+    std::vector<std::string> queue; // local paths and URLs, in the order added
+    PlayQueue order;                 // shuffle, repeat and history over the queue
+    int current;                     // queue index playing or being resolved, -1 if none
+    int failures;                    // tracks in a row that would not play
+    std::future<std::string> resolving;
+    std::string title;
+
+    int listen_fd;
+    std::vector<Client> clients;
+    bool running;
+
+    void open_socket();
+    void accept_client();
+    bool read_client(Client& client);
+    void handle_command(Client& client, const std::string& line);
+    void reply(Client& client, const std::string& json);
+    // False if the client is gone or too far behind
+    bool flush_client(Client& client);
+
+    void start(int index);
+    void load(const std::string& url);
+    void poll_resolving();
+    // After a track ends or fails: the next one in order, or stop
+    void advance(bool failed);
+    void process_player_events();
+    void prefetch_next();
+    std::string status_json();
+};
+
+// `vibe_fi --ctl <command...>`: sends one command to the daemon and prints the
+// reply. "subscribe" keeps printing events until the daemon goes away.
+int run_control_client(const std::vector<std::string>& words);
+
+#endif // DAEMON_HPP
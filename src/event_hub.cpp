@@ -0,0 +1,212 @@
+#include "event_hub.hpp"
+#include "utils.hpp"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+#ifdef MSG_NOSIGNAL
+static const int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+static const int SEND_FLAGS = 0;
+#endif
+
+// Position events go out this often unless a subscriber asks otherwise
+static const int DEFAULT_INTERVAL_S = 1;
+
+EventHub::EventHub() : listen_fd(-1), epoch(std::chrono::steady_clock::now()), last_pause(-1), last_lyric(-1) {}
+
+EventHub::~EventHub() {
+    for (auto& subscriber : subscribers) close(subscriber.fd);
+    if (listen_fd >= 0) {
+        close(listen_fd);
+        unlink(listen_path.c_str());
+    }
+}
+
+std::string EventHub::socket_path() {
+    const char* path = getenv("VIBE_FI_EVENTS_SOCKET");
+    if (path && *path) return path;
+    return get_vibe_dir() + "/events.sock";
+}
+
+bool EventHub::listen_on(const std::string& path) {
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) return false;
+    memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    std::error_code ec;
+    fs::create_directories(fs::path(path).parent_path(), ec);
+
+    // Someone answering means another vibe-fi owns the feed; silence means a stale file
+    int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (probe < 0) return false;
+    bool taken = connect(probe, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
+    close(probe);
+    if (taken) return false;
+    unlink(path.c_str());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return false;
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    mode_t old_mask = umask(077);
+    int status = bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    umask(old_mask);
+    if (status != 0 || listen(fd, 16) != 0) {
+        close(fd);
+        return false;
+    }
+    listen_fd = fd;
+    listen_path = path;
+    return true;
+}
+
+std::chrono::steady_clock::time_point EventHub::next_tick(int interval_s) const {
+    // Shared grid, so subscribers that joined at different moments are served by one read
+    auto since = std::chrono::steady_clock::now() - epoch;
+    auto step = std::chrono::seconds(std::max(1, interval_s));
+    return epoch + (since / step + 1) * step;
+}
+
+void EventHub::attach(int fd, int interval_s) {
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    subscribers.push_back({fd, interval_s, next_tick(interval_s), ""});
+
+    // Start from the current state instead of waiting for the next change
+    Subscriber& added = subscribers.back();
+    if (!track_line.empty()) send_line(added, track_line);
+    if (!pause_line.empty()) send_line(added, pause_line);
+}
+
+void EventHub::add(int fd, int interval_s) {
+    attach(fd, std::max(0, interval_s));
+    drop_failed();
+}
+
+void EventHub::poll() {
+    if (listen_fd >= 0) {
+        int fd;
+        while ((fd = accept(listen_fd, nullptr, nullptr)) >= 0) attach(fd, DEFAULT_INTERVAL_S);
+    }
+
+    char buffer[512];
+    for (auto& subscriber : subscribers) {
+        ssize_t n;
+        while ((n = recv(subscriber.fd, buffer, sizeof(buffer), 0)) > 0) {
+            subscriber.input.append(buffer, n);
+        }
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) || subscriber.input.size() > sizeof(buffer)) {
+            close(subscriber.fd);
+            subscriber.fd = -1;
+            continue;
+        }
+
+        // The only request a subscriber can make: how often it wants the position
+        size_t newline;
+        while ((newline = subscriber.input.find('\n')) != std::string::npos) {
+            std::string line = subscriber.input.substr(0, newline);
+            subscriber.input.erase(0, newline + 1);
+            if (line.compare(0, 9, "interval ") == 0) {
+                subscriber.interval_s = std::max(0, atoi(line.c_str() + 9));
+                subscriber.next_position = next_tick(subscriber.interval_s);
+            }
+        }
+    }
+    drop_failed();
+}
+
+void EventHub::add_pollfds(std::vector<pollfd>& fds) const {
+    if (listen_fd >= 0) fds.push_back({listen_fd, POLLIN, 0});
+    for (const auto& subscriber : subscribers) fds.push_back({subscriber.fd, POLLIN, 0});
+}
+
+int EventHub::next_due_ms() const {
+    auto now = std::chrono::steady_clock::now();
+    int due = -1;
+    for (const auto& subscriber : subscribers) {
+        if (subscriber.interval_s == 0) continue;
+        // Rounded up, so poll() never wakes a moment early and spins
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+            subscriber.next_position - now + std::chrono::microseconds(999)).count();
+        int ms = static_cast<int>(std::max<long long>(0, left));
+        if (due == -1 || ms < due) due = ms;
+    }
+    return due;
+}
+
+bool EventHub::send_line(Subscriber& subscriber, const std::string& line) {
+    if (subscriber.fd < 0) return false;
+    // Events are tiny; a subscriber whose buffer is full is not reading and gets dropped
+    std::string data = line + "\n";
+    ssize_t sent = send(subscriber.fd, data.data(), data.size(), SEND_FLAGS);
+    if (sent == static_cast<ssize_t>(data.size())) return true;
+    close(subscriber.fd);
+    subscriber.fd = -1;
+    return false;
+}
+
+void EventHub::drop_failed() {
+    subscribers.erase(std::remove_if(subscribers.begin(), subscribers.end(),
+                                     [](const Subscriber& subscriber) { return subscriber.fd < 0; }),
+                      subscribers.end());
+}
+
+void EventHub::publish(const std::string& json) {
+    for (auto& subscriber : subscribers) send_line(subscriber, json);
+    drop_failed();
+}
+
+void EventHub::track(const std::string& title, double duration) {
+    if (title == last_title) return;
+    last_title = title;
+    last_lyric = -1;
+    char numbers[32];
+    snprintf(numbers, sizeof(numbers), "%.1f", duration);
+    track_line = "{\"event\":\"track\",\"title\":" + json_quote(title) + ",\"duration\":" + numbers + "}";
+    publish(track_line);
+}
+
+void EventHub::paused(bool paused) {
+    if (last_pause == static_cast<int>(paused)) return;
+    last_pause = paused;
+    pause_line = paused ? "{\"event\":\"pause\"}" : "{\"event\":\"resume\"}";
+    publish(pause_line);
+}
+
+void EventHub::lyric(int index, const std::string& text) {
+    if (index == last_lyric) return;
+    last_lyric = index;
+    publish("{\"event\":\"lyric\",\"index\":" + std::to_string(index) + ",\"text\":" + json_quote(text) + "}");
+}
+
+bool EventHub::position_due() const {
+    auto now = std::chrono::steady_clock::now();
+    for (const auto& subscriber : subscribers) {
+        if (subscriber.interval_s > 0 && subscriber.next_position <= now) return true;
+    }
+    return false;
+}
+
+void EventHub::position(double position, double duration) {
+    char line[96];
+    snprintf(line, sizeof(line), "{\"event\":\"position\",\"position\":%.1f,\"duration\":%.1f}", position, duration);
+    auto now = std::chrono::steady_clock::now();
+    for (auto& subscriber : subscribers) {
+        if (subscriber.interval_s == 0 || subscriber.next_position > now) continue;
+        subscriber.next_position = next_tick(subscriber.interval_s);
+        send_line(subscriber, line);
+    }
+    drop_failed();
+}
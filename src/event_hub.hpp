@@ -0,0 +1,68 @@
+#ifndef EVENT_HUB_HPP
+#define EVENT_HUB_HPP
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <poll.h>
+
+// Push-only status feed for bars and scripts. Subscribers connect to a Unix
+// socket and get one JSON line per change. The owner publishes each event once
+// from its own loop and the line is written to every subscriber, so dozens of
+// subscribers cost no extra mpv reads. Unchanged values are not re-sent.
+class EventHub {
+public:
+    EventHub();
+    ~EventHub();
+
+    // VIBE_FI_EVENTS_SOCKET, or ~/.vibe-fi/events.sock
+    static std::string socket_path();
+    // False if another instance already serves the path; the hub then only has handed-over subscribers
+    bool listen_on(const std::string& path);
+
+    // Never blocks: accepts subscribers, reads their "interval <seconds>" lines, drops closed ones
+    void poll();
+    // Takes over an already connected socket, e.g. the daemon's "subscribe"
+    void add(int fd, int interval_s);
+    bool has_subscribers() const { return !subscribers.empty(); }
+
+    // For owners that sleep in poll(): descriptors to watch, and ms until a position event is due (-1: none)
+    void add_pollfds(std::vector<pollfd>& fds) const;
+    int next_due_ms() const;
+
+    void track(const std::string& title, double duration);
+    void paused(bool paused);
+    void lyric(int index, const std::string& text);
+    // True when some subscriber's interval has run out; read the position once and pass it to position()
+    bool position_due() const;
+    void position(double position, double duration);
+    // Anything else, already encoded as one JSON object
+    void publish(const std::string& json);
+
+private:
+    struct Subscriber {
+        int fd;
+        int interval_s; // 0: no position events
+        std::chrono::steady_clock::time_point next_position;
+        std::string input;
+    };
+
+    int listen_fd;
+    std::string listen_path;
+    std::chrono::steady_clock::time_point epoch; // position ticks fall on whole seconds from here
+    std::vector<Subscriber> subscribers;
+
+    // Latest state, replayed to new subscribers
+    std::string track_line;
+    std::string pause_line;
+    std::string last_title;
+    int last_pause;
+    int last_lyric;
+
+    void attach(int fd, int interval_s);
+    std::chrono::steady_clock::time_point next_tick(int interval_s) const;
+    bool send_line(Subscriber& subscriber, const std::string& line);
+    void drop_failed();
+};
+
+#endif // EVENT_HUB_HPP
@@ -1,16 +1,36 @@
 #include "library.hpp"
+#include "library_scanner.hpp"
 #include "utils.hpp"
 #include <algorithm>
 #include <iostream>
+#include <sstream>
+#include <cstring>
 
 namespace fs = std::filesystem;
 
 Library::Library() {
-    root_path = get_home_music_dir();
+    // The root is resolved on first use; constructing a Library must not touch the filesystem
+}
+
+const std::string& Library::get_root() {
+    return get_roots().front();
+}
+
+const std::vector<std::string>& Library::get_roots() {
+    if (!roots.empty()) return roots;
+    const char* setting = getenv("VIBE_FI_LIBRARY");
+    std::istringstream list(setting ? setting : "");
+    std::string root;
+    while (std::getline(list, root, ':')) {
+        while (root.size() > 1 && root.back() == '/') root.pop_back();
+        if (!root.empty() && std::find(roots.begin(), roots.end(), root) == roots.end()) roots.push_back(root);
+    }
+    if (roots.empty()) roots.push_back(get_home_music_dir());
+    return roots;
 }
 
 void Library::set_root(const std::string& path) {
-    root_path = path;
+    roots.assign(1, path);
 }
 
 std::string Library::get_home_music_dir() {
@@ -23,67 +43,254 @@ std::string Library::get_home_music_dir() {
     return ".";
 }
 
-std::vector<LibraryItem> Library::list_directory(const std::string& path) {
-    std::vector<LibraryItem> items;
+// Ordering shared by the scanner and index_of
+static bool item_less(const LibraryItem& a, const LibraryItem& b) {
+    if (a.is_directory != b.is_directory) return a.is_directory > b.is_directory;
+    return strcmp(a.name(), b.name()) < 0;
+}
+
+static std::string lowercase(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(), ::tolower);
+    return text;
+}
+
+// Rows kept sorted as a scan finds them. Batches double in size, so rows
+// appear immediately and the total merge work stays small.
+struct RowBuilder {
+    std::vector<LibraryItem> sorted;
+    std::vector<LibraryItem> batch;
+    size_t publish_at = 256;
+
+    bool add(const LibraryItem& item) {
+        batch.push_back(item);
+        if (batch.size() < publish_at) return false;
+        publish_at *= 2;
+        return true;
+    }
+
+    std::shared_ptr<const std::vector<LibraryItem>> merge() {
+        std::sort(batch.begin(), batch.end(), item_less);
+        std::vector<LibraryItem> merged;
+        merged.reserve(sorted.size() + batch.size());
+        std::merge(sorted.begin(), sorted.end(), batch.begin(), batch.end(), std::back_inserter(merged), item_less);
+        sorted.swap(merged);
+        batch.clear();
+        return std::make_shared<const std::vector<LibraryItem>>(sorted);
+    }
+};
+
+static const int PROBE_WORKERS = 2;
+
+DirectoryListing::DirectoryListing() : current(std::make_shared<Scan>()), stopping(false) {
+    current->rows = std::make_shared<const std::vector<LibraryItem>>();
+    current->done = true;
+}
+
+DirectoryListing::~DirectoryListing() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        current->cancelled = true;
+        probe_queue.clear();
+    }
+    probe_cv.notify_all();
+    for (auto& prober : probers) {
+        if (prober.joinable()) prober.join();
+    }
+}
+
+std::shared_ptr<DirectoryListing::Scan> DirectoryListing::start(const std::string& path) {
+    auto next = std::make_shared<Scan>();
+    next->path = path;
+    next->rows = std::make_shared<const std::vector<LibraryItem>>();
+    std::lock_guard<std::mutex> lock(mutex);
+    current->cancelled = true;
+    current = next;
+    probe_queue.clear();
+    return next;
+}
+
+void DirectoryListing::open(const std::string& path) {
+    // The scan owns its state; a newer open() just tells it to stop
+    std::thread(&DirectoryListing::scan_directory, start(path)).detach();
+}
+
+void DirectoryListing::open_roots(const std::vector<std::string>& roots) {
+    auto next = start("");
+    RowBuilder rows;
+    for (const std::string& root : roots) {
+        fs::path path(root);
+        rows.add({string_pool().intern(path.parent_path().string()), string_pool().intern(path.filename().string()), 0, true});
+    }
+    auto merged = rows.merge();
+    std::lock_guard<std::mutex> lock(next->mutex);
+    next->rows = merged;
+    next->version++;
+    next->done = true;
+}
+
+void DirectoryListing::open_find(const std::vector<std::string>& roots, const std::string& query) {
+    std::thread(&DirectoryListing::find_files, start(""), roots, query).detach();
+}
+
+void DirectoryListing::find_files(std::shared_ptr<Scan> scan, std::vector<std::string> roots, std::string query) {
+    std::string wanted = lowercase(query);
+    std::mutex rows_mutex;
+    RowBuilder rows;
+    auto publish = [&]() {
+        auto merged = rows.merge();
+        std::lock_guard<std::mutex> lock(scan->mutex);
+        scan->rows = merged;
+        scan->version++;
+    };
+    LibraryScanner().scan(roots, [&](const std::vector<LibraryItem>& files) {
+        std::lock_guard<std::mutex> lock(rows_mutex);
+        for (const LibraryItem& item : files) {
+            if (lowercase(item.name()).find(wanted) != std::string::npos && rows.add(item)) publish();
+        }
+    }, &scan->cancelled);
+    std::lock_guard<std::mutex> lock(rows_mutex);
+    publish();
+    scan->done = true;
+}
+
+std::shared_ptr<DirectoryListing::Scan> DirectoryListing::scan() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return current;
+}
+
+void DirectoryListing::scan_directory(std::shared_ptr<Scan> scan) {
+    RowBuilder rows;
+    auto publish = [&]() {
+        auto merged = rows.merge();
+        std::lock_guard<std::mutex> lock(scan->mutex);
+        scan->rows = merged;
+        scan->version++;
+    };
+
     try {
-        for (const auto& entry : fs::directory_iterator(path)) {
+        StrId dir = string_pool().intern(scan->path);
+        std::error_code ec;
+        for (fs::directory_iterator it(scan->path, fs::directory_options::skip_permission_denied, ec), end;
+             it != end && !ec; it.increment(ec)) {
+            if (scan->cancelled) return;
+
+            // The entry type comes from readdir, no stat and no ffprobe here
+            bool is_directory = it->is_directory(ec);
+            std::string name = it->path().filename().string();
+            if (!is_directory && !LibraryScanner::is_audio_file(name.c_str())) continue;
+
             LibraryItem item;
-            item.path = entry.path().string();
-            item.name = entry.path().filename().string();
-            item.is_directory = entry.is_directory();
-            
-            // Filter for audio files or directories
-            if (item.is_directory) {
-                items.push_back(item);
-            } else {
-                std::string ext = entry.path().extension().string();
-                // Simple check for common audio extensions
-                if (ext == ".mp3" || ext == ".wav" || ext == ".flac" || ext == ".m4a" || ext == ".ogg") {
-                    item.duration = get_audio_duration(item.path);
-                    items.push_back(item);
-                }
-            }
+            item.dir = dir;
+            item.name_id = string_pool().intern(name);
+            item.duration = 0;
+            item.is_directory = is_directory;
+            if (rows.add(item)) publish();
         }
     } catch (const std::exception& e) {
         std::cerr << "Error listing directory: " << e.what() << std::endl;
     }
-    
-    // Sort directories first, then files
-    std::sort(items.begin(), items.end(), [](const LibraryItem& a, const LibraryItem& b) {
-        if (a.is_directory != b.is_directory) return a.is_directory > b.is_directory;
-        return a.name < b.name;
-    });
-    
-    return items;
+
+    publish();
+    scan->done = true;
 }
 
-std::vector<LibraryItem> Library::search(const std::string& query) {
-    std::vector<LibraryItem> results;
-    // Recursive search - might be slow for large libraries
-    try {
-        for (const auto& entry : fs::recursive_directory_iterator(root_path)) {
-            if (!entry.is_directory()) {
-                std::string filename = entry.path().filename().string();
-                // Case insensitive search
-                std::string filename_lower = filename;
-                std::string query_lower = query;
-                std::transform(filename_lower.begin(), filename_lower.end(), filename_lower.begin(), ::tolower);
-                std::transform(query_lower.begin(), query_lower.end(), query_lower.begin(), ::tolower);
-                
-                if (filename_lower.find(query_lower) != std::string::npos) {
-                    std::string ext = entry.path().extension().string();
-                    if (ext == ".mp3" || ext == ".wav" || ext == ".flac" || ext == ".m4a" || ext == ".ogg") {
-                        LibraryItem item;
-                        item.path = entry.path().string();
-                        item.name = filename;
-                        item.is_directory = false;
-                        results.push_back(item);
-                    }
-                }
+size_t DirectoryListing::size() const {
+    auto s = scan();
+    std::lock_guard<std::mutex> lock(s->mutex);
+    return s->rows->size();
+}
+
+LibraryItem DirectoryListing::operator[](size_t index) const {
+    auto s = scan();
+    std::lock_guard<std::mutex> lock(s->mutex);
+    LibraryItem item = s->rows->at(index);
+    auto it = s->durations.find(duration_key(item));
+    if (it != s->durations.end() && it->second > 0) item.duration = it->second;
+    return item;
+}
+
+bool DirectoryListing::loading() const {
+    return !scan()->done;
+}
+
+uint64_t DirectoryListing::version() const {
+    return scan()->version;
+}
+
+size_t DirectoryListing::index_of(StrId name_id) const {
+    auto s = scan();
+    std::shared_ptr<const std::vector<LibraryItem>> rows;
+    {
+        std::lock_guard<std::mutex> lock(s->mutex);
+        rows = s->rows;
+    }
+    // Names are unique within a directory, so only the directory flag is unknown
+    for (bool is_directory : {true, false}) {
+        LibraryItem key{0, name_id, 0, is_directory};
+        auto it = std::lower_bound(rows->begin(), rows->end(), key, item_less);
+        if (it != rows->end() && it->name_id == name_id) return it - rows->begin();
+    }
+    return 0;
+}
+
+void DirectoryListing::probe_durations(const std::vector<size_t>& rows) {
+    auto s = scan();
+    std::deque<std::pair<std::shared_ptr<Scan>, LibraryItem>> wanted;
+    {
+        std::lock_guard<std::mutex> lock(s->mutex);
+        for (size_t i : rows) {
+            if (i >= s->rows->size()) continue;
+            const LibraryItem& item = (*s->rows)[i];
+            if (!item.is_directory && s->durations.find(duration_key(item)) == s->durations.end()) {
+                wanted.emplace_back(s, item);
             }
         }
-    } catch (const std::exception& e) {
-        std::cerr << "Error searching library: " << e.what() << std::endl;
     }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    // Rows scrolled out of view are dropped
+    probe_queue.swap(wanted);
+    if (probe_queue.empty()) return;
+    while (static_cast<int>(probers.size()) < PROBE_WORKERS) {
+        probers.emplace_back(&DirectoryListing::probe_loop, this);
+    }
+    probe_cv.notify_all();
+}
+
+void DirectoryListing::probe_loop() {
+    while (true) {
+        std::pair<std::shared_ptr<Scan>, LibraryItem> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            probe_cv.wait(lock, [this]() { return stopping || !probe_queue.empty(); });
+            if (stopping) return;
+            job = probe_queue.front();
+            probe_queue.pop_front();
+        }
+
+        auto& s = job.first;
+        {
+            std::lock_guard<std::mutex> lock(s->mutex);
+            // Another worker claimed it, or a newer request queued it twice
+            if (!s->durations.emplace(duration_key(job.second), -1).second) continue;
+        }
+        int32_t seconds = static_cast<int32_t>(get_audio_duration(job.second.path()));
+        std::lock_guard<std::mutex> lock(s->mutex);
+        s->durations[duration_key(job.second)] = seconds;
+    }
+}
+
+std::vector<LibraryItem> Library::search(const std::string& query) {
+    std::string wanted = lowercase(query);
+    std::mutex mutex;
+    std::vector<LibraryItem> results;
+    LibraryScanner().scan(get_roots(), [&](const std::vector<LibraryItem>& files) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const LibraryItem& item : files) {
+            if (lowercase(item.name()).find(wanted) != std::string::npos) results.push_back(item);
+        }
+    });
+    std::sort(results.begin(), results.end(), item_less);
     return results;
 }
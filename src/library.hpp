@@ -4,24 +4,95 @@
 #include <string>
 #include <vector>
 #include <filesystem>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <deque>
+#include <unordered_map>
+#include "track_table.hpp"
 
+// 16 bytes per row; siblings share the interned parent directory
 struct LibraryItem {
-    std::string name;
-    std::string path;
-    std::string duration;
+    StrId dir;
+    StrId name_id;
+    int32_t duration; // in seconds, 0 if unknown
     bool is_directory;
+
+    const char* name() const { return string_pool().c_str(name_id); }
+    std::string path() const { return std::string(string_pool().c_str(dir)) + "/" + name(); }
+};
+
+// A directory's contents, filled in by a background scan. Rows show up as they
+// are found, always in sorted order (directories first), and durations are
+// probed only for the rows somebody asks about.
+class DirectoryListing {
+public:
+    DirectoryListing();
+    ~DirectoryListing();
+
+    void open(const std::string& path);
+    // The roots themselves, as directories
+    void open_roots(const std::vector<std::string>& roots);
+    // Audio files anywhere under the roots whose name contains query, any case;
+    // found by a LibraryScanner, so this is where slow mounts are fine
+    void open_find(const std::vector<std::string>& roots, const std::string& query);
+    size_t size() const;
+    bool empty() const { return size() == 0; }
+    LibraryItem operator[](size_t index) const;
+
+    bool loading() const;
+    // Bumped whenever rows are published; indices may have shifted
+    uint64_t version() const;
+    // Row of the entry with this name, or 0 if it is not listed
+    size_t index_of(StrId name_id) const;
+
+    // Queues ffprobe for these rows (what is on screen plus some overscan); replaces the previous request
+    void probe_durations(const std::vector<size_t>& rows);
+
+private:
+    struct Scan {
+        std::string path;
+        std::atomic<bool> cancelled{false};
+        std::atomic<bool> done{false};
+        std::atomic<uint64_t> version{0};
+        std::mutex mutex;
+        std::shared_ptr<const std::vector<LibraryItem>> rows;
+        std::unordered_map<uint64_t, int32_t> durations; // by duration_key(), -1 while being probed
+    };
+
+    mutable std::mutex mutex;
+    std::shared_ptr<Scan> current;
+
+    std::condition_variable probe_cv;
+    std::deque<std::pair<std::shared_ptr<Scan>, LibraryItem>> probe_queue;
+    std::vector<std::thread> probers;
+    bool stopping;
+
+    std::shared_ptr<Scan> scan() const;
+    std::shared_ptr<Scan> start(const std::string& path);
+    static void scan_directory(std::shared_ptr<Scan> scan);
+    static void find_files(std::shared_ptr<Scan> scan, std::vector<std::string> roots, std::string query);
+    // Found rows can share a name, so durations go by directory and name
+    static uint64_t duration_key(const LibraryItem& item) { return (uint64_t(item.dir) << 32) | item.name_id; }
+    void probe_loop();
 };
 
 class Library {
 public:
     Library();
     void set_root(const std::string& path);
-    std::vector<LibraryItem> list_directory(const std::string& path);
+    // The first root
+    const std::string& get_root();
+    // VIBE_FI_LIBRARY, a colon-separated list of directories, or the home music directory
+    const std::vector<std::string>& get_roots();
+    // Audio files under every root whose name contains query, any case
     std::vector<LibraryItem> search(const std::string& query);
     std::string get_home_music_dir();
 
 private:
-    std::string root_path;
+    std::vector<std::string> roots;
 };
 
 #endif // LIBRARY_HPP
@@ -0,0 +1,167 @@
+#include "library_index.hpp"
+#include "utils.hpp"
+#include <sys/stat.h>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <cstdio>
+#include <cstdlib>
+
+namespace fs = std::filesystem;
+
+static const char* INDEX_HEADER = "vibe-fi library index 2";
+static const char* INDEX_HEADER_V1 = "vibe-fi library index 1"; // loudness only
+// Results arrive one per analysed file; batching the rewrites keeps a big queue cheap
+static const int SAVE_INTERVAL_S = 10;
+
+LibraryIndex::LibraryIndex() : dirty(false), last_save() {
+    index_path = get_vibe_dir() + "/library.idx";
+    std::lock_guard<std::mutex> lock(mutex);
+    read_file(false);
+}
+
+LibraryIndex::~LibraryIndex() {
+    save(true);
+}
+
+bool LibraryIndex::stat_file(const std::string& path, uint64_t& size, int64_t& mtime) {
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0) return false;
+    size = static_cast<uint64_t>(info.st_size);
+    mtime = static_cast<int64_t>(info.st_mtime);
+    return true;
+}
+
+bool LibraryIndex::lookup(const std::string& key, TrackAnalysis& out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(key);
+    if (it == entries.end()) return false;
+
+    if (!is_url(key)) {
+        // A re-encoded or retagged file is analysed again
+        uint64_t size;
+        int64_t mtime;
+        if (!stat_file(key, size, mtime) || size != it->second.size || mtime != it->second.mtime) {
+            entries.erase(it);
+            dirty = true;
+            return false;
+        }
+    }
+    out = it->second.analysis;
+    return true;
+}
+
+LibraryIndex::Entry* LibraryIndex::entry_for(const std::string& key) {
+    // One record per line, so keys cannot contain the separators
+    if (key.find_first_of("\t\n") != std::string::npos) return nullptr;
+
+    Entry current{0, 0, {}};
+    if (!is_url(key) && !stat_file(key, current.size, current.mtime)) return nullptr;
+    auto it = entries.find(key);
+    if (it == entries.end() || it->second.size != current.size || it->second.mtime != current.mtime) {
+        // New, or results for an older version of the file
+        it = entries.insert_or_assign(key, current).first;
+    }
+    dirty = true;
+    return &it->second;
+}
+
+void LibraryIndex::store_loudness(const std::string& key, float loudness, float peak) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Entry* entry = entry_for(key);
+        if (!entry) return;
+        entry->analysis.has_loudness = true;
+        entry->analysis.loudness = loudness;
+        entry->analysis.peak = peak;
+    }
+    save();
+}
+
+void LibraryIndex::store_waveform(const std::string& key, const std::vector<uint8_t>& waveform) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Entry* entry = entry_for(key);
+        if (!entry) return;
+        entry->analysis.waveform = waveform;
+    }
+    save();
+}
+
+void LibraryIndex::read_file(bool keep_existing) {
+    std::ifstream file(index_path);
+    std::string line;
+    if (!std::getline(file, line)) return;
+    bool v1 = line == INDEX_HEADER_V1;
+    if (!v1 && line != INDEX_HEADER) return;
+
+    // key \t size \t mtime \t loudness \t peak \t waveform, "-" for a part not computed
+    while (std::getline(file, line)) {
+        size_t tab = line.find('\t');
+        if (tab == std::string::npos) continue;
+        std::string key = line.substr(0, tab);
+        if (keep_existing && entries.count(key)) continue;
+
+        std::istringstream fields(line.substr(tab + 1));
+        Entry entry{0, 0, {}};
+        std::string loudness, peak, waveform = "-";
+        if (!(fields >> entry.size >> entry.mtime >> loudness >> peak)) continue;
+        if (!v1) fields >> waveform;
+        if (loudness != "-") {
+            entry.analysis.has_loudness = true;
+            entry.analysis.loudness = strtof(loudness.c_str(), nullptr);
+            entry.analysis.peak = strtof(peak.c_str(), nullptr);
+        }
+        if (waveform != "-") {
+            for (size_t i = 0; i + 1 < waveform.size(); i += 2) {
+                entry.analysis.waveform.push_back(static_cast<uint8_t>(strtoul(waveform.substr(i, 2).c_str(), nullptr, 16)));
+            }
+        }
+        entries[key] = std::move(entry);
+    }
+}
+
+void LibraryIndex::save(bool force) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!dirty) return;
+    auto now = std::chrono::steady_clock::now();
+    if (!force && now - last_save < std::chrono::seconds(SAVE_INTERVAL_S)) return;
+
+    // Another vibe-fi (say, the daemon) may have added tracks since we loaded
+    read_file(true);
+
+    std::error_code ec;
+    fs::create_directories(fs::path(index_path).parent_path(), ec);
+    std::string tmp_path = index_path + ".tmp";
+    {
+        std::ofstream file(tmp_path, std::ios::trunc);
+        if (!file) return;
+        file << INDEX_HEADER << "\n";
+        char numbers[96];
+        std::string waveform;
+        for (const auto& [key, entry] : entries) {
+            const TrackAnalysis& analysis = entry.analysis;
+            if (analysis.has_loudness) {
+                snprintf(numbers, sizeof(numbers), "\t%llu\t%lld\t%.2f\t%.2f\t",
+                         static_cast<unsigned long long>(entry.size), static_cast<long long>(entry.mtime),
+                         analysis.loudness, analysis.peak);
+            } else {
+                snprintf(numbers, sizeof(numbers), "\t%llu\t%lld\t-\t-\t",
+                         static_cast<unsigned long long>(entry.size), static_cast<long long>(entry.mtime));
+            }
+            waveform.clear();
+            for (uint8_t level : analysis.waveform) {
+                static const char* digits = "0123456789abcdef";
+                waveform += digits[level >> 4];
+                waveform += digits[level & 15];
+            }
+            file << key << numbers << (waveform.empty() ? "-" : waveform) << "\n";
+        }
+        if (!file) return;
+    }
+    // Readers only ever see a complete file
+    fs::rename(tmp_path, index_path, ec);
+    if (ec) return;
+    dirty = false;
+    last_save = now;
+}
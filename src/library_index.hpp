@@ -0,0 +1,56 @@
+#ifndef LIBRARY_INDEX_HPP
+#define LIBRARY_INDEX_HPP
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+#include <chrono>
+
+// What the background analyses learned about one track; each part is filled in separately
+struct TrackAnalysis {
+    bool has_loudness = false;
+    float loudness = 0.0f;         // EBU R128 integrated loudness, LUFS
+    float peak = 0.0f;             // true peak, dBTP
+    std::vector<uint8_t> waveform; // level per slice of the track, 0 silent to 255 full scale; empty if not computed
+};
+
+// Per-track analysis results kept in ~/.vibe-fi/library.idx, so each file is
+// analysed once rather than on every play. Local files are keyed by path and
+// dropped when their size or mtime changes; streams are keyed by webpage URL
+// and outlive the cached audio they were measured from. Thread-safe.
+class LibraryIndex {
+public:
+    LibraryIndex();
+    ~LibraryIndex(); // Writes pending results
+
+    // False if nothing is known about the track
+    bool lookup(const std::string& key, TrackAnalysis& out);
+    // Each fills in its part and keeps what other analyses stored
+    void store_loudness(const std::string& key, float loudness, float peak);
+    void store_waveform(const std::string& key, const std::vector<uint8_t>& waveform);
+
+    // Rewrites the file if something changed, at most every few seconds unless forced
+    void save(bool force = false);
+
+private:
+    struct Entry {
+        uint64_t size;  // 0 for URL keys, which are never revalidated
+        int64_t mtime;
+        TrackAnalysis analysis;
+    };
+
+    std::string index_path;
+    std::mutex mutex;
+    std::unordered_map<std::string, Entry> entries;
+    bool dirty;
+    std::chrono::steady_clock::time_point last_save;
+
+    // The Entry for this key, created (and stat'ed) on first use; null if the file is gone
+    Entry* entry_for(const std::string& key);
+    void read_file(bool keep_existing);
+    static bool stat_file(const std::string& path, uint64_t& size, int64_t& mtime);
+};
+
+#endif // LIBRARY_INDEX_HPP
@@ -0,0 +1,245 @@
+#include "library_scanner.hpp"
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <memory>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+
+static const int MAX_THREADS = 32;
+static const size_t DIRENT_BUFFER = 64 * 1024;
+
+enum class EntryKind { OTHER, FILE, DIRECTORY };
+
+// What an entry is, from the type the directory gave; a stat only when it gave none
+static EntryKind entry_kind(int dir_fd, const char* name, unsigned char type) {
+    if (type == DT_DIR) return EntryKind::DIRECTORY;
+    if (type == DT_REG) return EntryKind::FILE;
+    if (type != DT_UNKNOWN && type != DT_LNK) return EntryKind::OTHER;
+    struct stat info;
+    bool link = type == DT_LNK;
+    if (!link) {
+        if (fstatat(dir_fd, name, &info, AT_SYMLINK_NOFOLLOW) != 0) return EntryKind::OTHER;
+        link = S_ISLNK(info.st_mode);
+    }
+    if (link && fstatat(dir_fd, name, &info, 0) != 0) return EntryKind::OTHER;
+    if (S_ISREG(info.st_mode)) return EntryKind::FILE;
+    // A symlink to a directory could lead back up the tree
+    if (S_ISDIR(info.st_mode) && !link) return EntryKind::DIRECTORY;
+    return EntryKind::OTHER;
+}
+
+// Calls visit(name, kind) for every entry but . and ..; false if the directory cannot be opened
+template <typename Visit>
+static bool list_directory(const std::string& path, Visit visit) {
+    int fd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return false;
+    auto skip = [](const char* name) { return name[0] == '.' && (!name[1] || (name[1] == '.' && !name[2])); };
+
+#ifdef SYS_getdents64
+    // Layout the kernel fills in; glibc only declares it in newer versions
+    struct dirent64_record {
+        uint64_t d_ino;
+        int64_t d_off;
+        unsigned short d_reclen;
+        unsigned char d_type;
+        char d_name[1];
+    };
+    thread_local std::unique_ptr<char[]> buffer(new char[DIRENT_BUFFER]);
+    long read_bytes;
+    while ((read_bytes = syscall(SYS_getdents64, fd, buffer.get(), DIRENT_BUFFER)) > 0) {
+        for (long offset = 0; offset < read_bytes;) {
+            auto* entry = reinterpret_cast<dirent64_record*>(buffer.get() + offset);
+            offset += entry->d_reclen;
+            if (!skip(entry->d_name)) visit(entry->d_name, entry_kind(fd, entry->d_name, entry->d_type));
+        }
+    }
+    if (read_bytes == 0 || errno != ENOSYS) {
+        close(fd);
+        return true;
+    }
+    // No getdents64 after all (seccomp, emulation); nothing was read yet
+#endif
+
+    DIR* dir = fdopendir(fd);
+    if (!dir) {
+        close(fd);
+        return false;
+    }
+    while (struct dirent* entry = readdir(dir)) {
+        if (!skip(entry->d_name)) visit(entry->d_name, entry_kind(fd, entry->d_name, entry->d_type));
+    }
+    closedir(dir); // Closes fd as well
+    return true;
+}
+
+static int setting(const char* name, int fallback) {
+    const char* value = getenv(name);
+    int parsed = value ? atoi(value) : 0;
+    return parsed > 0 ? parsed : fallback;
+}
+
+bool LibraryScanner::is_audio_file(const char* name) {
+    const char* dot = strrchr(name, '.');
+    if (!dot) return false;
+    for (const char* ext : {".mp3", ".wav", ".flac", ".m4a", ".ogg"}) {
+        if (strcmp(dot, ext) == 0) return true;
+    }
+    return false;
+}
+
+LibraryScanner::LibraryScanner(int thread_count, int per_root_cap) {
+    int cores = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    threads = thread_count > 0 ? thread_count : setting("VIBE_FI_SCAN_THREADS", std::clamp(cores * 2, 4, MAX_THREADS));
+    threads = std::min(threads, MAX_THREADS);
+    per_root = per_root_cap > 0 ? per_root_cap : setting("VIBE_FI_SCAN_PER_ROOT", threads);
+}
+
+namespace {
+
+struct Job {
+    uint32_t root;
+    std::string path;
+};
+
+// One per worker, on its own cache line so owners and thieves of
+// different deques never share one
+struct alignas(64) WorkerQueue {
+    std::mutex mutex;
+    std::deque<Job> jobs;
+};
+
+struct Walk {
+    std::vector<WorkerQueue> queues;
+    std::unique_ptr<std::atomic<int>[]> reading; // directories of each root being read
+    int per_root;
+    std::atomic<size_t> pending{0};              // directories queued or being read
+    std::atomic<uint64_t> generation{0};         // bumped when a job or a root slot frees up
+    std::atomic<int> sleeping{0};
+    std::mutex idle_mutex;
+    std::condition_variable idle;
+    std::atomic<size_t> directories{0};
+    std::atomic<size_t> files{0};
+    const LibraryScanner::FilesFound* found;
+    const std::atomic<bool>* cancel;
+
+    Walk(size_t workers, size_t roots, int cap)
+        : queues(workers), reading(new std::atomic<int>[roots]), per_root(cap) {
+        for (size_t i = 0; i < roots; ++i) reading[i] = 0;
+    }
+
+    bool cancelled() const { return cancel && cancel->load(std::memory_order_relaxed); }
+
+    bool acquire(uint32_t root) {
+        int now = reading[root].load();
+        while (now < per_root) {
+            if (reading[root].compare_exchange_weak(now, now + 1)) return true;
+        }
+        return false;
+    }
+
+    void wake() {
+        generation++;
+        if (sleeping.load() == 0) return;
+        std::lock_guard<std::mutex> lock(idle_mutex);
+        idle.notify_all();
+    }
+
+    // Newest first from our own deque, oldest first from the others; a job
+    // whose root is at its cap is left for later
+    bool take(size_t self, Job& out) {
+        for (size_t k = 0; k < queues.size(); ++k) {
+            bool own = k == 0;
+            WorkerQueue& queue = queues[(self + k) % queues.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            size_t count = queue.jobs.size();
+            for (size_t i = 0; i < count; ++i) {
+                size_t at = own ? count - 1 - i : i;
+                if (!acquire(queue.jobs[at].root)) continue;
+                out = std::move(queue.jobs[at]);
+                queue.jobs.erase(queue.jobs.begin() + at);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void read(size_t self, const Job& job) {
+        std::vector<Job> subdirs;
+        std::vector<LibraryItem> audio;
+        StrId dir = 0;
+        std::string prefix = job.path.back() == '/' ? job.path : job.path + "/";
+        list_directory(job.path, [&](const char* name, EntryKind kind) {
+            if (kind == EntryKind::DIRECTORY) {
+                subdirs.push_back({job.root, prefix + name});
+            } else if (kind == EntryKind::FILE && LibraryScanner::is_audio_file(name)) {
+                // Siblings share one interned directory
+                if (audio.empty()) dir = string_pool().intern(job.path);
+                audio.push_back({dir, string_pool().intern(name), 0, false});
+            }
+        });
+        directories++;
+        files += audio.size();
+        if (!audio.empty()) (*found)(audio);
+        if (subdirs.empty()) return;
+
+        pending += subdirs.size();
+        {
+            std::lock_guard<std::mutex> lock(queues[self].mutex);
+            for (Job& subdir : subdirs) queues[self].jobs.push_back(std::move(subdir));
+        }
+        wake();
+    }
+
+    void work(size_t self) {
+        while (!cancelled()) {
+            uint64_t seen = generation.load();
+            Job job;
+            if (take(self, job)) {
+                read(self, job);
+                reading[job.root]--;
+                pending--;
+                wake(); // A root slot is free again, or the walk is over
+                continue;
+            }
+            if (pending.load() == 0) return;
+            // Everything queued belongs to roots at their cap, or is being read
+            std::unique_lock<std::mutex> lock(idle_mutex);
+            sleeping++;
+            idle.wait_for(lock, std::chrono::milliseconds(50), [&]() {
+                return generation.load() != seen || pending.load() == 0 || cancelled();
+            });
+            sleeping--;
+        }
+    }
+};
+
+} // namespace
+
+LibraryScanner::Stats LibraryScanner::scan(const std::vector<std::string>& roots, const FilesFound& found,
+                                           const std::atomic<bool>* cancel) const {
+    Walk walk(static_cast<size_t>(threads), roots.size(), per_root);
+    walk.found = &found;
+    walk.cancel = cancel;
+    // Roots are dealt round the workers, so several start at once
+    for (size_t i = 0; i < roots.size(); ++i) {
+        walk.queues[i % walk.queues.size()].jobs.push_back({static_cast<uint32_t>(i), roots[i]});
+    }
+    walk.pending = roots.size();
+
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < walk.queues.size(); ++i) workers.emplace_back(&Walk::work, &walk, i);
+    walk.work(0);
+    for (auto& worker : workers) worker.join();
+    return {walk.directories.load(), walk.files.load()};
+}
@@ -0,0 +1,50 @@
+#ifndef LIBRARY_SCANNER_HPP
+#define LIBRARY_SCANNER_HPP
+
+#include "library.hpp"
+#include <string>
+#include <vector>
+#include <atomic>
+#include <functional>
+#include <cstddef>
+
+// Walks whole library trees on a pool of threads. Every directory is a job: a
+// worker takes the newest job from its own deque, so it goes depth first and
+// its deque stays short, and steals the oldest job of another worker when its
+// own runs dry, which hands over a whole subtree at once. Each root caps how
+// many of its directories are read at once, so a slow network mount holds a
+// few workers and the rest go on with the other roots.
+//
+// Directories are read with getdents64 in 64 KiB batches where there is one,
+// readdir otherwise. The entry type comes with the name, so nothing is stat'ed
+// unless the filesystem leaves the type out or the entry is a symlink.
+// Symlinked directories are not followed, which keeps loops out.
+class LibraryScanner {
+public:
+    struct Stats {
+        size_t directories;
+        size_t files;
+    };
+
+    // The audio files of one directory; called from the worker threads
+    using FilesFound = std::function<void(const std::vector<LibraryItem>& files)>;
+
+    // 0 takes VIBE_FI_SCAN_THREADS / VIBE_FI_SCAN_PER_ROOT, or the defaults:
+    // two threads per core (reads mostly wait on the disk or the network) and
+    // no cap per root
+    LibraryScanner(int threads = 0, int per_root = 0);
+
+    // Returns once every root is walked, or soon after cancel is set
+    Stats scan(const std::vector<std::string>& roots, const FilesFound& found,
+               const std::atomic<bool>* cancel = nullptr) const;
+
+    int thread_count() const { return threads; }
+
+    static bool is_audio_file(const char* name);
+
+private:
+    int threads;
+    int per_root;
+};
+
+#endif // LIBRARY_SCANNER_HPP
@@ -0,0 +1,98 @@
+#include "list_filter.hpp"
+#include <algorithm>
+#include <cctype>
+#include <string_view>
+
+static std::string to_lower(const std::string& s) {
+    std::string out = s;
+    std::transform(out.begin(), out.end(), out.begin(), [](unsigned char c) { return std::tolower(c); });
+    return out;
+}
+
+ListFilter::ListFilter() : built_key(0), built(false) {}
+
+void ListFilter::sync(uint64_t key, size_t count, const std::function<const char*(size_t)>& row_text) {
+    if (built && key == built_key && starts.size() == count + 1) return;
+
+    text.clear();
+    starts.clear();
+    starts.reserve(count + 1);
+    for (size_t i = 0; i < count; ++i) {
+        starts.push_back(static_cast<uint32_t>(text.size()));
+        for (const char* c = row_text(i); *c; ++c) {
+            text.push_back(static_cast<char>(std::tolower(static_cast<unsigned char>(*c))));
+        }
+        text.push_back('\n');
+    }
+    starts.push_back(static_cast<uint32_t>(text.size()));
+    built_key = key;
+    built = true;
+
+    if (active()) rescan();
+}
+
+void ListFilter::set_query(const std::string& query) {
+    std::string lower = to_lower(query);
+    bool narrowing = active() && lower.compare(0, query_lower.size(), query_lower) == 0;
+    query_text = query;
+    query_lower = lower;
+    if (!active()) {
+        matches.clear();
+        return;
+    }
+
+    if (!narrowing) {
+        rescan();
+        return;
+    }
+
+    // Typing one more character can only drop rows
+    std::string_view all(text);
+    size_t kept = 0;
+    for (uint32_t row : matches) {
+        std::string_view line = all.substr(starts[row], starts[row + 1] - starts[row]);
+        if (line.find(query_lower) != std::string_view::npos) matches[kept++] = row;
+    }
+    matches.resize(kept);
+}
+
+void ListFilter::clear() {
+    query_text.clear();
+    query_lower.clear();
+    matches.clear();
+}
+
+void ListFilter::rescan() {
+    // One pass over the whole buffer; each hit skips to the start of the next row
+    matches.clear();
+    std::string_view all(text);
+    uint32_t row = 0;
+    size_t pos = all.find(query_lower);
+    while (pos != std::string_view::npos) {
+        // Hits come in buffer order, so the owning row only ever moves forward
+        while (starts[row + 1] <= pos) ++row;
+        matches.push_back(row);
+        pos = all.find(query_lower, starts[row + 1]);
+    }
+}
+
+size_t ListFilter::size() const {
+    if (active()) return matches.size();
+    return starts.empty() ? 0 : starts.size() - 1;
+}
+
+size_t ListFilter::row(size_t visible) const {
+    return active() ? matches[visible] : visible;
+}
+
+size_t ListFilter::find_prefix(const std::string& prefix, size_t from) const {
+    size_t count = size();
+    if (count == 0 || prefix.empty()) return NOT_FOUND;
+    std::string lower = to_lower(prefix);
+    for (size_t n = 0; n < count; ++n) {
+        size_t visible = (from + n) % count;
+        size_t r = row(visible);
+        if (text.compare(starts[r], lower.size(), lower) == 0) return visible;
+    }
+    return NOT_FOUND;
+}
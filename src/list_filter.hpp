@@ -0,0 +1,45 @@
+#ifndef LIST_FILTER_HPP
+#define LIST_FILTER_HPP
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <cstdint>
+
+// Lowercased text of every row of a list, packed into one buffer. Filtering
+// scans that buffer instead of building strings per row, and a query that
+// extends the previous one only re-checks the rows that already matched.
+class ListFilter {
+public:
+    ListFilter();
+
+    // Rebuilds the index when `key` differs from the list it was built for; the query is kept
+    void sync(uint64_t key, size_t count, const std::function<const char*(size_t)>& text);
+    void set_query(const std::string& query);
+    void clear();
+
+    bool active() const { return !query_lower.empty(); }
+    const std::string& query() const { return query_text; }
+
+    // Visible rows and the list row behind each of them
+    size_t size() const;
+    size_t row(size_t visible) const;
+
+    // First visible row at or after `from` (wrapping) whose text starts with `prefix`
+    size_t find_prefix(const std::string& prefix, size_t from) const;
+
+    static const size_t NOT_FOUND = static_cast<size_t>(-1);
+
+private:
+    uint64_t built_key;
+    bool built;
+    std::string text;            // rows separated by '\n' so matches never span two rows
+    std::vector<uint32_t> starts; // offset of each row, plus one past the end
+    std::string query_text;
+    std::string query_lower;
+    std::vector<uint32_t> matches;
+
+    void rescan();
+};
+
+#endif // LIST_FILTER_HPP
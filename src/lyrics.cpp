@@ -1,59 +1,501 @@
 #include "lyrics.hpp"
 #include <iostream>
 #include <memory>
-#include <array>
 #include <regex>
 #include <algorithm>
 #include <sstream>
+#include <set>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <filesystem>
+#include <functional>
+#include <cerrno>
+#include <unistd.h>
+#include "utils.hpp"
+#include "subprocess.hpp"
 
-LyricsManager::LyricsManager() {}
+namespace fs = std::filesystem;
 
-LyricsData LyricsManager::fetch_lyrics(const std::string& artist, const std::string& title) {
-    if (artist.empty() || title.empty()) {
-        return {"Artist or title missing.", {}, false};
+// Scores at or above this are taken immediately, without waiting for the other queries
+static const double HIGH_CONFIDENCE_SCORE = 0.85;
+// Candidates below this are treated as misses
+static const double MIN_ACCEPT_SCORE = 0.45;
+static const char* NOT_FOUND = "No lyrics found or network error.";
+
+static std::string url_encode(const std::string& value) {
+    std::string escaped;
+    escaped.reserve(value.length());
+    for (char c : value) {
+        if (isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_' || c == '.' || c == '~') {
+            escaped += c;
+        } else {
+            char buf[4];
+            snprintf(buf, sizeof(buf), "%%%02X", (unsigned char)c);
+            escaped += buf;
+        }
     }
+    return escaped;
+}
 
-    // Simple URL encoding (basic)
-    auto url_encode = [](const std::string& value) {
-        std::string escaped;
-        escaped.reserve(value.length());
-        for (char c : value) {
-            if (isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~') {
-                escaped += c;
-            } else {
-                char buf[4];
-                snprintf(buf, sizeof(buf), "%%%02X", (unsigned char)c);
-                escaped += buf;
-            }
+// Finds where the value of "key" starts, skipping the colon and any whitespace around it
+static size_t find_json_value(const std::string& json, const std::string& key) {
+    std::string quoted = "\"" + key + "\"";
+    size_t pos = json.find(quoted);
+    if (pos == std::string::npos) return std::string::npos;
+    pos += quoted.length();
+    while (pos < json.length() && (isspace(static_cast<unsigned char>(json[pos])) || json[pos] == ':')) pos++;
+    return pos < json.length() ? pos : std::string::npos;
+}
+
+// Reads the JSON string value of `key`.
+// Returns false if the key is missing or the value is not a string (null).
+static bool extract_json_string(const std::string& json, const std::string& key, std::string& out) {
+    size_t pos = find_json_value(json, key);
+    if (pos == std::string::npos || json[pos] != '"') return false;
+    pos++;
+
+    out.clear();
+    bool escape = false;
+    for (size_t i = pos; i < json.length(); ++i) {
+        char c = json[i];
+        if (escape) {
+            if (c == 'n') out += '\n';
+            else if (c == 'r') out += '\r';
+            else if (c == 't') out += '\t';
+            else if (c == '"') out += '"';
+            else if (c == '\\') out += '\\';
+            else out += c;
+            escape = false;
+        } else {
+            if (c == '\\') escape = true;
+            else if (c == '"') break;
+            else out += c;
+        }
+    }
+    return true;
+}
+
+static double extract_json_number(const std::string& json, const std::string& key) {
+    size_t pos = find_json_value(json, key);
+    if (pos == std::string::npos) return 0.0;
+    char* end = nullptr;
+    double value = std::strtod(json.c_str() + pos, &end);
+    if (end == json.c_str() + pos) return 0.0;
+    return value;
+}
+
+// Splits a JSON array of objects into the raw text of each top-level object.
+// A single object (the /api/get response) comes back as a one-element list.
+static std::vector<std::string> split_json_objects(const std::string& json) {
+    std::vector<std::string> objects;
+    int depth = 0;
+    bool in_string = false;
+    bool escape = false;
+    size_t start = 0;
+
+    for (size_t i = 0; i < json.length(); ++i) {
+        char c = json[i];
+        if (in_string) {
+            if (escape) escape = false;
+            else if (c == '\\') escape = true;
+            else if (c == '"') in_string = false;
+            continue;
         }
-        return escaped;
+        if (c == '"') {
+            in_string = true;
+        } else if (c == '{') {
+            if (depth == 0) start = i;
+            depth++;
+        } else if (c == '}') {
+            depth--;
+            if (depth == 0) objects.push_back(json.substr(start, i - start + 1));
+            if (depth < 0) break;
+        }
+    }
+    return objects;
+}
+
+// Lowercase alphanumeric words; bytes outside ASCII are kept so non-Latin titles still match
+static std::vector<std::string> tokenize(const std::string& text) {
+    std::vector<std::string> tokens;
+    std::string current;
+    for (char c : text) {
+        unsigned char uc = static_cast<unsigned char>(c);
+        if (isalnum(uc) || uc >= 0x80) {
+            current += static_cast<char>(tolower(uc));
+        } else if (c == '\'') {
+            continue; // "don't" == "dont"
+        } else if (!current.empty()) {
+            tokens.push_back(current);
+            current.clear();
+        }
+    }
+    if (!current.empty()) tokens.push_back(current);
+    return tokens;
+}
+
+static bool has_lyrics(const LyricsData& data) {
+    return data.has_synced || !data.plain_lyrics.empty();
+}
+
+LyricsManager::LyricsManager() {
+    const char* base = getenv("VIBE_FI_LRCLIB_URL");
+    api_base = (base && *base) ? base : "https://lrclib.net";
+    if (!api_base.empty() && api_base.back() == '/') api_base.pop_back();
+    cache_dir = get_vibe_dir() + "/lyrics";
+}
+
+std::string LyricsManager::normalize_title(const std::string& title) {
+    std::string result = title;
+
+    // Drop bracketed segments that only carry video noise, keep "(Remix)", "(Acoustic)" etc.
+    static const std::regex noise(
+        R"(\s*[\(\[\{][^\)\]\}]*\b(official|video|audio|lyrics?|visuali[sz]er|hd|hq|4k|mv|m/v|remaster(ed)?|explicit|clean)\b[^\)\]\}]*[\)\]\}])",
+        std::regex::icase);
+    result = std::regex_replace(result, noise, "");
+
+    // "Song | Channel Name" and "Song // Something"
+    size_t bar = result.find(" | ");
+    if (bar != std::string::npos) result = result.substr(0, bar);
+    size_t slashes = result.find(" // ");
+    if (slashes != std::string::npos) result = result.substr(0, slashes);
+
+    // Featured artists confuse the exact-match endpoints
+    static const std::regex feat(R"(\s+(ft\.?|feat\.?|featuring)\s+.*$)", std::regex::icase);
+    result = std::regex_replace(result, feat, "");
+
+    // Collapse whitespace and trim stray separators
+    std::string collapsed;
+    bool space = false;
+    for (char c : result) {
+        if (isspace(static_cast<unsigned char>(c))) {
+            space = true;
+        } else {
+            if (space && !collapsed.empty()) collapsed += ' ';
+            collapsed += c;
+            space = false;
+        }
+    }
+    while (!collapsed.empty() && (collapsed.back() == '-' || collapsed.back() == ' ')) collapsed.pop_back();
+    return collapsed;
+}
+
+std::vector<std::string> LyricsManager::build_query_urls(const std::string& raw_title, const std::string& artist) {
+    std::vector<std::string> urls;
+    std::set<std::string> seen;
+    auto add = [&](const std::string& url) {
+        if (seen.insert(url).second) urls.push_back(url);
     };
 
-    std::string url = "https://lrclib.net/api/get?artist_name=" + url_encode(artist) + "&track_name=" + url_encode(title);
-    std::string response = perform_request(url);
-    
-    if (response.empty()) {
-        return {"No lyrics found or network error.", {}, false};
+    std::string cleaned = normalize_title(raw_title);
+
+    // Everything in brackets removed, for titles like "Song (Live at X)"
+    static const std::regex brackets(R"(\s*[\(\[\{][^\)\]\}]*[\)\]\}])");
+    std::string bare = normalize_title(std::regex_replace(cleaned, brackets, ""));
+
+    std::string song = cleaned;
+    std::string song_artist = artist;
+    size_t dash = cleaned.find(" - ");
+    if (dash != std::string::npos) {
+        if (song_artist.empty()) song_artist = cleaned.substr(0, dash);
+        song = cleaned.substr(dash + 3);
     }
 
-    return parse_json_response(response);
+    // Exact lookup first, it is the most precise when the split is right
+    if (!song_artist.empty() && !song.empty()) {
+        add(api_base + "/api/get?artist_name=" + url_encode(song_artist) + "&track_name=" + url_encode(song));
+        add(api_base + "/api/search?artist_name=" + url_encode(song_artist) + "&track_name=" + url_encode(song));
+    }
+
+    if (!cleaned.empty()) add(api_base + "/api/search?q=" + url_encode(cleaned));
+    if (!bare.empty()) add(api_base + "/api/search?q=" + url_encode(bare));
+    if (!artist.empty() && dash == std::string::npos) {
+        add(api_base + "/api/search?q=" + url_encode(artist + " " + bare));
+    }
+    if (!song.empty() && song != cleaned) add(api_base + "/api/search?track_name=" + url_encode(song));
+
+    return urls;
 }
 
-std::string LyricsManager::perform_request(const std::string& url) {
-    std::string cmd = "curl -s --max-time 10 \"" + url + "\"";
-    std::array<char, 128> buffer;
-    std::string result;
-    
-    std::unique_ptr<FILE, decltype(&pclose)> pipe(popen(cmd.c_str(), "r"), pclose);
-    if (!pipe) {
-        return "";
+std::vector<LyricsCandidate> LyricsManager::parse_candidates(const std::string& json) {
+    std::vector<LyricsCandidate> candidates;
+    for (const auto& object : split_json_objects(json)) {
+        LyricsCandidate candidate;
+        extract_json_string(object, "trackName", candidate.track_name);
+        extract_json_string(object, "artistName", candidate.artist_name);
+        candidate.duration = extract_json_number(object, "duration");
+        candidate.data = parse_json_response(object);
+        candidate.score = 0.0;
+
+        std::string plain;
+        bool has_plain = extract_json_string(object, "plainLyrics", plain);
+        if (candidate.data.has_synced || has_plain) {
+            candidates.push_back(candidate);
+        }
     }
-    
-    while (fgets(buffer.data(), buffer.size(), pipe.get()) != nullptr) {
-        result += buffer.data();
+    return candidates;
+}
+
+double LyricsManager::score_candidate(const LyricsCandidate& candidate, const std::string& wanted, double duration) {
+    // Token overlap (Dice coefficient) between what we play and "artist title" of the candidate
+    std::vector<std::string> want_tokens = tokenize(wanted);
+    std::vector<std::string> have_tokens = tokenize(candidate.artist_name + " " + candidate.track_name);
+    if (want_tokens.empty() || have_tokens.empty()) return 0.0;
+
+    std::set<std::string> want_set(want_tokens.begin(), want_tokens.end());
+    std::set<std::string> have_set(have_tokens.begin(), have_tokens.end());
+    int common = 0;
+    for (const auto& t : want_set) {
+        if (have_set.count(t)) common++;
     }
-    
-    return result;
+    double title_score = (2.0 * common) / (want_set.size() + have_set.size());
+
+    // The track name on its own must be covered, otherwise "Artist - Other Song" scores well
+    std::vector<std::string> track_tokens = tokenize(candidate.track_name);
+    int track_hits = 0;
+    for (const auto& t : track_tokens) {
+        if (want_set.count(t)) track_hits++;
+    }
+    if (!track_tokens.empty() && track_hits * 2 < static_cast<int>(track_tokens.size())) {
+        title_score *= 0.5;
+    }
+
+    double score = title_score;
+    if (duration > 0 && candidate.duration > 0) {
+        double diff = std::fabs(duration - candidate.duration);
+        double duration_score = diff <= 2.0 ? 1.0 : std::max(0.0, 1.0 - (diff - 2.0) / 20.0);
+        score = 0.65 * title_score + 0.35 * duration_score;
+    }
+
+    if (candidate.data.has_synced) score += 0.05;
+    return std::min(score, 1.0);
+}
+
+LyricsData LyricsManager::find_lyrics(const std::string& raw_title, const std::string& artist, double duration) {
+    std::string key = cache_key(raw_title, artist);
+    LyricsData cached = load_lrc_file(cached_path(key));
+    if (has_lyrics(cached)) return cached;
+
+    LyricsData data;
+    if (search_network(raw_title, artist, duration, data)) store_cached(key, data);
+    return data;
+}
+
+LyricsData LyricsManager::find_lyrics_for_file(const std::string& path, const std::string& raw_title,
+                                               const std::string& artist, double duration) {
+    // A sidecar is a single stat + read, not worth a thread
+    LyricsData sidecar = load_sidecar(path);
+    if (sidecar.has_synced) return sidecar;
+
+    // ffprobe for tags and the cache lookup run side by side. Providers are ranked
+    // (tags before cache); the first synced answer wins outright, otherwise the best
+    // ranked plain answer is used once everyone has reported.
+    // The workers are detached and may outlive us, so they get copies and no this
+    std::string cached = cached_path(cache_key(raw_title, artist));
+    std::vector<std::function<LyricsData()>> providers = {
+        [path]() { return load_embedded(path); },
+        [cached]() { return load_lrc_file(cached); },
+    };
+
+    struct RaceState {
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::vector<LyricsData> results;
+        std::vector<bool> done;
+        int synced_index = -1;
+        size_t finished = 0;
+    };
+    auto state = std::make_shared<RaceState>();
+    state->results.resize(providers.size());
+    state->done.resize(providers.size(), false);
+
+    for (size_t i = 0; i < providers.size(); ++i) {
+        std::thread([state, i, provider = providers[i]]() {
+            LyricsData data = provider();
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (data.has_synced && state->synced_index == -1) state->synced_index = static_cast<int>(i);
+            state->results[i] = data;
+            state->done[i] = true;
+            state->finished++;
+            state->cv.notify_all();
+        }).detach();
+    }
+
+    LyricsData local = sidecar;
+    {
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->cv.wait_for(lock, std::chrono::seconds(5), [&]() {
+            return state->synced_index != -1 || state->finished == state->done.size();
+        });
+        if (state->synced_index != -1) return state->results[state->synced_index];
+        for (size_t i = 0; i < state->results.size() && !has_lyrics(local); ++i) {
+            if (state->done[i]) local = state->results[i];
+        }
+    }
+
+    // Plain lyrics of our own are shown as they are; the network is only for files without any
+    if (has_lyrics(local)) return local;
+    return find_lyrics(raw_title, artist, duration);
+}
+
+LyricsData LyricsManager::load_sidecar(const std::string& path) {
+    fs::path lrc_path = fs::path(path).replace_extension(".lrc");
+    std::error_code ec;
+    if (!fs::exists(lrc_path, ec)) return {"", {}, false};
+
+    std::ifstream file(lrc_path);
+    std::stringstream ss;
+    ss << file.rdbuf();
+    return parse_lrc(ss.str());
+}
+
+LyricsData LyricsManager::load_embedded(const std::string& path) {
+    // USLT frames show up as "lyrics-XXX", Vorbis comments as LYRICS / UNSYNCEDLYRICS.
+    // ffprobe does not decode binary SYLT frames, but LRC text stored in any of these is parsed as synced.
+    ProcessOptions options;
+    options.timeout_ms = 15000;
+    std::string json = run_process({"ffprobe", "-v", "error", "-of", "json", "-show_entries",
+                                    "format_tags:stream_tags", path}, options).output;
+
+    // Walk every quoted key and keep the first one that looks like a lyrics tag
+    size_t pos = 0;
+    while ((pos = json.find('"', pos)) != std::string::npos) {
+        size_t end = json.find('"', pos + 1);
+        if (end == std::string::npos) break;
+        std::string key = json.substr(pos + 1, end - pos - 1);
+        pos = end + 1;
+
+        std::string lower = key;
+        std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+        if (lower.find("lyrics") == std::string::npos) continue;
+
+        std::string text;
+        if (extract_json_string(json.substr(pos - key.length() - 2), key, text) && !text.empty()) {
+            return parse_lrc(text);
+        }
+    }
+    return {"", {}, false};
+}
+
+std::string LyricsManager::cache_key(const std::string& raw_title, const std::string& artist) {
+    std::string key = artist + "|" + normalize_title(raw_title);
+    std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+    return hash_hex(key);
+}
+
+std::string LyricsManager::cached_path(const std::string& key) {
+    return cache_dir + "/" + key + ".lrc";
+}
+
+LyricsData LyricsManager::load_lrc_file(const std::string& path) {
+    std::ifstream file(path);
+    if (!file.is_open()) return {"", {}, false};
+
+    std::stringstream ss;
+    ss << file.rdbuf();
+    return parse_lrc(ss.str());
+}
+
+void LyricsManager::store_cached(const std::string& key, const LyricsData& data) {
+    std::error_code ec;
+    fs::create_directories(cache_dir, ec);
+
+    std::ostringstream out;
+    if (data.has_synced) {
+        for (const auto& line : data.synced_lyrics) {
+            int minutes = static_cast<int>(line.timestamp) / 60;
+            double seconds = line.timestamp - minutes * 60;
+            char stamp[32];
+            snprintf(stamp, sizeof(stamp), "[%02d:%05.2f] ", minutes, seconds);
+            out << stamp << line.text << "\n";
+        }
+    } else {
+        out << data.plain_lyrics;
+    }
+    std::string contents = out.str();
+
+    // A temp file of its own and a rename, so neither a reader nor another
+    // worker storing the same track ever sees half a file
+    std::string path = cached_path(key);
+    std::string tmp_path = path + ".XXXXXX";
+    int fd = mkstemp(&tmp_path[0]);
+    if (fd < 0) return;
+    size_t written = 0;
+    while (written < contents.size()) {
+        ssize_t n = write(fd, contents.data() + written, contents.size() - written);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        written += n;
+    }
+    close(fd);
+    if (written == contents.size()) fs::rename(tmp_path, path, ec);
+    if (written != contents.size() || ec) fs::remove(tmp_path, ec);
+}
+
+bool LyricsManager::search_network(const std::string& raw_title, const std::string& artist, double duration,
+                                   LyricsData& out) {
+    std::vector<std::string> urls = build_query_urls(raw_title, artist);
+    if (urls.empty()) {
+        out = {"Lyrics not found. Title missing.", {}, false};
+        return false;
+    }
+
+    std::string cleaned = normalize_title(raw_title);
+    std::string wanted = cleaned;
+    if (!artist.empty() && cleaned.find(" - ") == std::string::npos) wanted = artist + " " + cleaned;
+
+    // Shared with the workers; they may outlive this call, and the manager, if we return early
+    struct SearchState {
+        std::mutex mutex;
+        std::condition_variable cv;
+        LyricsCandidate best;
+        bool has_best = false;
+        size_t finished = 0;
+    };
+    auto state = std::make_shared<SearchState>();
+
+    for (const auto& url : urls) {
+        std::thread([state, url, wanted, duration]() {
+            std::string response = perform_request(url);
+            std::vector<LyricsCandidate> candidates = parse_candidates(response);
+
+            std::lock_guard<std::mutex> lock(state->mutex);
+            for (auto& candidate : candidates) {
+                candidate.score = score_candidate(candidate, wanted, duration);
+                if (!state->has_best || candidate.score > state->best.score) {
+                    state->best = candidate;
+                    state->has_best = true;
+                }
+            }
+            state->finished++;
+            state->cv.notify_all();
+        }).detach();
+    }
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->cv.wait_for(lock, std::chrono::seconds(12), [&]() {
+        return state->finished == urls.size() ||
+               (state->has_best && state->best.score >= HIGH_CONFIDENCE_SCORE);
+    });
+
+    if (!state->has_best || state->best.score < MIN_ACCEPT_SCORE) {
+        out = {NOT_FOUND, {}, false};
+        return false;
+    }
+    out = state->best.data;
+    return true;
+}
+
+std::string LyricsManager::perform_request(const std::string& url) {
+    // curl gives up on its own after 10 s; the process timeout only covers a hung curl
+    ProcessOptions options;
+    options.timeout_ms = 12000;
+    return run_process({"curl", "-s", "--max-time", "10", url}, options).output;
 }
 
 LyricsData LyricsManager::parse_json_response(const std::string& json) {
@@ -61,85 +503,18 @@ LyricsData LyricsManager::parse_json_response(const std::string& json) {
     data.has_synced = false;
 
     // Look for "plainLyrics":"
-    std::string plain_key = "\"plainLyrics\":\"";
-    size_t pos = json.find(plain_key);
-    if (pos != std::string::npos) {
-        pos += plain_key.length();
-        std::string lyrics;
-        bool escape = false;
-        for (size_t i = pos; i < json.length(); ++i) {
-            char c = json[i];
-            if (escape) {
-                if (c == 'n') lyrics += '\n';
-                else if (c == 'r') lyrics += '\r';
-                else if (c == 't') lyrics += '\t';
-                else if (c == '"') lyrics += '"';
-                else if (c == '\\') lyrics += '\\';
-                else lyrics += c;
-                escape = false;
-            } else {
-                if (c == '\\') escape = true;
-                else if (c == '"') break;
-                else lyrics += c;
-            }
-        }
+    std::string lyrics;
+    if (extract_json_string(json, "plainLyrics", lyrics)) {
         data.plain_lyrics = lyrics;
     } else {
         data.plain_lyrics = "Lyrics not found in response.";
     }
 
     // Look for "syncedLyrics":"
-    std::string synced_key = "\"syncedLyrics\":\"";
-    pos = json.find(synced_key);
-    if (pos != std::string::npos) {
-        pos += synced_key.length();
-        std::string lyrics;
-        bool escape = false;
-        for (size_t i = pos; i < json.length(); ++i) {
-            char c = json[i];
-            if (escape) {
-                if (c == 'n') lyrics += '\n';
-                else if (c == 'r') lyrics += '\r';
-                else if (c == 't') lyrics += '\t';
-                else if (c == '"') lyrics += '"';
-                else if (c == '\\') lyrics += '\\';
-                else lyrics += c;
-                escape = false;
-            } else {
-                if (c == '\\') escape = true;
-                else if (c == '"') break;
-                else lyrics += c;
-            }
-        }
-        
-        // Parse synced lyrics
-        if (!lyrics.empty()) {
-            std::stringstream ss(lyrics);
-            std::string line;
-            while (std::getline(ss, line)) {
-                if (line.empty()) continue;
-                
-                // Format: [mm:ss.xx] Text
-                size_t bracket_end = line.find(']');
-                if (line.front() == '[' && bracket_end != std::string::npos) {
-                    std::string timestamp_str = line.substr(1, bracket_end - 1);
-                    std::string text = line.substr(bracket_end + 1);
-                    
-                    // Trim leading space from text
-                    if (!text.empty() && text.front() == ' ') {
-                        text = text.substr(1);
-                    }
-                    
-                    double timestamp = parse_timestamp(timestamp_str);
-                    if (timestamp >= 0) {
-                        data.synced_lyrics.push_back({timestamp, text});
-                    }
-                }
-            }
-            if (!data.synced_lyrics.empty()) {
-                data.has_synced = true;
-            }
-        }
+    if (extract_json_string(json, "syncedLyrics", lyrics)) {
+        LyricsData synced = parse_lrc(lyrics);
+        data.synced_lyrics = synced.synced_lyrics;
+        data.has_synced = synced.has_synced;
     }
 
     return data;
@@ -158,3 +533,50 @@ double LyricsManager::parse_timestamp(const std::string& timestamp_str) {
         return -1.0;
     }
 }
+
+LyricsData LyricsManager::parse_lrc(const std::string& text) {
+    LyricsData data;
+    data.has_synced = false;
+
+    std::stringstream ss(text);
+    std::string line;
+    while (std::getline(ss, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty()) continue;
+
+        // Format: [mm:ss.xx] Text, possibly with several stamps: [00:12.00][01:40.00] Text
+        std::vector<double> stamps;
+        size_t pos = 0;
+        while (pos < line.length() && line[pos] == '[') {
+            size_t bracket_end = line.find(']', pos);
+            if (bracket_end == std::string::npos) break;
+            double timestamp = parse_timestamp(line.substr(pos + 1, bracket_end - pos - 1));
+            // Metadata like [ar:Artist] fails to parse and is skipped
+            if (timestamp >= 0) stamps.push_back(timestamp);
+            pos = bracket_end + 1;
+        }
+
+        std::string lyric = line.substr(pos);
+        // Trim leading space from text
+        if (!lyric.empty() && lyric.front() == ' ') {
+            lyric = lyric.substr(1);
+        }
+
+        if (pos == 0) {
+            data.plain_lyrics += line + "\n";
+            continue;
+        }
+        for (double timestamp : stamps) {
+            data.synced_lyrics.push_back({timestamp, lyric});
+        }
+        if (!stamps.empty()) data.plain_lyrics += lyric + "\n";
+    }
+
+    if (!data.synced_lyrics.empty()) {
+        std::stable_sort(data.synced_lyrics.begin(), data.synced_lyrics.end(),
+                         [](const LyricLine& a, const LyricLine& b) { return a.timestamp < b.timestamp; });
+        data.has_synced = true;
+    }
+    if (!data.plain_lyrics.empty() && data.plain_lyrics.back() == '\n') data.plain_lyrics.pop_back();
+    return data;
+}
@@ -15,15 +15,54 @@ struct LyricsData {
     bool has_synced;
 };
 
+// One entry returned by lrclib, scored against what we are playing
+struct LyricsCandidate {
+    std::string track_name;
+    std::string artist_name;
+    double duration; // in seconds, 0 if unknown
+    LyricsData data;
+    double score;
+};
+
 class LyricsManager {
 public:
     LyricsManager();
-    LyricsData fetch_lyrics(const std::string& artist, const std::string& title);
+
+    // Fans out several cleaned-up queries in parallel and returns the best
+    // ranked candidate. Works without an artist; duration may be 0.
+    // Answers come from the on-disk cache when we have seen the track before.
+    LyricsData find_lyrics(const std::string& raw_title, const std::string& artist, double duration);
+
+    // Local files: sidecar .lrc, then embedded tags, then the cache, then the network
+    LyricsData find_lyrics_for_file(const std::string& path, const std::string& raw_title,
+                                    const std::string& artist, double duration);
+
+    // Strips "(Official Video)", "[HD]", "ft. X" and similar noise from titles
+    static std::string normalize_title(const std::string& title);
 
 private:
-    std::string perform_request(const std::string& url);
-    LyricsData parse_json_response(const std::string& json);
-    double parse_timestamp(const std::string& timestamp_str);
+    std::string api_base;
+    std::string cache_dir;
+
+    // Static, as detached workers run them and may outlive the manager
+    static std::string perform_request(const std::string& url);
+    static LyricsData parse_json_response(const std::string& json);
+    static double parse_timestamp(const std::string& timestamp_str);
+    static LyricsData parse_lrc(const std::string& text);
+
+    // Providers; an empty LyricsData (no plain, no synced) means "nothing here"
+    LyricsData load_sidecar(const std::string& path);
+    static LyricsData load_embedded(const std::string& path);
+    static LyricsData load_lrc_file(const std::string& path);
+    std::string cached_path(const std::string& key);
+    void store_cached(const std::string& key, const LyricsData& data);
+    std::string cache_key(const std::string& raw_title, const std::string& artist);
+    // False, with a message for the lyrics pane in out, if nothing good enough was found
+    bool search_network(const std::string& raw_title, const std::string& artist, double duration, LyricsData& out);
+
+    std::vector<std::string> build_query_urls(const std::string& raw_title, const std::string& artist);
+    static std::vector<LyricsCandidate> parse_candidates(const std::string& json);
+    static double score_candidate(const LyricsCandidate& candidate, const std::string& wanted, double duration);
 };
 
 #endif // LYRICS_HPP
@@ -1,69 +1,39 @@
 #include "player.hpp"
 #include "ui.hpp"
 #include "utils.hpp"
+#include "daemon.hpp"
 #include <iostream>
 #include <string>
 #include <vector>
-#include <filesystem>
-
-namespace fs = std::filesystem;
+#include <chrono>
 
 int main(int argc, char* argv[]) {
-    std::vector<std::string> startup_errors;
+    auto startup_time = std::chrono::steady_clock::now();
+    std::vector<std::string> args(argv + 1, argv + argc);
+    if (!args.empty() && args[0] == "--ctl") {
+        return run_control_client(std::vector<std::string>(args.begin() + 1, args.end()));
+    }
+    
     try {
         Player player;
-        bool start_playback = false;
-
-        
-        for (int i = 1; i < argc; ++i) {
-            std::string input = argv[i];
-
-            
-            std::string url_to_play = input;
-            if (is_url(input)) {
-                std::cout << "Resolving URL: " << input << "..." << std::endl;
-                try {
-                    url_to_play = get_youtube_stream_url(input);
-                } catch (const std::exception& e) {
-                    std::cerr << "Error resolving URL " << input << ": " << e.what() << std::endl;
-                    startup_errors.push_back("Failed: " + input);
-                    continue; 
-                }
-            } else {
-                if (!fs::exists(input)) {
-                    // Treat as search query if not a file
-                    std::cout << "Searching for: " << input << "..." << std::endl;
-                    // We can't easily do "Search & Play" here without instantiating Search
-                    // So let's just warn for now or assume it's a file error
-                     std::cerr << "File not found: " << input << std::endl;
-                     startup_errors.push_back("Not Found: " + input);
-                     continue;
-                }
-            }
-            
-            try {
-                if (!start_playback) {
-                    player.load(url_to_play, "replace");
-                    start_playback = true;
-                } else {
-                    player.load(url_to_play, "append-play");
-                }
-            } catch (const std::exception& e) {
-                startup_errors.push_back("Load Error: " + std::string(e.what()));
-            }
+        if (!args.empty() && args[0] == "--daemon") {
+            // No terminal needed; arguments after the flag are queued like on the TUI
+            Daemon daemon(player);
+            for (size_t i = 1; i < args.size(); ++i) daemon.enqueue(args[i]);
+            daemon.run();
+            return 0;
         }
         
-        if (start_playback) player.play(); 
-
         UI ui(player);
-        
-        if (!start_playback && argc == 1) {
+        ui.set_startup_time(startup_time);
+
+        // Without arguments, play on from the last session or show the intro
+        if (argc == 1 && !ui.resume_session()) {
             ui.set_mode(AppMode::INTRO);
         }
         
-        for (const auto& err : startup_errors) {
-            ui.show_message(err);
-        }
+        // URLs resolve in parallel while the UI is already up
+        ui.queue_startup_inputs(args);
         
         ui.run();
     } catch (const std::exception& e) {
@@ -0,0 +1,239 @@
+#include "onset.hpp"
+#include "track_analyzer.hpp"
+#include "waveform.hpp"
+#include <cmath>
+#include <algorithm>
+
+static const float PI = 3.14159265358979f;
+static const int THRESHOLD_RADIUS = 8;   // frames each side in the moving average, about 0.2 s
+static const int PEAK_RADIUS = 3;        // an onset is the largest flux within this many frames
+static const int MIN_GAP = 4;            // frames between onsets, about 90 ms
+static const double MIN_BPM = 60.0;
+static const double MAX_BPM = 200.0;
+static_assert(OnsetDetector::SAMPLE_RATE == TrackAnalyzer::SAMPLE_RATE, "the detector reads the analyzer's decode");
+
+OnsetDetector::OnsetDetector()
+    : window(FRAME), twiddles(FRAME / 2), reversed(FRAME), previous(FRAME / 2, 0.0f), spectrum(FRAME) {
+    for (int i = 0; i < FRAME; ++i) window[i] = 0.5f - 0.5f * std::cos(2.0f * PI * i / FRAME);
+    for (int i = 0; i < FRAME / 2; ++i) twiddles[i] = std::polar(1.0f, -2.0f * PI * i / FRAME);
+    int bits = 0;
+    while ((1 << bits) < FRAME) bits++;
+    for (uint32_t i = 0; i < static_cast<uint32_t>(FRAME); ++i) {
+        uint32_t r = 0;
+        for (int b = 0; b < bits; ++b) r |= ((i >> b) & 1u) << (bits - 1 - b);
+        reversed[i] = r;
+    }
+}
+
+void OnsetDetector::feed(const int16_t* samples, size_t count) {
+    for (size_t i = 0; i < count; ++i) pending.push_back(samples[i] / 32768.0f);
+    size_t offset = 0;
+    while (pending.size() - offset >= static_cast<size_t>(FRAME)) {
+        process_frame(pending.data() + offset);
+        offset += HOP;
+    }
+    pending.erase(pending.begin(), pending.begin() + offset);
+}
+
+void OnsetDetector::process_frame(const float* samples) {
+    for (int i = 0; i < FRAME; ++i) spectrum[reversed[i]] = samples[i] * window[i];
+
+    // Iterative radix-2 FFT; the frame size is fixed, so the tables are built once
+    for (int size = 2; size <= FRAME; size <<= 1) {
+        int half = size / 2;
+        int step = FRAME / size;
+        for (int start = 0; start < FRAME; start += size) {
+            for (int k = 0; k < half; ++k) {
+                std::complex<float> odd = spectrum[start + k + half] * twiddles[k * step];
+                spectrum[start + k + half] = spectrum[start + k] - odd;
+                spectrum[start + k] += odd;
+            }
+        }
+    }
+
+    // Only rising energy counts; log compression keeps loud passages from dominating
+    float sum = 0.0f;
+    for (int k = 1; k < FRAME / 2; ++k) {
+        float magnitude = std::log1p(100.0f * std::abs(spectrum[k]) / FRAME);
+        float rise = magnitude - previous[k];
+        if (rise > 0.0f) sum += rise;
+        previous[k] = magnitude;
+    }
+    flux.push_back(sum);
+}
+
+BeatGrid OnsetDetector::finish() const {
+    BeatGrid grid;
+    const int count = static_cast<int>(flux.size());
+    if (count < 2 * THRESHOLD_RADIUS) return grid;
+    const double frames_per_second = static_cast<double>(SAMPLE_RATE) / HOP;
+
+    std::vector<double> prefix(count + 1, 0.0);
+    for (int t = 0; t < count; ++t) prefix[t + 1] = prefix[t] + flux[t];
+    float overall = static_cast<float>(prefix[count] / count);
+
+    // Moving average threshold, plus a floor so near-silence does not trigger
+    std::vector<float> local(count);
+    for (int t = 0; t < count; ++t) {
+        int from = std::max(0, t - THRESHOLD_RADIUS);
+        int to = std::min(count, t + THRESHOLD_RADIUS + 1);
+        local[t] = static_cast<float>((prefix[to] - prefix[from]) / (to - from));
+    }
+
+    float strongest = 0.0f;
+    std::vector<float> excess;
+    int last = -MIN_GAP;
+    for (int t = 0; t < count; ++t) {
+        float threshold = 1.3f * local[t] + 0.1f * overall;
+        if (flux[t] <= threshold || t - last < MIN_GAP) continue;
+        bool peak = true;
+        for (int d = 1; d <= PEAK_RADIUS && peak; ++d) {
+            if (t - d >= 0 && flux[t - d] > flux[t]) peak = false;
+            if (t + d < count && flux[t + d] > flux[t]) peak = false;
+        }
+        if (!peak) continue;
+        grid.onsets.push_back(static_cast<float>((t * HOP + FRAME / 2) / static_cast<double>(SAMPLE_RATE)));
+        excess.push_back(flux[t] - threshold);
+        strongest = std::max(strongest, flux[t] - threshold);
+        last = t;
+    }
+    for (float value : excess) grid.strength.push_back(strongest > 0.0f ? std::sqrt(value / strongest) : 0.0f);
+
+    // Tempo: autocorrelation of the part of the flux above its local average,
+    // smoothed so a beat period between two whole lags still lines up, and
+    // made zero-mean so that noise correlates with nothing
+    std::vector<float> rising(count);
+    for (int t = 0; t < count; ++t) rising[t] = std::max(0.0f, flux[t] - local[t]);
+    std::vector<float> envelope(count);
+    double mean = 0.0;
+    for (int t = 0; t < count; ++t) {
+        float before = rising[std::max(0, t - 1)], after = rising[std::min(count - 1, t + 1)];
+        envelope[t] = 0.25f * before + 0.5f * rising[t] + 0.25f * after;
+        mean += envelope[t];
+    }
+    mean /= count;
+    for (float& value : envelope) value -= static_cast<float>(mean);
+    double energy = 0.0;
+    for (float value : envelope) energy += static_cast<double>(value) * value;
+    if (energy <= 0.0) return grid;
+
+    int min_lag = static_cast<int>(frames_per_second * 60.0 / MAX_BPM);
+    int max_lag = std::min(count - 1, static_cast<int>(frames_per_second * 60.0 / MIN_BPM) + 1);
+    std::vector<double> correlation(max_lag + 2, 0.0);
+    for (int lag = std::max(1, min_lag - 1); lag <= max_lag + 1 && lag < count; ++lag) {
+        double sum = 0.0;
+        for (int t = lag; t < count; ++t) sum += static_cast<double>(envelope[t]) * envelope[t - lag];
+        correlation[lag] = sum / energy;
+    }
+
+    int best = 0;
+    double best_score = 0.0;
+    for (int lag = std::max(1, min_lag); lag <= max_lag; ++lag) {
+        double bpm = 60.0 * frames_per_second / lag;
+        double octaves = std::log2(bpm / 120.0);
+        double score = correlation[lag] * std::exp(-0.5 * octaves * octaves);
+        if (score > best_score) {
+            best_score = score;
+            best = lag;
+        }
+    }
+    // Weak periodicity is no tempo at all (speech, ambient, rubato)
+    if (best == 0 || correlation[best] < 0.1) return grid;
+
+    // Parabolic interpolation between neighbouring lags for sub-frame precision
+    double lag = best;
+    double before = correlation[best - 1], at = correlation[best], after = correlation[best + 1];
+    double curve = before - 2.0 * at + after;
+    if (curve < 0.0) lag += 0.5 * (before - after) / curve;
+    grid.bpm = 60.0 * frames_per_second / lag;
+    return grid;
+}
+
+BeatTracker::BeatTracker(TrackAnalyzer& a) : analyzer(a), last_position(0.0), cursor(0) {}
+
+BeatTracker::~BeatTracker() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (job) job->cancelled = true;
+        job.reset();
+    }
+    // Joined without the lock, which a finishing analysis takes to publish its grid
+    for (auto& entry : threads) entry.second.join();
+}
+
+void BeatTracker::reap() {
+    for (auto it = threads.begin(); it != threads.end();) {
+        if (it->first->done) {
+            it->second.join();
+            it = threads.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void BeatTracker::start(const std::string& key, const std::string& file) {
+    std::lock_guard<std::mutex> lock(mutex);
+    // The old analysis is cancelled but not waited for; its thread is joined once it has finished
+    if (job) job->cancelled = true;
+    reap();
+    job.reset();
+    grid.reset();
+    last_position = 0.0;
+    cursor = 0;
+    if (file.empty()) return;
+
+    job = std::make_shared<Job>();
+    threads.emplace_back(job, std::thread(&BeatTracker::analyze, this, job, key, file));
+}
+
+void BeatTracker::analyze(std::shared_ptr<Job> current, std::string key, std::string file) {
+    bool loudness, waveform;
+    analyzer.missing(key, loudness, waveform);
+    OnsetDetector detector;
+    WaveformReducer reducer(TrackAnalyzer::SAMPLE_RATE);
+    TrackAnalysis measured;
+    bool decoded = TrackAnalyzer::decode(file, [&](const int16_t* samples, size_t count) {
+        detector.feed(samples, count);
+        if (waveform) reducer.feed(samples, count);
+    }, loudness ? &measured : nullptr, &current->cancelled);
+
+    if (decoded && !current->cancelled) {
+        if (waveform) measured.waveform = reducer.finish();
+        analyzer.store(key, measured, loudness, waveform);
+        auto result = std::make_shared<const BeatGrid>(detector.finish());
+        std::lock_guard<std::mutex> lock(mutex);
+        if (job == current) grid = result;
+    }
+    current->done = true;
+}
+
+bool BeatTracker::ready() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return grid != nullptr;
+}
+
+double BeatTracker::bpm() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return grid ? grid->bpm : 0.0;
+}
+
+float BeatTracker::pulse(double position) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!grid) return 0.0f;
+    const auto& onsets = grid->onsets;
+
+    // Backwards or a big jump forwards is a seek: resync without firing
+    if (position < last_position || position - last_position > 1.0) {
+        cursor = std::upper_bound(onsets.begin(), onsets.end(), static_cast<float>(position)) - onsets.begin();
+        last_position = position;
+        return 0.0f;
+    }
+    float strength = 0.0f;
+    while (cursor < onsets.size() && onsets[cursor] <= position) {
+        strength = std::max(strength, grid->strength[cursor]);
+        cursor++;
+    }
+    last_position = position;
+    return strength;
+}
@@ -0,0 +1,86 @@
+#ifndef ONSET_HPP
+#define ONSET_HPP
+
+#include <string>
+#include <vector>
+#include <complex>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <cstdint>
+
+class TrackAnalyzer;
+
+// Where the track has its beats, found once per track
+struct BeatGrid {
+    std::vector<float> onsets;   // seconds from the start, ascending
+    std::vector<float> strength; // 0..1 for each onset
+    double bpm = 0.0;            // 0 if no steady tempo was found
+};
+
+// Spectral-flux onset detector over mono 16-bit PCM: 512-sample Hann frames,
+// hop 256, flux of the log magnitudes, peaks picked against a moving-average
+// threshold. The tempo is the strongest autocorrelation lag of the flux
+// between 60 and 200 BPM, leaning towards 120 to avoid octave errors.
+class OnsetDetector {
+public:
+    static const int SAMPLE_RATE = 11025;
+
+    OnsetDetector();
+    void feed(const int16_t* samples, size_t count);
+    BeatGrid finish() const;
+
+private:
+    static const int FRAME = 512;
+    static const int HOP = 256;
+
+    std::vector<float> window;
+    std::vector<std::complex<float>> twiddles;
+    std::vector<uint32_t> reversed;
+    std::vector<float> pending;  // samples not yet covered by a whole frame
+    std::vector<float> previous; // log magnitudes of the last frame
+    std::vector<std::complex<float>> spectrum;
+    std::vector<float> flux;     // one value per hop
+
+    void process_frame(const float* samples);
+};
+
+// Runs the detector on the file being played, in a background thread with
+// ffmpeg at low priority, and answers per-frame questions from the UI with a
+// cursor into the grid, so the visualizer pays a comparison or two per frame.
+// The decode is TrackAnalyzer's, so whatever the analyzer still lacks for the
+// track comes out of it too and nothing decodes the file a second time.
+class BeatTracker {
+public:
+    explicit BeatTracker(TrackAnalyzer& analyzer);
+    ~BeatTracker();
+
+    // Starts over for a new track stored under `key`; "" for the file (e.g. an
+    // uncached stream) only clears
+    void start(const std::string& key, const std::string& file);
+    bool ready();
+    double bpm();
+    // Strength of the strongest onset passed since the last call, 0 if none;
+    // after a seek the cursor just jumps to the new position
+    float pulse(double position);
+
+private:
+    struct Job {
+        std::atomic<bool> cancelled{false};
+        std::atomic<bool> done{false};
+    };
+
+    TrackAnalyzer& analyzer;
+    std::mutex mutex;
+    std::shared_ptr<const BeatGrid> grid; // null until the analysis is done
+    std::shared_ptr<Job> job;
+    std::vector<std::pair<std::shared_ptr<Job>, std::thread>> threads;
+    double last_position;
+    size_t cursor;
+
+    void analyze(std::shared_ptr<Job> job, std::string key, std::string file);
+    void reap(); // joins threads whose analysis has finished
+};
+
+#endif // ONSET_HPP
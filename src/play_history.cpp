@@ -0,0 +1,333 @@
+#include "play_history.hpp"
+#include "utils.hpp"
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <unordered_set>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+namespace fs = std::filesystem;
+
+static_assert(sizeof(PlayRecord) == 32, "history.log records are 32 bytes");
+
+static const size_t RECORD = sizeof(PlayRecord);
+static const char* LOG_HEADER = "vibe-fi history log 1\n"; // padded to one record
+static const char* INDEX_HEADER = "vibe-fi history index 1";
+static const uint64_t SUMMARY_EVERY = 256;  // records folded in before the summary is rewritten
+static const size_t CHUNK = 256;            // records per read
+static const size_t RECENT_SCAN = 4096;     // records looked at for the recent list, newest first
+static const double MIN_RECORDED_S = 1.0;
+
+PlayHistory::PlayHistory()
+    : loaded(false), log_fd(-1), covered(0), tracks_read(0), summary_covered(0) {
+    std::string dir = get_vibe_dir();
+    log_path = dir + "/history.log";
+    tracks_path = dir + "/history.tracks";
+    index_path = dir + "/history.idx";
+}
+
+PlayHistory::~PlayHistory() {
+    end();
+    if (log_fd < 0) return;
+    if (covered > summary_covered) write_summary();
+    close(log_fd);
+}
+
+void PlayHistory::begin(const std::string& key, const std::string& title, PlaySource source) {
+    end();
+    current.active = true;
+    current.key = key;
+    current.title = title;
+    current.source = source;
+    current.started = static_cast<int64_t>(time(nullptr));
+    current.listened = 0.0;
+    current.paused = false;
+    current.resumed = std::chrono::steady_clock::now();
+    current.position = 0.0;
+    current.duration = 0.0;
+}
+
+void PlayHistory::set_paused(bool paused) {
+    if (paused == current.paused) return;
+    auto now = std::chrono::steady_clock::now();
+    if (paused) current.listened += std::chrono::duration<double>(now - current.resumed).count();
+    else current.resumed = now;
+    current.paused = paused;
+}
+
+void PlayHistory::update(double position, double duration) {
+    if (!current.active) return;
+    current.position = position;
+    if (duration > 0) current.duration = duration;
+}
+
+void PlayHistory::end(bool finished) {
+    if (!current.active) return;
+    current.active = false;
+    if (finished && current.duration > 0) current.position = current.duration;
+    double listened = current.listened;
+    if (!current.paused) {
+        listened += std::chrono::duration<double>(std::chrono::steady_clock::now() - current.resumed).count();
+    }
+    // One line per track in history.tracks, so keys cannot contain the separators
+    if (listened < MIN_RECORDED_S || current.key.find_first_of("\t\n") != std::string::npos) return;
+
+    load();
+    if (log_fd < 0) return;
+    uint64_t id = hash_string(current.key);
+    Track& track = tracks[id];
+    if (!track.named) {
+        std::string title = current.title;
+        std::replace_if(title.begin(), title.end(), [](char c) { return c == '\t' || c == '\n'; }, ' ');
+        char prefix[32];
+        snprintf(prefix, sizeof(prefix), "%016llx\t%d\t", static_cast<unsigned long long>(id), static_cast<int>(current.source));
+        std::string line = prefix + current.key + "\t" + title + "\n";
+        // One write on an O_APPEND descriptor, so lines from several processes never interleave
+        int fd = open(tracks_path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd < 0) return;
+        bool written = write(fd, line.data(), line.size()) == static_cast<ssize_t>(line.size());
+        close(fd);
+        if (!written) return;
+        track.key = current.key;
+        track.title = title;
+        track.source = current.source;
+        track.named = true;
+    }
+
+    PlayRecord record{};
+    record.track = id;
+    record.started = current.started;
+    record.listened = static_cast<uint32_t>(listened + 0.5);
+    record.position = static_cast<uint32_t>(std::max(0.0, current.position));
+    record.duration = static_cast<uint32_t>(std::max(0.0, current.duration));
+    record.source = static_cast<uint8_t>(current.source);
+    if (write(log_fd, &record, RECORD) != static_cast<ssize_t>(RECORD)) return;
+    // Folded in by reading it back, in order with whatever other processes appended
+    catch_up();
+}
+
+void PlayHistory::load() {
+    if (loaded) return;
+    loaded = true;
+    std::error_code ec;
+    fs::create_directories(fs::path(log_path).parent_path(), ec);
+    log_fd = open(log_path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (log_fd < 0) return;
+
+    struct stat info;
+    char header[RECORD] = {};
+    if (fstat(log_fd, &info) != 0) {
+        close(log_fd);
+        log_fd = -1;
+        return;
+    }
+    if (info.st_size == 0) {
+        memcpy(header, LOG_HEADER, strlen(LOG_HEADER));
+        if (write(log_fd, header, RECORD) != static_cast<ssize_t>(RECORD)) {
+            close(log_fd);
+            log_fd = -1;
+            return;
+        }
+    } else if (pread(log_fd, header, RECORD, 0) != static_cast<ssize_t>(RECORD) ||
+               memcmp(header, LOG_HEADER, strlen(LOG_HEADER)) != 0) {
+        // Not a log this version can read; left alone rather than appended to
+        close(log_fd);
+        log_fd = -1;
+        return;
+    } else if (info.st_size % RECORD != 0) {
+        // A record cut short by a crash would shift every record after it
+        if (ftruncate(log_fd, info.st_size - info.st_size % RECORD) != 0) {
+            close(log_fd);
+            log_fd = -1;
+            return;
+        }
+    }
+    covered = RECORD;
+    summary_covered = RECORD;
+
+    read_tracks();
+    read_summary();
+    catch_up();
+}
+
+void PlayHistory::read_tracks() {
+    std::ifstream file(tracks_path, std::ios::binary);
+    if (!file) return;
+    file.seekg(static_cast<std::streamoff>(tracks_read));
+
+    // id \t source \t key \t title
+    std::string line;
+    while (std::getline(file, line)) {
+        if (file.eof()) break; // No newline yet: another process is still writing it
+        tracks_read += line.size() + 1;
+        size_t source_at = line.find('\t');
+        if (source_at == std::string::npos) continue;
+        size_t key_at = line.find('\t', source_at + 1);
+        if (key_at == std::string::npos) continue;
+        size_t title_at = line.find('\t', key_at + 1);
+        if (title_at == std::string::npos) continue;
+
+        Track& track = tracks[strtoull(line.substr(0, source_at).c_str(), nullptr, 16)];
+        track.source = atoi(line.c_str() + source_at + 1) == static_cast<int>(PlaySource::STREAM) ?
+                       PlaySource::STREAM : PlaySource::LOCAL;
+        track.key = line.substr(key_at + 1, title_at - key_at - 1);
+        track.title = line.substr(title_at + 1);
+        track.named = true;
+    }
+}
+
+void PlayHistory::read_summary() {
+    std::ifstream file(index_path);
+    std::string line;
+    if (!std::getline(file, line) || line != INDEX_HEADER) return;
+    unsigned long long offset = 0;
+    if (!std::getline(file, line) || sscanf(line.c_str(), "covers %llu", &offset) != 1) return;
+
+    // A summary of a longer (replaced or truncated) log is no use
+    struct stat info;
+    if (fstat(log_fd, &info) != 0 || offset < RECORD || offset % RECORD != 0 ||
+        offset > static_cast<unsigned long long>(info.st_size)) {
+        return;
+    }
+
+    // id \t plays \t listened \t last played
+    while (std::getline(file, line)) {
+        unsigned long long id, listened;
+        unsigned plays;
+        long long last_played;
+        if (sscanf(line.c_str(), "%llx\t%u\t%llu\t%lld", &id, &plays, &listened, &last_played) != 4) continue;
+        Track& track = tracks[id];
+        track.plays = plays;
+        track.listened = listened;
+        track.last_played = last_played;
+    }
+    covered = offset;
+    summary_covered = offset;
+}
+
+void PlayHistory::catch_up() {
+    if (log_fd < 0) return;
+    struct stat info;
+    if (fstat(log_fd, &info) != 0) return;
+    uint64_t end = static_cast<uint64_t>(info.st_size) - static_cast<uint64_t>(info.st_size) % RECORD;
+
+    PlayRecord chunk[CHUNK];
+    bool unnamed = false;
+    while (covered < end) {
+        size_t want = static_cast<size_t>(std::min<uint64_t>(sizeof(chunk), end - covered));
+        ssize_t got = pread(log_fd, chunk, want, static_cast<off_t>(covered));
+        if (got <= 0) break;
+        size_t count = static_cast<size_t>(got) / RECORD;
+        for (size_t i = 0; i < count; ++i) {
+            fold(chunk[i]);
+            if (!tracks[chunk[i].track].named) unnamed = true;
+        }
+        covered += count * RECORD;
+    }
+    // Tracks another process played first
+    if (unnamed) read_tracks();
+    if (covered - summary_covered >= SUMMARY_EVERY * RECORD) write_summary();
+}
+
+bool PlayHistory::counts_as_play(const PlayRecord& record) {
+    // Half the track or four minutes, whichever comes first, as scrobblers count it
+    uint32_t needed = record.duration > 0 ? std::min<uint32_t>(record.duration / 2, 240) : 30;
+    return record.listened > 0 && record.listened >= needed;
+}
+
+void PlayHistory::fold(const PlayRecord& record) {
+    Track& track = tracks[record.track];
+    if (counts_as_play(record)) track.plays++;
+    track.listened += record.listened;
+    track.last_played = std::max(track.last_played, static_cast<int64_t>(record.started));
+}
+
+void PlayHistory::write_summary() {
+    std::string tmp_path = index_path + ".tmp";
+    {
+        std::ofstream file(tmp_path, std::ios::trunc);
+        if (!file) return;
+        file << INDEX_HEADER << "\n" << "covers " << covered << "\n";
+        char line[96];
+        for (const auto& [id, track] : tracks) {
+            if (track.plays == 0 && track.listened == 0) continue;
+            snprintf(line, sizeof(line), "%016llx\t%u\t%llu\t%lld\n", static_cast<unsigned long long>(id), track.plays,
+                     static_cast<unsigned long long>(track.listened), static_cast<long long>(track.last_played));
+            file << line;
+        }
+        if (!file) return;
+    }
+    std::error_code ec;
+    fs::rename(tmp_path, index_path, ec);
+    if (!ec) summary_covered = covered;
+}
+
+HistoryEntry PlayHistory::entry_for(const Track& track) const {
+    HistoryEntry entry;
+    entry.key = track.key;
+    entry.title = track.title;
+    entry.source = track.source;
+    entry.last_played = track.last_played;
+    entry.position = 0;
+    entry.duration = 0;
+    entry.plays = track.plays;
+    entry.listened = track.listened;
+    return entry;
+}
+
+std::vector<HistoryEntry> PlayHistory::recent(size_t limit) {
+    load();
+    catch_up();
+    std::vector<HistoryEntry> result;
+    if (log_fd < 0) return result;
+
+    // Backwards from the end of the log, a chunk at a time
+    std::unordered_set<uint64_t> seen;
+    PlayRecord chunk[CHUNK];
+    uint64_t end = covered;
+    size_t scanned = 0;
+    while (end > RECORD && result.size() < limit && scanned < RECENT_SCAN) {
+        uint64_t from = std::max<uint64_t>(RECORD, end - std::min<uint64_t>(end, sizeof(chunk)));
+        ssize_t got = pread(log_fd, chunk, static_cast<size_t>(end - from), static_cast<off_t>(from));
+        if (got != static_cast<ssize_t>(end - from)) break;
+        size_t count = static_cast<size_t>(got) / RECORD;
+        for (size_t i = count; i-- > 0 && result.size() < limit;) {
+            const PlayRecord& record = chunk[i];
+            if (!seen.insert(record.track).second) continue;
+            auto it = tracks.find(record.track);
+            if (it == tracks.end() || !it->second.named) continue;
+            HistoryEntry entry = entry_for(it->second);
+            entry.last_played = record.started;
+            entry.position = record.position;
+            entry.duration = record.duration;
+            result.push_back(std::move(entry));
+        }
+        scanned += count;
+        end = from;
+    }
+    return result;
+}
+
+std::vector<HistoryEntry> PlayHistory::most_played(size_t limit) {
+    load();
+    catch_up();
+    std::vector<const Track*> played;
+    for (const auto& [id, track] : tracks) {
+        if (track.named && track.plays > 0) played.push_back(&track);
+    }
+    size_t count = std::min(limit, played.size());
+    std::partial_sort(played.begin(), played.begin() + count, played.end(), [](const Track* a, const Track* b) {
+        if (a->plays != b->plays) return a->plays > b->plays;
+        return a->listened > b->listened;
+    });
+
+    std::vector<HistoryEntry> result;
+    for (size_t i = 0; i < count; ++i) result.push_back(entry_for(*played[i]));
+    return result;
+}
@@ -0,0 +1,111 @@
+#ifndef PLAY_HISTORY_HPP
+#define PLAY_HISTORY_HPP
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <chrono>
+#include <cstdint>
+
+enum class PlaySource : uint8_t {
+    LOCAL = 1,
+    STREAM = 2
+};
+
+// One play in ~/.vibe-fi/history.log. Records have a fixed size, so the
+// newest plays are read straight from the end of the file.
+struct PlayRecord {
+    uint64_t track;     // hash_string() of the key
+    int64_t started;    // unix time
+    uint32_t listened;  // seconds actually played, pauses not counted
+    uint32_t position;  // seconds into the track when it stopped
+    uint32_t duration;  // seconds, 0 if unknown
+    uint8_t source;     // PlaySource
+    uint8_t reserved[3];
+};
+
+// A track as the history views show it
+struct HistoryEntry {
+    std::string key;        // path or webpage URL
+    std::string title;
+    PlaySource source;
+    int64_t last_played;    // unix time the latest play started
+    uint32_t position;      // where the latest play stopped, seconds
+    uint32_t duration;
+    uint32_t plays;         // plays that got through half the track, or four minutes
+    uint64_t listened;      // seconds over all plays
+};
+
+// Play history of every vibe-fi process: an append-only log of PlayRecords,
+// the keys and titles of the tracks in them (history.tracks, one line per
+// track), and a summary of the per-track totals up to some log offset
+// (history.idx), rewritten every few hundred plays. Loading reads the summary
+// and only the records after it, however long the log has grown. Not
+// thread-safe; nothing is read until first use.
+class PlayHistory {
+public:
+    PlayHistory();
+    ~PlayHistory(); // Records the play in progress and writes the summary
+
+    // A track started; the one before it is recorded
+    void begin(const std::string& key, const std::string& title, PlaySource source);
+    void set_paused(bool paused);
+    // Where the track playing is, so the record knows where it stopped
+    void update(double position, double duration);
+    // Playback stopped; records the track playing, if any. A track that
+    // finished stopped at its end, whatever the last update said.
+    void end(bool finished = false);
+
+    // Newest first, each track once
+    std::vector<HistoryEntry> recent(size_t limit);
+    // Most plays first, tracks never played through left out
+    std::vector<HistoryEntry> most_played(size_t limit);
+
+private:
+    struct Track {
+        std::string key;
+        std::string title;
+        PlaySource source = PlaySource::LOCAL;
+        bool named = false; // key and title known from history.tracks
+        uint32_t plays = 0;
+        uint64_t listened = 0;
+        int64_t last_played = 0;
+    };
+
+    // The play in progress
+    struct Current {
+        bool active = false;
+        std::string key;
+        std::string title;
+        PlaySource source = PlaySource::LOCAL;
+        int64_t started = 0;
+        double listened = 0.0; // before the last resume
+        bool paused = false;
+        std::chrono::steady_clock::time_point resumed;
+        double position = 0.0;
+        double duration = 0.0;
+    };
+
+    std::string log_path;
+    std::string tracks_path;
+    std::string index_path;
+    bool loaded;
+    int log_fd;                 // -1 if the log cannot be used
+    uint64_t covered;           // log bytes folded into tracks
+    uint64_t tracks_read;       // bytes of history.tracks read
+    uint64_t summary_covered;   // log bytes the summary on disk covers
+    std::unordered_map<uint64_t, Track> tracks;
+    Current current;
+
+    void load();
+    void read_tracks();
+    void read_summary();
+    // Folds in records appended since the last call, by this process or another
+    void catch_up();
+    void fold(const PlayRecord& record);
+    void write_summary();
+    HistoryEntry entry_for(const Track& track) const;
+    static bool counts_as_play(const PlayRecord& record);
+};
+
+#endif // PLAY_HISTORY_HPP
@@ -0,0 +1,174 @@
+#include "play_queue.hpp"
+#include <algorithm>
+
+static const size_t MAX_HISTORY = 1000;
+static const size_t MAX_RECENT = 50; // tracks held back at the start of a new shuffle pass
+static const int RECENT_RETRIES = 8;
+
+PlayQueue::PlayQueue()
+    : count(0), playing(-1), shuffled(false), repeat_mode(RepeatMode::OFF), consumed(0), drawn(0),
+      rng(std::random_device{}()) {}
+
+void PlayQueue::reset(size_t items, size_t start) {
+    clear();
+    count = items;
+    recent_bits.assign((count + 63) / 64, 0);
+    if (start < count) {
+        if (shuffled) take(start);
+        move_to(start);
+    }
+}
+
+void PlayQueue::clear() {
+    count = 0;
+    playing = -1;
+    history.clear();
+    forward.clear();
+    recent_bits.clear();
+    recent_order.clear();
+    new_pass();
+}
+
+void PlayQueue::append() {
+    // The new position is past everything swapped so far, so a pass in progress just gains it
+    count++;
+    recent_bits.resize((count + 63) / 64, 0);
+}
+
+int PlayQueue::peek_next() {
+    if (repeat_mode == RepeatMode::ONE && playing != -1) return playing;
+    return following();
+}
+
+int PlayQueue::next() {
+    if (repeat_mode == RepeatMode::ONE && playing != -1) return playing;
+    return skip();
+}
+
+int PlayQueue::skip() {
+    int target = following();
+    if (target == -1) return -1;
+    if (!forward.empty()) forward.pop_back();
+    else if (shuffled) consumed++; // following() drew it at the head of the pass
+    move_to(target);
+    return target;
+}
+
+int PlayQueue::previous() {
+    if (history.empty()) return -1;
+    if (playing != -1) forward.push_back(playing);
+    playing = static_cast<int>(history.back());
+    history.pop_back();
+    return playing;
+}
+
+void PlayQueue::jump(size_t index) {
+    if (index >= count) return;
+    forward.clear();
+    if (shuffled) take(index);
+    move_to(index);
+}
+
+void PlayQueue::set_shuffle(bool on) {
+    if (on == shuffled) return;
+    shuffled = on;
+    forward.clear();
+    if (!on) return;
+    // The track playing counts as the first of the new pass
+    new_pass();
+    if (playing != -1) take(playing);
+}
+
+void PlayQueue::set_repeat(RepeatMode mode) {
+    repeat_mode = mode;
+}
+
+int PlayQueue::following() {
+    if (playing == -1 || count == 0) return -1;
+    if (!forward.empty()) return static_cast<int>(forward.back());
+    if (!shuffled) {
+        if (static_cast<size_t>(playing) + 1 < count) return playing + 1;
+        return repeat_mode == RepeatMode::ALL ? 0 : -1;
+    }
+    if (consumed >= count) {
+        if (repeat_mode != RepeatMode::ALL) return -1;
+        new_pass();
+    }
+    if (drawn == consumed) draw();
+    return static_cast<int>(value_at(consumed));
+}
+
+void PlayQueue::move_to(size_t index) {
+    if (playing != -1) {
+        history.push_back(playing);
+        if (history.size() > MAX_HISTORY) history.pop_front();
+    }
+    playing = static_cast<int>(index);
+    mark_recent(index);
+}
+
+void PlayQueue::new_pass() {
+    value_at_position.clear();
+    position_of_value.clear();
+    consumed = 0;
+    drawn = 0;
+}
+
+void PlayQueue::take(size_t index) {
+    size_t position = position_of(index);
+    if (position < consumed) return; // already played in this pass
+    // A track peeked at the head goes back in the hat
+    swap_positions(consumed, position);
+    consumed++;
+    drawn = std::max(drawn, consumed);
+}
+
+void PlayQueue::draw() {
+    // One Fisher-Yates step: any position still in the hat comes to the head.
+    // The recent window is at most half the list, so a retry or two finds a
+    // track not heard lately; after that it gives up and takes what it got.
+    std::uniform_int_distribution<size_t> pick_from(consumed, count - 1);
+    size_t pick = pick_from(rng);
+    for (int tries = 0; tries < RECENT_RETRIES && is_recent(value_at(pick)); ++tries) pick = pick_from(rng);
+    swap_positions(consumed, pick);
+    drawn = consumed + 1;
+}
+
+size_t PlayQueue::value_at(size_t position) const {
+    auto it = value_at_position.find(position);
+    return it == value_at_position.end() ? position : it->second;
+}
+
+size_t PlayQueue::position_of(size_t value) const {
+    auto it = position_of_value.find(value);
+    return it == position_of_value.end() ? value : it->second;
+}
+
+void PlayQueue::swap_positions(size_t a, size_t b) {
+    if (a == b) return;
+    size_t value_a = value_at(a), value_b = value_at(b);
+    value_at_position[a] = value_b;
+    position_of_value[value_b] = a;
+    value_at_position[b] = value_a;
+    position_of_value[value_a] = b;
+}
+
+bool PlayQueue::is_recent(size_t index) const {
+    return index < count && (recent_bits[index / 64] >> (index % 64)) & 1u;
+}
+
+void PlayQueue::mark_recent(size_t index) {
+    size_t window = recent_window();
+    if (window == 0 || is_recent(index)) return;
+    recent_bits[index / 64] |= uint64_t(1) << (index % 64);
+    recent_order.push_back(index);
+    while (recent_order.size() > window) {
+        size_t expired = recent_order.front();
+        recent_order.pop_front();
+        recent_bits[expired / 64] &= ~(uint64_t(1) << (expired % 64));
+    }
+}
+
+size_t PlayQueue::recent_window() const {
+    return std::min(MAX_RECENT, count / 2);
+}
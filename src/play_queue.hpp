@@ -0,0 +1,87 @@
+#ifndef PLAY_QUEUE_HPP
+#define PLAY_QUEUE_HPP
+
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <random>
+#include <cstdint>
+#include <cstddef>
+
+enum class RepeatMode {
+    OFF,
+    ALL, // starts over after the last track, in a fresh order when shuffling
+    ONE  // a track that ends plays again; skipping still moves on
+};
+
+// Play order over the indices of a caller's list. Shuffle draws a Fisher-Yates
+// permutation one step at a time through a sparse swap table, so a 20k-track
+// list starts at once and no track repeats within a pass. Tracks from the
+// last stretch of the previous pass are held back with a bitset. Previous and
+// next walk a history stack; every move is O(1).
+class PlayQueue {
+public:
+    PlayQueue();
+
+    // A new list of count items playing start; history is dropped
+    void reset(size_t count, size_t start);
+    void clear();
+    // One more item at the end of the list
+    void append();
+
+    size_t size() const { return count; }
+    int current() const { return playing; } // -1 if nothing
+
+    // What plays when this track ends, -1 if playback stops there. It stays
+    // the same until the queue moves or a mode changes, so it can be prefetched.
+    int peek_next();
+    // The track ended; -1 (and no move) at the end of the list
+    int next();
+    // The user skipped: like next(), but repeat-one moves on as well
+    int skip();
+    // Back through what was played before; -1 if nothing was
+    int previous();
+    // The user picked a track
+    void jump(size_t index);
+
+    void set_shuffle(bool on);
+    bool shuffle() const { return shuffled; }
+    void set_repeat(RepeatMode mode);
+    RepeatMode repeat() const { return repeat_mode; }
+
+private:
+    size_t count;
+    int playing;
+    bool shuffled;
+    RepeatMode repeat_mode;
+
+    std::deque<size_t> history;  // played before the current track, newest last
+    std::vector<size_t> forward; // stepped back over with previous(), newest last
+
+    // Shuffle pass: positions below consumed are played, the one at consumed
+    // is fixed once peeked (drawn), the rest are still in the hat. Only
+    // positions that were swapped are stored.
+    std::unordered_map<size_t, size_t> value_at_position;
+    std::unordered_map<size_t, size_t> position_of_value;
+    size_t consumed;
+    size_t drawn;
+    std::mt19937 rng;
+
+    // Recently played, one bit per track, expired oldest first
+    std::vector<uint64_t> recent_bits;
+    std::deque<size_t> recent_order;
+
+    int following(); // peek_next() without repeat-one
+    void move_to(size_t index);
+    void new_pass();
+    void take(size_t index); // moves index out of the hat into the played part of the pass
+    void draw();
+    size_t value_at(size_t position) const;
+    size_t position_of(size_t value) const;
+    void swap_positions(size_t a, size_t b);
+    bool is_recent(size_t index) const;
+    void mark_recent(size_t index);
+    size_t recent_window() const;
+};
+
+#endif // PLAY_QUEUE_HPP
@@ -1,8 +1,16 @@
 #include "player.hpp"
 #include <stdexcept>
+#include <algorithm>
 #include <iostream>
+#include <cstdio>
+#include <unistd.h>
+#include <fcntl.h>
 
-Player::Player() {
+// A seek mpv never confirms (say, nothing is loaded) stops holding back new ones after this
+static const auto SEEK_CONFIRM_TIMEOUT = std::chrono::milliseconds(500);
+
+Player::Player()
+    : wakeup_pipe{-1, -1}, seek_state(SeekState::IDLE), seek_queued(false), seek_target(0.0), seek_exact(false) {
     mpv = mpv_create();
     if (!mpv) {
         throw std::runtime_error("failed to create mpv context");
@@ -10,14 +18,49 @@ Player::Player() {
 
     // Set some default options if needed
     check_error(mpv_set_option_string(mpv, "vo", "null")); // Audio only
+    
+    // Queued local files play back to back, the next one is opened before the current ends
+    check_error(mpv_set_option_string(mpv, "gapless-audio", "yes"));
+    check_error(mpv_set_option_string(mpv, "prefetch-playlist", "yes"));
 
     check_error(mpv_initialize(mpv));
+    
+    // Track changes and idleness arrive as events instead of being polled
+    check_error(mpv_observe_property(mpv, 0, "playlist-pos", MPV_FORMAT_INT64));
+    check_error(mpv_observe_property(mpv, 0, "idle-active", MPV_FORMAT_FLAG));
+    check_error(mpv_observe_property(mpv, 0, "pause", MPV_FORMAT_FLAG));
 }
 
 Player::~Player() {
     if (mpv) {
         mpv_terminate_destroy(mpv);
     }
+    if (wakeup_pipe[0] >= 0) close(wakeup_pipe[0]);
+    if (wakeup_pipe[1] >= 0) close(wakeup_pipe[1]);
+}
+
+static void on_mpv_wakeup(void* data) {
+    // Called on an mpv thread; a full pipe already means "wake up"
+    char byte = 1;
+    ssize_t ignored = write(*static_cast<int*>(data), &byte, 1);
+    (void)ignored;
+}
+
+int Player::wakeup_fd() {
+    if (wakeup_pipe[0] < 0) {
+        if (pipe(wakeup_pipe) != 0) throw std::runtime_error("pipe() failed");
+        for (int fd : wakeup_pipe) {
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        }
+        mpv_set_wakeup_callback(mpv, on_mpv_wakeup, &wakeup_pipe[1]);
+    }
+    return wakeup_pipe[0];
+}
+
+void Player::clear_wakeup() {
+    char buffer[64];
+    while (wakeup_pipe[0] >= 0 && read(wakeup_pipe[0], buffer, sizeof(buffer)) > 0) {}
 }
 
 void Player::check_error(int status) {
@@ -31,6 +74,16 @@ void Player::load(const std::string& path, const std::string& mode) {
     check_error(mpv_command(mpv, cmd));
 }
 
+void Player::append(const std::string& path) {
+    const char* cmd[] = {"loadfile", path.c_str(), "append", NULL};
+    check_error(mpv_command(mpv, cmd));
+}
+
+void Player::clear_upcoming() {
+    const char* cmd[] = {"playlist-clear", NULL};
+    check_error(mpv_command(mpv, cmd));
+}
+
 void Player::play() {
     int flag = 0;
     check_error(mpv_set_property(mpv, "pause", MPV_FORMAT_FLAG, &flag));
@@ -94,10 +147,56 @@ void Player::set_volume(int volume) {
     check_error(mpv_set_property(mpv, "volume", MPV_FORMAT_DOUBLE, &vol));
 }
 
-void Player::seek(double seconds) {
-    std::string seconds_str = std::to_string(seconds);
-    const char* cmd[] = {"seek", seconds_str.c_str(), "relative", NULL};
-    check_error(mpv_command(mpv, cmd));
+bool Player::set_gain(double db) {
+    return mpv_set_property(mpv, "volume-gain", MPV_FORMAT_DOUBLE, &db) >= 0;
+}
+
+void Player::seek(double value, SeekMode mode, SeekPrecision precision) {
+    double duration = get_duration();
+    double target;
+    if (mode == SeekMode::ABSOLUTE) {
+        target = value;
+    } else if (mode == SeekMode::PERCENT) {
+        if (duration <= 0) return;
+        target = duration * value / 100.0;
+    } else {
+        // Repeated presses add up from where the last one was headed, not from where mpv is
+        double base = seek_state == SeekState::IDLE ? get_position() : seek_target;
+        target = base + value;
+    }
+    target = std::max(0.0, duration > 0 ? std::min(target, duration) : target);
+
+    bool exact = precision == SeekPrecision::EXACT;
+    if (seek_state == SeekState::PENDING || seek_queued) seek_exact = seek_exact || exact;
+    else seek_exact = exact;
+    seek_target = target;
+    if (seek_state == SeekState::IN_FLIGHT) seek_queued = true;
+    else seek_state = SeekState::PENDING;
+}
+
+void Player::flush_seek() {
+    if (seek_state == SeekState::IN_FLIGHT) {
+        if (std::chrono::steady_clock::now() - seek_sent < SEEK_CONFIRM_TIMEOUT) return;
+        // Never confirmed; stop waiting for it
+        seek_state = seek_queued ? SeekState::PENDING : SeekState::IDLE;
+        seek_queued = false;
+    }
+    if (seek_state != SeekState::PENDING) return;
+
+    // Millisecond precision; libmpv needs the C numeric locale anyway, so "%.3f" is safe
+    char target[32];
+    snprintf(target, sizeof(target), "%.3f", seek_target);
+    const char* cmd[] = {"seek", target, seek_exact ? "absolute+exact" : "absolute+keyframes", NULL};
+    if (mpv_command(mpv, cmd) < 0) {
+        seek_state = SeekState::IDLE;
+        return;
+    }
+    seek_state = SeekState::IN_FLIGHT;
+    seek_sent = std::chrono::steady_clock::now();
+}
+
+double Player::get_display_position() {
+    return seek_state == SeekState::IDLE ? get_position() : seek_target;
 }
 
 std::string Player::get_metadata(const std::string& key) {
@@ -110,6 +209,80 @@ std::string Player::get_metadata(const std::string& key) {
     return "";
 }
 
+bool Player::get_metadata_into(const char* key, char* buf, size_t len) {
+    char* value = nullptr;
+    if (len == 0 || mpv_get_property(mpv, key, MPV_FORMAT_STRING, &value) < 0 || !value) return false;
+    snprintf(buf, len, "%s", value);
+    mpv_free(value);
+    return true;
+}
+
 void Player::set_property(const std::string& name, const std::string& value) {
     check_error(mpv_set_property_string(mpv, name.c_str(), value.c_str()));
 }
+
+bool Player::poll_event(PlayerEvent& event) {
+    while (true) {
+        mpv_event* ev = mpv_wait_event(mpv, 0);
+        if (ev->event_id == MPV_EVENT_NONE) return false;
+        
+        // Playback resumed after a seek: the next pending target may go out
+        if (ev->event_id == MPV_EVENT_PLAYBACK_RESTART && seek_state == SeekState::IN_FLIGHT) {
+            seek_state = seek_queued ? SeekState::PENDING : SeekState::IDLE;
+            seek_queued = false;
+            continue;
+        }
+        // A new file makes any target meant for the old one meaningless
+        if (ev->event_id == MPV_EVENT_START_FILE) {
+            seek_state = SeekState::IDLE;
+            seek_queued = false;
+            continue;
+        }
+        
+        if (ev->event_id == MPV_EVENT_FILE_LOADED) {
+            event.type = PlayerEventType::FILE_LOADED;
+            event.playlist_pos = -1;
+            event.eof = false;
+            event.error = false;
+            return true;
+        }
+        
+        if (ev->event_id == MPV_EVENT_END_FILE) {
+            mpv_event_end_file* end = static_cast<mpv_event_end_file*>(ev->data);
+            event.type = PlayerEventType::FILE_ENDED;
+            event.playlist_pos = -1;
+            event.eof = end->reason == MPV_END_FILE_REASON_EOF;
+            event.error = end->reason == MPV_END_FILE_REASON_ERROR;
+            return true;
+        }
+        
+        if (ev->event_id == MPV_EVENT_PROPERTY_CHANGE) {
+            mpv_event_property* prop = static_cast<mpv_event_property*>(ev->data);
+            if (!prop->data) continue;
+            std::string name = prop->name;
+            if (name == "playlist-pos" && prop->format == MPV_FORMAT_INT64) {
+                event.type = PlayerEventType::TRACK_CHANGED;
+                event.playlist_pos = static_cast<int>(*static_cast<int64_t*>(prop->data));
+                event.eof = false;
+                event.error = false;
+                if (event.playlist_pos < 0) continue;
+                return true;
+            }
+            if (name == "pause" && prop->format == MPV_FORMAT_FLAG) {
+                event.type = PlayerEventType::PAUSE_CHANGED;
+                event.playlist_pos = -1;
+                event.eof = false;
+                event.error = false;
+                event.paused = *static_cast<int*>(prop->data) != 0;
+                return true;
+            }
+            if (name == "idle-active" && prop->format == MPV_FORMAT_FLAG && *static_cast<int*>(prop->data)) {
+                event.type = PlayerEventType::IDLE;
+                event.playlist_pos = -1;
+                event.eof = false;
+                event.error = false;
+                return true;
+            }
+        }
+    }
+}
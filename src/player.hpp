@@ -2,32 +2,93 @@
 #define PLAYER_HPP
 
 #include <string>
+#include <chrono>
 #include <mpv/client.h>
 
+enum class PlayerEventType {
+    TRACK_CHANGED, // mpv moved to another playlist entry
+    FILE_ENDED,
+    FILE_LOADED,   // the new file is open, so seeks apply to it
+    IDLE,
+    PAUSE_CHANGED
+};
+
+enum class SeekMode {
+    RELATIVE, // seconds from the current (or already pending) position
+    ABSOLUTE, // seconds from the start
+    PERCENT   // 0-100 of the duration
+};
+
+enum class SeekPrecision {
+    KEYFRAMES, // nearest keyframe: fastest, may land a little off
+    EXACT      // decodes up to the exact sample
+};
+
+struct PlayerEvent {
+    PlayerEventType type;
+    int playlist_pos; // TRACK_CHANGED only
+    bool eof;         // FILE_ENDED only: reached the end, as opposed to stop/replace
+    bool error;       // FILE_ENDED only: playback failed
+    bool paused;      // PAUSE_CHANGED only
+};
+
 class Player {
 public:
     Player();
     ~Player();
 
     void load(const std::string& path, const std::string& mode = "replace");
+    void append(const std::string& path);
+    // Drops every playlist entry except the one playing
+    void clear_upcoming();
     void play();
     void pause();
     void toggle_pause();
     void stop();
-    void seek(double seconds);
+    // Seeks are coalesced: a request only moves one pending target, and
+    // flush_seek() hands it to mpv as a single absolute seek. Exact wins if
+    // any request in the batch asked for it.
+    void seek(double value, SeekMode mode = SeekMode::RELATIVE, SeekPrecision precision = SeekPrecision::KEYFRAMES);
+    // Call once per frame; holds back while mpv is still busy with the previous seek
+    void flush_seek();
+    bool seek_pending() const { return seek_state != SeekState::IDLE; }
     
     bool is_playing();
     bool is_paused();
     bool is_idle();
     double get_position();
+    // The pending target while a seek is outstanding, so a progress bar moves at once
+    double get_display_position();
     double get_duration();
     int get_volume();
     void set_volume(int volume);
+    // Per-track gain in dB on top of the volume; false if this mpv has no volume-gain (before 0.38)
+    bool set_gain(double db);
     std::string get_metadata(const std::string& key);
+    // Same as get_metadata, but copies into buf so per-frame callers do not allocate
+    bool get_metadata_into(const char* key, char* buf, size_t len);
     void set_property(const std::string& name, const std::string& value);
+    
+    // Drains mpv's event queue without blocking; returns false when it is empty
+    bool poll_event(PlayerEvent& event);
+    // Becomes readable when mpv has queued events, for loops that sleep in poll()
+    int wakeup_fd();
+    void clear_wakeup();
 
 private:
+    enum class SeekState {
+        IDLE,
+        PENDING,  // target set, not sent yet
+        IN_FLIGHT // sent; mpv has not restarted playback yet
+    };
+
     mpv_handle* mpv;
+    int wakeup_pipe[2];
+    SeekState seek_state;
+    bool seek_queued; // a newer target arrived while one was in flight
+    double seek_target;
+    bool seek_exact;
+    std::chrono::steady_clock::time_point seek_sent;
     void check_error(int status);
 };
 
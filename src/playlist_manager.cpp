@@ -3,6 +3,7 @@
 #include <iostream>
 #include <algorithm>
 #include <sstream>
+#include "utils.hpp"
 
 namespace fs = std::filesystem;
 
@@ -13,7 +14,7 @@ PlaylistManager::PlaylistManager() {
     } else {
         playlists_dir = "playlists";
     }
-    ensure_playlists_dir();
+    // The directory is created lazily by the first write
 }
 
 void PlaylistManager::ensure_playlists_dir() {
@@ -26,7 +27,13 @@ std::string PlaylistManager::get_playlist_path(const std::string& name) {
     return playlists_dir + "/" + name + ".txt";
 }
 
+void PlaylistManager::write_song(std::ostream& out, const PlaylistSong& song) {
+    // Durations stay "m:ss" on disk so existing playlist files keep working
+    out << song.title() << "|" << song.url() << "|" << (song.duration() > 0 ? format_duration(song.duration()) : "") << "\n";
+}
+
 bool PlaylistManager::create_playlist(const std::string& name) {
+    ensure_playlists_dir();
     std::string path = get_playlist_path(name);
     if (!fs::exists(path)) {
         std::ofstream outfile(path);
@@ -79,13 +86,14 @@ bool PlaylistManager::add_song_to_playlist(const std::string& playlist_name, con
     // Check for duplicates
     auto current_songs = get_playlist_songs(playlist_name);
     for (const auto& s : current_songs) {
-        if (s.url == song.url) return false;
+        if (s.url_id() == song.url_id()) return false;
     }
 
+    ensure_playlists_dir();
     std::string path = get_playlist_path(playlist_name);
     std::ofstream outfile(path, std::ios::app);
     if (outfile.is_open()) {
-        outfile << song.title << "|" << song.url << "|" << song.duration << "\n";
+        write_song(outfile, song);
         outfile.close();
         return true;
     }
@@ -101,7 +109,7 @@ void PlaylistManager::remove_song_from_playlist(const std::string& playlist_name
         std::ofstream outfile(path); // Truncate file
         if (outfile.is_open()) {
             for (const auto& song : songs) {
-                outfile << song.title << "|" << song.url << "|" << song.duration << "\n";
+                write_song(outfile, song);
             }
             outfile.close();
         }
@@ -128,13 +136,13 @@ std::vector<Playlist> PlaylistManager::list_playlists() {
     return playlists;
 }
 
-std::vector<PlaylistSong> PlaylistManager::get_playlist_songs(const std::string& playlist_name) {
+std::vector<PlaylistSong> PlaylistManager::get_playlist_songs(const std::string& playlist_name, int limit) {
     std::vector<PlaylistSong> songs;
     std::string path = get_playlist_path(playlist_name);
     std::ifstream infile(path);
     std::string line;
     
-    while (std::getline(infile, line)) {
+    while ((limit < 0 || static_cast<int>(songs.size()) < limit) && std::getline(infile, line)) {
         if (line.empty()) continue;
         
         size_t last_pipe = line.rfind('|');
@@ -143,11 +151,9 @@ std::vector<PlaylistSong> PlaylistManager::get_playlist_songs(const std::string&
         size_t second_last_pipe = line.rfind('|', last_pipe - 1);
         if (second_last_pipe == std::string::npos) continue;
         
-        PlaylistSong song;
-        song.title = line.substr(0, second_last_pipe);
-        song.url = line.substr(second_last_pipe + 1, last_pipe - second_last_pipe - 1);
-        song.duration = line.substr(last_pipe + 1);
-        songs.push_back(song);
+        songs.emplace_back(line.substr(0, second_last_pipe),
+                           line.substr(second_last_pipe + 1, last_pipe - second_last_pipe - 1),
+                           static_cast<int>(parse_duration(line.substr(last_pipe + 1))));
     }
     
     return songs;
@@ -2,13 +2,12 @@
 
 #include <string>
 #include <vector>
+#include <ostream>
 #include <filesystem>
+#include "track_table.hpp"
 
-struct PlaylistSong {
-    std::string title;
-    std::string url;
-    std::string duration;
-};
+// Handle into the shared track table; see TrackRef
+using PlaylistSong = TrackRef;
 
 struct Playlist {
     std::string name;
@@ -30,10 +29,12 @@ public:
     
     // Data retrieval
     std::vector<Playlist> list_playlists();
-    std::vector<PlaylistSong> get_playlist_songs(const std::string& playlist_name);
+    // limit < 0 reads the whole playlist
+    std::vector<PlaylistSong> get_playlist_songs(const std::string& playlist_name, int limit = -1);
     
 private:
     std::string playlists_dir;
     void ensure_playlists_dir();
     std::string get_playlist_path(const std::string& name);
+    void write_song(std::ostream& out, const PlaylistSong& song);
 };
@@ -0,0 +1,118 @@
+#include "playlist_warmer.hpp"
+#include "utils.hpp"
+#include "subprocess.hpp"
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+PlaylistWarmer::PlaylistWarmer(StreamResolver& r, AudioCache& c, int workers_count)
+    : resolver(r), cache(c), max_workers(workers_count), stopping(false) {}
+
+PlaylistWarmer::~PlaylistWarmer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        jobs.clear();
+    }
+    cv.notify_all();
+    for (auto& worker : workers) {
+        if (worker.joinable()) worker.join();
+    }
+}
+
+void PlaylistWarmer::warm(const std::vector<PlaylistSong>& songs, bool download) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& song : songs) {
+        std::string url = song.url();
+        WarmState& state = states[url];
+        if (cache.contains(url)) {
+            state = WarmState::CACHED;
+            continue;
+        }
+        // Already in flight or done; a download request upgrades a resolved song
+        if (state == WarmState::QUEUED || state == WarmState::RESOLVING || state == WarmState::DOWNLOADING) continue;
+        if (state == WarmState::RESOLVED && !download) continue;
+
+        state = WarmState::QUEUED;
+        jobs.push_back({url, download});
+    }
+
+    // Workers are started on first use, never more than the limit
+    while (static_cast<int>(workers.size()) < max_workers && workers.size() < jobs.size()) {
+        workers.emplace_back(&PlaylistWarmer::worker_loop, this);
+    }
+    cv.notify_all();
+}
+
+WarmState PlaylistWarmer::get_state(const std::string& url) {
+    WarmState state;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = states.find(url);
+        state = it == states.end() ? WarmState::NONE : it->second;
+    }
+    // Stream URLs expire; the row goes back to cold once the resolver drops it
+    ResolvedStream stream;
+    if (state == WarmState::RESOLVED && !resolver.lookup(url, stream)) return WarmState::NONE;
+    return state;
+}
+
+int PlaylistWarmer::pending() {
+    std::lock_guard<std::mutex> lock(mutex);
+    int count = 0;
+    for (const auto& entry : states) {
+        if (entry.second == WarmState::QUEUED || entry.second == WarmState::RESOLVING ||
+            entry.second == WarmState::DOWNLOADING) count++;
+    }
+    return count;
+}
+
+void PlaylistWarmer::set_state(const std::string& url, WarmState state) {
+    std::lock_guard<std::mutex> lock(mutex);
+    states[url] = state;
+}
+
+void PlaylistWarmer::worker_loop() {
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [this]() { return stopping || !jobs.empty(); });
+            if (stopping) return;
+            job = jobs.front();
+            jobs.pop_front();
+        }
+
+        if (job.download && cache.enabled()) {
+            set_state(job.url, WarmState::DOWNLOADING);
+            set_state(job.url, download_audio(job.url) ? WarmState::CACHED : WarmState::FAILED);
+            continue;
+        }
+
+        set_state(job.url, WarmState::RESOLVING);
+        try {
+            resolver.resolve(job.url, false, true);
+            set_state(job.url, WarmState::RESOLVED);
+        } catch (const std::exception& e) {
+            set_state(job.url, WarmState::FAILED);
+        }
+    }
+}
+
+bool PlaylistWarmer::download_audio(const std::string& url) {
+    std::string tmp_path = cache.recording_path(url) + ".dl";
+    // Shutting down kills a download in progress rather than waiting for it
+    ProcessOptions options;
+    options.low_priority = true;
+    options.slots = &yt_dlp_slots();
+    options.cancel = &stopping;
+    int status = run_process({"yt-dlp", "--no-progress", "--force-ipv4", "--no-part", "-q", "-f", "bestaudio",
+                              "-o", tmp_path, url}, options).exit_code;
+
+    std::error_code ec;
+    if (status != 0 || !fs::exists(tmp_path, ec)) {
+        fs::remove(tmp_path, ec);
+        return false;
+    }
+    return cache.insert(url, tmp_path);
+}
@@ -0,0 +1,59 @@
+#ifndef PLAYLIST_WARMER_HPP
+#define PLAYLIST_WARMER_HPP
+
+#include "playlist_manager.hpp"
+#include "stream_resolver.hpp"
+#include "audio_cache.hpp"
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+
+enum class WarmState {
+    NONE,
+    QUEUED,
+    RESOLVING,
+    RESOLVED,    // stream URL cached, switching to it is instant
+    DOWNLOADING,
+    CACHED,      // audio on disk, plays offline
+    FAILED
+};
+
+// Resolves (and optionally downloads) playlist songs in the background with a
+// small pool of yt-dlp workers running at low CPU and I/O priority.
+class PlaylistWarmer {
+public:
+    PlaylistWarmer(StreamResolver& resolver, AudioCache& cache, int max_workers = 3);
+    ~PlaylistWarmer();
+
+    void warm(const std::vector<PlaylistSong>& songs, bool download);
+    WarmState get_state(const std::string& url);
+    int pending();
+
+private:
+    struct Job {
+        std::string url;
+        bool download;
+    };
+
+    StreamResolver& resolver;
+    AudioCache& cache;
+    int max_workers;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<Job> jobs;
+    std::map<std::string, WarmState> states;
+    std::vector<std::thread> workers;
+    std::atomic<bool> stopping;
+
+    void worker_loop();
+    void set_state(const std::string& url, WarmState state);
+    bool download_audio(const std::string& url);
+};
+
+#endif // PLAYLIST_WARMER_HPP
@@ -1,41 +1,52 @@
 #include "search.hpp"
 #include "utils.hpp"
-#include <array>
-#include <memory>
 #include <stdexcept>
-#include <iostream>
-#include <sstream>
 
-std::vector<SearchResult> search_youtube(const std::string& query, int limit) {
-    std::vector<SearchResult> results;
-    std::string cmd = "yt-dlp --print \"%(title)s|%(webpage_url)s|%(duration_string)s\" --flat-playlist \"ytsearch" + std::to_string(limit) + ":" + query + "\" 2>/dev/null";
-    
-    std::array<char, 1024> buffer;
-    std::unique_ptr<FILE, decltype(&pclose)> pipe(popen(cmd.c_str(), "r"), pclose);
-    if (!pipe) {
-        throw std::runtime_error("popen() failed!");
+// A search still running after this long is killed
+static const std::chrono::seconds SEARCH_TIMEOUT(30);
+
+SearchJob::SearchJob(const std::string& query, int limit)
+    : deadline(std::chrono::steady_clock::now() + SEARCH_TIMEOUT), error(false) {
+    try {
+        process.reset(new Subprocess({"yt-dlp", "--print", "%(title)s|%(webpage_url)s|%(duration)s", "--flat-playlist",
+                                      "ytsearch" + std::to_string(limit) + ":" + query}));
+    } catch (const std::runtime_error&) {
+        error = true;
     }
-    
-    while (fgets(buffer.data(), buffer.size(), pipe.get()) != nullptr) {
-        std::string line = buffer.data();
-        if (!line.empty() && line.back() == '\n') {
-            line.pop_back();
-        }
+}
+
+bool SearchJob::poll(std::vector<SearchResult>& results) {
+    if (!process) return false;
+
+    bool open = process->read_available(pending);
+    take_lines(results);
+    if (open && std::chrono::steady_clock::now() < deadline) return true;
+
+    if (open) process->kill();
+    if (process->wait() != 0 && results.empty()) error = true;
+    process.reset();
+    return false;
+}
+
+void SearchJob::take_lines(std::vector<SearchResult>& results) {
+    size_t start = 0;
+    size_t newline;
+    while ((newline = pending.find('\n', start)) != std::string::npos) {
+        std::string line = pending.substr(start, newline - start);
+        start = newline + 1;
         
         // Find the last two pipe characters to extract URL and duration
         // This handles titles that contain pipe characters
         size_t last_pipe = line.find_last_of('|');
-        if (last_pipe == std::string::npos) continue;
+        if (last_pipe == std::string::npos || last_pipe == 0) continue;
         
         size_t second_last_pipe = line.find_last_of('|', last_pipe - 1);
         if (second_last_pipe == std::string::npos) continue;
         
-        SearchResult result;
-        result.title = sanitize_text(line.substr(0, second_last_pipe));
-        result.url = line.substr(second_last_pipe + 1, last_pipe - second_last_pipe - 1);
-        result.duration = line.substr(last_pipe + 1);
-        results.push_back(result);
+        // Duration is plain seconds ("NA" for live streams, which parses as unknown)
+        results.emplace_back(sanitize_text(line.substr(0, second_last_pipe)),
+                             line.substr(second_last_pipe + 1, last_pipe - second_last_pipe - 1),
+                             static_cast<int>(parse_duration(line.substr(last_pipe + 1))));
     }
-    
-    return results;
+    pending.erase(0, start);
 }
@@ -3,13 +3,31 @@
 
 #include <string>
 #include <vector>
+#include <memory>
+#include <chrono>
+#include "track_table.hpp"
+#include "subprocess.hpp"
 
-struct SearchResult {
-    std::string title;
-    std::string url;
-    std::string duration;
-};
+// Handle into the shared track table; see TrackRef
+using SearchResult = TrackRef;
+
+// A yt-dlp search running in the background. The main loop calls poll() each
+// frame to pick up results as yt-dlp prints them; destroying the job kills it.
+class SearchJob {
+public:
+    SearchJob(const std::string& query, int limit = 10);
+
+    // Appends newly arrived results; false once the search has finished
+    bool poll(std::vector<SearchResult>& results);
+    bool failed() const { return error; }
 
-std::vector<SearchResult> search_youtube(const std::string& query, int limit = 10);
+private:
+    std::unique_ptr<Subprocess> process;
+    std::string pending; // output after the last complete line
+    std::chrono::steady_clock::time_point deadline;
+    bool error;
+
+    void take_lines(std::vector<SearchResult>& results);
+};
 
 #endif // SEARCH_HPP
@@ -0,0 +1,194 @@
+#include "session.hpp"
+#include "utils.hpp"
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <cstdio>
+#include <cstdlib>
+
+namespace fs = std::filesystem;
+
+static const char* SESSION_HEADER = "vibe-fi session 2";
+static const char* QUEUE_HEADER = "vibe-fi queue 1";
+static const char* LYRICS_HEADER = "vibe-fi lyrics 1";
+
+// One field per line, so text written out must not contain the separators
+static std::string one_line(const std::string& text) {
+    std::string out = text;
+    for (char& c : out) {
+        if (c == '\t' || c == '\n' || c == '\r') c = ' ';
+    }
+    return out;
+}
+
+static bool read_file(const std::string& file_path, std::string& contents) {
+    std::ifstream file(file_path, std::ios::binary);
+    if (!file) return false;
+    std::ostringstream out;
+    out << file.rdbuf();
+    contents = out.str();
+    return true;
+}
+
+// Calls field(name, value) for each "name value" line after the header
+template <typename Field>
+static bool parse_lines(const std::string& contents, const char* header, Field field) {
+    std::istringstream in(contents);
+    std::string line;
+    if (!std::getline(in, line) || line != header) return false;
+    while (std::getline(in, line)) {
+        size_t space = line.find(' ');
+        if (!field(line.substr(0, space), space == std::string::npos ? "" : line.substr(space + 1))) return false;
+    }
+    return true;
+}
+
+static const char* repeat_name(RepeatMode mode) {
+    if (mode == RepeatMode::ALL) return "all";
+    if (mode == RepeatMode::ONE) return "one";
+    return "off";
+}
+
+std::string Session::path() {
+    return get_vibe_dir() + "/session";
+}
+
+std::string Session::queue_path() {
+    return path() + ".queue";
+}
+
+std::string Session::lyrics_path() {
+    return path() + ".lyrics";
+}
+
+bool Session::load() {
+    std::string contents;
+    if (!read_file(path(), contents)) return false;
+    bool state_read = parse_lines(contents, SESSION_HEADER, [&](const std::string& name, const std::string& value) {
+        if (name == "source") {
+            streams = value == "streams";
+        } else if (name == "index") {
+            index = strtoull(value.c_str(), nullptr, 10);
+        } else if (name == "shuffle") {
+            shuffle = value == "1";
+        } else if (name == "repeat") {
+            repeat = value == "all" ? RepeatMode::ALL : value == "one" ? RepeatMode::ONE : RepeatMode::OFF;
+        } else if (name == "autoplay") {
+            autoplay = value == "1";
+        } else if (name == "position") {
+            position = strtod(value.c_str(), nullptr);
+        } else if (name == "paused") {
+            paused = value == "1";
+        } else if (name == "stream") {
+            // expires \t url
+            size_t tab = value.find('\t');
+            if (tab == std::string::npos) return true;
+            stream.expires = static_cast<time_t>(strtoll(value.c_str(), nullptr, 10));
+            stream.stream_url = value.substr(tab + 1);
+        } else if (name == "queue") {
+            queue_hash = strtoull(value.c_str(), nullptr, 16);
+        } else if (name == "lyrics") {
+            lyrics_hash = strtoull(value.c_str(), nullptr, 16);
+        }
+        return true;
+    });
+    if (!state_read) return false;
+
+    // The queue must be the one this state was written with
+    if (!read_file(queue_path(), contents) || hash_string(contents) != queue_hash) return false;
+    bool queue_read = parse_lines(contents, QUEUE_HEADER, [&](const std::string& name, const std::string& value) {
+        if (name != "track") return true;
+        // duration \t key \t title
+        size_t first = value.find('\t');
+        size_t second = first == std::string::npos ? first : value.find('\t', first + 1);
+        if (second == std::string::npos) return false;
+        queue.push_back({value.substr(first + 1, second - first - 1), value.substr(second + 1),
+                         static_cast<int32_t>(strtol(value.c_str(), nullptr, 10))});
+        return true;
+    });
+    if (!queue_read || index >= queue.size()) return false;
+
+    // Lyrics from another track are looked up again rather than shown
+    if (!read_file(lyrics_path(), contents) || hash_string(contents) != lyrics_hash) return true;
+    lyrics_loaded = parse_lines(contents, LYRICS_HEADER, [&](const std::string& name, const std::string& value) {
+        if (name == "synced") {
+            size_t tab = value.find('\t');
+            if (tab == std::string::npos) return true;
+            lyrics.synced_lyrics.push_back({strtod(value.c_str(), nullptr), value.substr(tab + 1)});
+            lyrics.has_synced = true;
+        } else if (name == "plain") {
+            if (!lyrics.plain_lyrics.empty()) lyrics.plain_lyrics += "\n";
+            lyrics.plain_lyrics += value;
+        }
+        return true;
+    });
+    if (!lyrics_loaded) lyrics = LyricsData{"", {}, false};
+    return true;
+}
+
+std::string Session::serialize_queue() const {
+    std::ostringstream out;
+    out << QUEUE_HEADER << "\n";
+    for (const SessionTrack& track : queue) {
+        out << "track " << track.duration << "\t" << one_line(track.key) << "\t" << one_line(track.title) << "\n";
+    }
+    return out.str();
+}
+
+std::string Session::serialize_lyrics() const {
+    std::ostringstream out;
+    out << LYRICS_HEADER << "\n";
+    char number[32];
+    for (const LyricLine& line : lyrics.synced_lyrics) {
+        snprintf(number, sizeof(number), "%.3f", line.timestamp);
+        out << "synced " << number << "\t" << one_line(line.text) << "\n";
+    }
+    // Plain lyrics one line each, so blank lines between verses survive
+    std::istringstream plain(lyrics.plain_lyrics);
+    std::string line;
+    while (std::getline(plain, line)) out << "plain " << one_line(line) << "\n";
+    return out.str();
+}
+
+std::string Session::serialize_state(uint64_t queue_contents_hash, uint64_t lyrics_contents_hash) const {
+    std::ostringstream out;
+    out << SESSION_HEADER << "\n";
+    out << "source " << (streams ? "streams" : "local") << "\n";
+    out << "index " << index << "\n";
+    out << "shuffle " << (shuffle ? 1 : 0) << "\n";
+    out << "repeat " << repeat_name(repeat) << "\n";
+    out << "autoplay " << (autoplay ? 1 : 0) << "\n";
+    char number[32];
+    snprintf(number, sizeof(number), "%.3f", position);
+    out << "position " << number << "\n";
+    out << "paused " << (paused ? 1 : 0) << "\n";
+    if (!stream.stream_url.empty()) {
+        out << "stream " << static_cast<long long>(stream.expires) << "\t" << one_line(stream.stream_url) << "\n";
+    }
+    snprintf(number, sizeof(number), "%016llx", static_cast<unsigned long long>(queue_contents_hash));
+    out << "queue " << number << "\n";
+    snprintf(number, sizeof(number), "%016llx", static_cast<unsigned long long>(lyrics_contents_hash));
+    out << "lyrics " << number << "\n";
+    return out.str();
+}
+
+bool Session::save(const std::string& file_path, const std::string& contents) {
+    std::error_code ec;
+    fs::create_directories(fs::path(file_path).parent_path(), ec);
+    std::string tmp_path = file_path + ".tmp";
+    {
+        std::ofstream file(tmp_path, std::ios::trunc);
+        if (!file) return false;
+        file << contents;
+        if (!file) return false;
+    }
+    fs::rename(tmp_path, file_path, ec);
+    return !ec;
+}
+
+void Session::discard() {
+    std::error_code ec;
+    fs::remove(path(), ec);
+    fs::remove(queue_path(), ec);
+    fs::remove(lyrics_path(), ec);
+}
@@ -0,0 +1,55 @@
+#ifndef SESSION_HPP
+#define SESSION_HPP
+
+#include "play_queue.hpp"
+#include "stream_resolver.hpp"
+#include "lyrics.hpp"
+#include <string>
+#include <vector>
+#include <cstdint>
+
+struct SessionTrack {
+    std::string key;   // path or webpage URL
+    std::string title; // streams only
+    int32_t duration;  // seconds, 0 if unknown
+};
+
+// What the TUI was playing when it last ran, kept in ~/.vibe-fi: the queue and
+// where it was in it, the position in the track, the stream URL yt-dlp gave
+// for it and the lyrics on screen. A start without arguments plays on from
+// there without yt-dlp or a lyrics lookup while the URL is valid.
+//
+// The queue (session.queue) and the lyrics (session.lyrics) have files of
+// their own, written only when they change. What changes while a track plays
+// is in the small session file, which names the queue and lyrics it goes with
+// by hash, so a part left over from another snapshot is never mixed in.
+struct Session {
+    bool streams = false; // a queue of streams rather than local files
+    std::vector<SessionTrack> queue;
+    size_t index = 0;     // the track playing
+    bool shuffle = false;
+    RepeatMode repeat = RepeatMode::OFF;
+    bool autoplay = true;
+    double position = 0.0;
+    bool paused = false;
+    ResolvedStream stream{"", 0}; // of the track playing, if it is a stream that was resolved
+    LyricsData lyrics{"", {}, false};
+    bool lyrics_loaded = false;   // false if they have to be looked up again
+    uint64_t queue_hash = 0;      // of the session.queue contents, once loaded
+    uint64_t lyrics_hash = 0;
+
+    // False if there is no session or it cannot be read
+    bool load();
+    // Each file's contents; save() writes them to a temp file and renames it
+    // over the old one, so a crash mid-write leaves the previous snapshot
+    std::string serialize_queue() const;
+    std::string serialize_lyrics() const;
+    std::string serialize_state(uint64_t queue_hash, uint64_t lyrics_hash) const;
+    static bool save(const std::string& file_path, const std::string& contents);
+    static void discard();
+    static std::string path();
+    static std::string queue_path();
+    static std::string lyrics_path();
+};
+
+#endif // SESSION_HPP
@@ -0,0 +1,131 @@
+#include "status_line.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+StatusLine::StatusLine()
+    : title_x(0), filled(-1), bar_wave(false), pos_sec(-1), dur_sec(-1), position(0.0), duration(0.0),
+      bpm_value(-1), volume_value(-1), width(0), valid(false) {
+    title[0] = title_line[0] = bar[0] = time[0] = bpm[0] = volume[0] = '\0';
+}
+
+void StatusLine::update(int new_width, const char* new_title, double pos, double dur,
+                        const std::vector<uint8_t>& waveform, const char* wave_glyphs, char progress, int new_bpm,
+                        int new_volume) {
+    if (!valid || width != new_width) {
+        valid = false;
+        width = new_width;
+    }
+
+    if (!valid || strcmp(new_title, title) != 0) {
+        snprintf(title, sizeof(title), "%s", new_title);
+
+        // Center Title
+        int len = static_cast<int>(strlen(title));
+        int max_len = std::min(width - 4, static_cast<int>(sizeof(title_line)) - 1);
+        if (len > max_len) {
+            int keep = std::max(0, std::min(width - 7, max_len - 3));
+            snprintf(title_line, sizeof(title_line), "%.*s...", keep, title);
+        } else {
+            memcpy(title_line, title, len + 1);
+        }
+        title_x = std::max(0, (width - static_cast<int>(strlen(title_line))) / 2);
+    }
+
+    position = pos;
+    duration = dur;
+    int bar_width = std::min(width - 4, static_cast<int>(sizeof(bar)) + 1);
+
+    if (dur > 0 && bar_width > 2) {
+        int inner = bar_width - 2;
+        int played = static_cast<int>((pos / dur) * bar_width);
+        bool wave = !waveform.empty();
+        if (wave) {
+            // The waveform only changes with the track or the width; position just moves the split
+            if (!valid || !bar_wave) {
+                int levels = static_cast<int>(strlen(wave_glyphs));
+                size_t slices = waveform.size();
+                for (int i = 0; i < inner; ++i) {
+                    size_t from = slices * i / inner;
+                    size_t to = std::max(from + 1, slices * (i + 1) / inner);
+                    int loudest = 0;
+                    for (size_t k = from; k < to && k < slices; ++k) loudest = std::max<int>(loudest, waveform[k]);
+                    bar[i] = wave_glyphs[loudest * levels / 256];
+                }
+                bar[inner] = '\0';
+            }
+        } else if (!valid || bar_wave || played != filled) {
+            for (int i = 0; i < inner; ++i) {
+                bar[i] = i < played ? progress : ' ';
+            }
+            bar[inner] = '\0';
+        }
+        filled = played;
+        bar_wave = wave;
+
+        int new_pos_sec = static_cast<int>(pos);
+        int new_dur_sec = static_cast<int>(dur);
+        if (!valid || new_pos_sec != pos_sec || new_dur_sec != dur_sec) {
+            snprintf(time, sizeof(time), "%02d:%02d / %02d:%02d",
+                     new_pos_sec / 60, new_pos_sec % 60, new_dur_sec / 60, new_dur_sec % 60);
+            pos_sec = new_pos_sec;
+            dur_sec = new_dur_sec;
+        }
+    } else {
+        // Nothing to seek in; whichever bar comes next is built from scratch
+        bar[0] = '\0';
+        bar_wave = false;
+        filled = -1;
+    }
+
+    if (!valid || new_bpm != bpm_value) {
+        if (new_bpm > 0) snprintf(bpm, sizeof(bpm), "%d BPM", new_bpm);
+        else bpm[0] = '\0';
+        bpm_value = new_bpm;
+    }
+
+    if (!valid || new_volume != volume_value) {
+        snprintf(volume, sizeof(volume), "Vol: %d%%", new_volume);
+        volume_value = new_volume;
+    }
+
+    valid = true;
+}
+
+MessageRing::MessageRing() : head(0), count(0), shown(false) {}
+
+void MessageRing::push(const std::string& text) {
+    if (count == SIZE) {
+        head = (head + 1) % SIZE;
+        count--;
+        shown = false;
+    }
+    // Whatever is already on screen gives way at once; only messages posted
+    // before the next draw (e.g. startup errors) wait their turn
+    if (count > 0 && shown) {
+        slots[head].shown_at -= std::chrono::seconds(1);
+    }
+
+    Slot& slot = slots[(head + count) % SIZE];
+    snprintf(slot.text, sizeof(slot.text), "%s", text.c_str());
+    count++;
+}
+
+const char* MessageRing::current(std::chrono::steady_clock::time_point now) {
+    while (count > 0) {
+        Slot& slot = slots[head];
+        if (!shown) {
+            slot.shown_at = now;
+            shown = true;
+        }
+
+        // A message stays up for 3s, or 1s when newer ones are waiting behind it
+        auto lifetime = count > 1 ? std::chrono::seconds(1) : std::chrono::seconds(3);
+        if (now - slot.shown_at < lifetime) return slot.text;
+
+        head = (head + 1) % SIZE;
+        count--;
+        shown = false;
+    }
+    return nullptr;
+}
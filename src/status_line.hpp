@@ -0,0 +1,62 @@
+#ifndef STATUS_LINE_HPP
+#define STATUS_LINE_HPP
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+
+// The now-playing panel's text, formatted into fixed buffers and only rebuilt
+// when what it shows changes, so drawing a frame never allocates. The UI puts
+// it on screen; vibe_fi_bench checks the no-allocation part.
+struct StatusLine {
+    char title[512];
+    char title_line[512]; // title cut to the width
+    int title_x;
+    char bar[512];        // seek bar between the brackets, "" without a duration
+    int filled;           // cells of it played
+    bool bar_wave;        // bar holds the waveform rather than the plain fill
+    char time[32];
+    int pos_sec;
+    int dur_sec;
+    double position;      // Read once per frame, shared with the event feed
+    double duration;
+    char bpm[16];         // "" until the beat tracker has a tempo
+    int bpm_value;
+    char volume[16];
+    int volume_value;
+    int width;
+    bool valid;
+
+    StatusLine();
+
+    // wave_glyphs are the waveform levels, quietest first; progress fills the plain bar
+    void update(int width, const char* title, double position, double duration, const std::vector<uint8_t>& waveform,
+                const char* wave_glyphs, char progress, int bpm, int volume);
+};
+
+// Messages queue up in a small ring; the oldest is shown until its timer runs out
+class MessageRing {
+public:
+    static const int SIZE = 8;
+    static const int MAX_LEN = 256;
+
+    MessageRing();
+
+    // A full ring drops its oldest message rather than allocate
+    void push(const std::string& text);
+    // Message to show at `now`, nullptr if none
+    const char* current(std::chrono::steady_clock::time_point now);
+
+private:
+    struct Slot {
+        char text[MAX_LEN];
+        std::chrono::steady_clock::time_point shown_at;
+    };
+    Slot slots[SIZE];
+    int head;
+    int count;
+    bool shown; // the head is on screen and its timer running
+};
+
+#endif // STATUS_LINE_HPP
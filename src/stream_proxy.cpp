@@ -0,0 +1,420 @@
+#include "stream_proxy.hpp"
+#include "subprocess.hpp"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <poll.h>
+#include <memory>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <chrono>
+
+// Upstream is read in ranged chunks; small enough that a throttled chunk is cheap to retry
+static const uint64_t CHUNK_SIZE = 1024 * 1024;
+static const int MAX_RETRIES = 5;
+// Tracks kept in memory (current, previous and a replay or two)
+static const size_t MAX_TRACKS = 3;
+
+#ifdef MSG_NOSIGNAL
+static const int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+static const int SEND_FLAGS = 0;
+#endif
+
+static bool send_all(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t sent = send(fd, data, len, SEND_FLAGS);
+        if (sent <= 0) return false;
+        data += sent;
+        len -= static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+StreamProxy::StreamProxy(StreamResolver& r, AudioCache& c)
+    : resolver(r), cache(c), listen_fd(-1), port(0), running(false), registry(std::make_shared<Registry>()), next_id(1) {
+    const char* flag = getenv("VIBE_FI_STREAM_PROXY");
+    is_enabled = flag && std::string(flag) != "0";
+}
+
+StreamProxy::~StreamProxy() {
+    running = false;
+    if (accept_thread.joinable()) accept_thread.join();
+    if (listen_fd >= 0) close(listen_fd);
+
+    {
+        // Connections still open see their track cancelled and let go of it
+        std::lock_guard<std::mutex> lock(registry->mutex);
+        for (auto& entry : registry->tracks) retired.push_back(entry.second);
+        registry->tracks.clear();
+    }
+    for (auto& track : retired) cancel(*track);
+    reap_retired(true);
+}
+
+void StreamProxy::reap_retired(bool wait) {
+    for (auto it = retired.begin(); it != retired.end();) {
+        auto& track = *it;
+        if (!wait && !track->finished) {
+            ++it;
+            continue;
+        }
+        if (track->fetcher.joinable()) track->fetcher.join();
+        it = retired.erase(it);
+    }
+}
+
+bool StreamProxy::enabled() const {
+    return is_enabled;
+}
+
+bool StreamProxy::start() {
+    if (running) return true;
+
+    listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd < 0) return false;
+
+    int reuse = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0; // Any free port
+    if (bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(listen_fd, 8) < 0) {
+        close(listen_fd);
+        listen_fd = -1;
+        return false;
+    }
+
+    socklen_t len = sizeof(addr);
+    getsockname(listen_fd, reinterpret_cast<sockaddr*>(&addr), &len);
+    port = ntohs(addr.sin_port);
+
+    running = true;
+    accept_thread = std::thread(&StreamProxy::accept_loop, this);
+    return true;
+}
+
+std::string StreamProxy::register_track(const std::string& webpage_url, const std::string& stream_url) {
+    if (!start()) return "";
+
+    auto track = std::make_shared<Track>();
+    track->webpage_url = webpage_url;
+    track->stream_url = stream_url;
+    track->chunks_fetched = 0;
+    track->wanted = 0;
+    track->total_size = 0;
+    track->complete = false;
+    track->failed = false;
+    track->cancelled = false;
+    track->finished = false;
+
+    // Tracks retired earlier whose download has wound down since are dropped
+    // now, so only MAX_TRACKS (and any still stopping) hold their data
+    reap_retired(false);
+
+    int id;
+    {
+        std::lock_guard<std::mutex> lock(registry->mutex);
+        id = next_id++;
+        registry->tracks[id] = track;
+
+        // Older tracks stop downloading; curl is killed, so their fetchers end soon
+        while (registry->tracks.size() > MAX_TRACKS) {
+            auto oldest = registry->tracks.begin();
+            cancel(*oldest->second);
+            retired.push_back(oldest->second);
+            registry->tracks.erase(oldest);
+        }
+    }
+    track->fetcher = std::thread(&StreamProxy::fetch_loop, this, track);
+
+    return "http://127.0.0.1:" + std::to_string(port) + "/track/" + std::to_string(id);
+}
+
+void StreamProxy::accept_loop() {
+    while (running) {
+        pollfd pfd{listen_fd, POLLIN, 0};
+        if (poll(&pfd, 1, 200) <= 0) continue;
+
+        int client_fd = accept(listen_fd, nullptr, nullptr);
+        if (client_fd < 0) continue;
+#ifdef SO_NOSIGPIPE
+        int one = 1;
+        setsockopt(client_fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+        // mpv opens a new connection per seek; each one gets its own thread
+        std::thread(&StreamProxy::serve, registry, client_fd).detach();
+    }
+}
+
+void StreamProxy::serve(std::shared_ptr<Registry> registry, int client_fd) {
+    // Read the request head
+    std::string request;
+    char buffer[2048];
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < 16384) {
+        ssize_t n = recv(client_fd, buffer, sizeof(buffer), 0);
+        if (n <= 0) {
+            close(client_fd);
+            return;
+        }
+        request.append(buffer, static_cast<size_t>(n));
+    }
+
+    // "GET /track/<id> HTTP/1.1" or HEAD
+    bool head_only = request.compare(0, 5, "HEAD ") == 0;
+    size_t path_pos = request.find("/track/");
+    int id = path_pos != std::string::npos ? std::atoi(request.c_str() + path_pos + 7) : 0;
+
+    std::shared_ptr<Track> track;
+    {
+        std::lock_guard<std::mutex> lock(registry->mutex);
+        auto it = registry->tracks.find(id);
+        if (it != registry->tracks.end()) track = it->second;
+    }
+    if (!track) {
+        const char* not_found = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        send_all(client_fd, not_found, strlen(not_found));
+        close(client_fd);
+        return;
+    }
+
+    // Range: bytes=<start>-[<end>]
+    uint64_t start = 0;
+    uint64_t end = 0;
+    bool has_range = false;
+    bool has_end = false;
+    size_t range_pos = request.find("Range: bytes=");
+    if (range_pos == std::string::npos) range_pos = request.find("range: bytes=");
+    if (range_pos != std::string::npos) {
+        const char* p = request.c_str() + range_pos + 13;
+        char* after = nullptr;
+        start = std::strtoull(p, &after, 10);
+        has_range = true;
+        if (after && *after == '-' && isdigit(static_cast<unsigned char>(after[1]))) {
+            end = std::strtoull(after + 1, nullptr, 10);
+            has_end = true;
+        }
+    }
+
+    // The size is known after the first upstream response
+    uint64_t total;
+    {
+        std::unique_lock<std::mutex> lock(track->mutex);
+        track->cv.wait(lock, [&]() { return track->total_size > 0 || track->failed || track->cancelled; });
+        total = track->total_size;
+    }
+    if (total == 0 || start >= total) {
+        const char* error = total == 0 ? "HTTP/1.1 502 Bad Gateway\r\nContent-Length: 0\r\nConnection: close\r\n\r\n"
+                                       : "HTTP/1.1 416 Range Not Satisfiable\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        send_all(client_fd, error, strlen(error));
+        close(client_fd);
+        return;
+    }
+    if (!has_end || end >= total) end = total - 1;
+
+    char header[512];
+    if (has_range) {
+        snprintf(header, sizeof(header),
+                 "HTTP/1.1 206 Partial Content\r\nContent-Type: application/octet-stream\r\nAccept-Ranges: bytes\r\n"
+                 "Content-Range: bytes %llu-%llu/%llu\r\nContent-Length: %llu\r\nConnection: close\r\n\r\n",
+                 (unsigned long long)start, (unsigned long long)end, (unsigned long long)total,
+                 (unsigned long long)(end - start + 1));
+    } else {
+        snprintf(header, sizeof(header),
+                 "HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\nAccept-Ranges: bytes\r\n"
+                 "Content-Length: %llu\r\nConnection: close\r\n\r\n",
+                 (unsigned long long)total);
+    }
+    if (!send_all(client_fd, header, strlen(header)) || head_only) {
+        close(client_fd);
+        return;
+    }
+
+    // Hand out bytes as soon as the fetcher has them
+    uint64_t offset = start;
+    std::string chunk;
+    while (offset <= end) {
+        {
+            std::unique_lock<std::mutex> lock(track->mutex);
+            size_t index = static_cast<size_t>(offset / CHUNK_SIZE);
+            if (track->chunks[index].empty()) {
+                // A seek ahead of the download: the fetcher goes there next
+                track->wanted = index;
+                track->cv.wait(lock, [&]() {
+                    return !track->chunks[index].empty() || track->failed || track->cancelled;
+                });
+                if (track->chunks[index].empty()) break;
+            }
+            const std::string& have = track->chunks[index];
+            uint64_t base = index * CHUNK_SIZE;
+            uint64_t available = std::min<uint64_t>(base + have.size(), end + 1);
+            chunk.assign(have, offset - base, available - offset);
+        }
+        if (!send_all(client_fd, chunk.data(), chunk.size())) break;
+        offset += chunk.size();
+    }
+    close(client_fd);
+}
+
+void StreamProxy::cancel(Track& track) {
+    {
+        std::lock_guard<std::mutex> lock(track.mutex);
+        track.cancelled = true;
+    }
+    track.cv.notify_all();
+}
+
+uint64_t StreamProxy::fetch_size(Track& track) {
+    std::string url;
+    {
+        std::lock_guard<std::mutex> lock(track.mutex);
+        url = track.stream_url;
+    }
+
+    // A one-byte range request answers with "Content-Range: bytes 0-0/<total>"
+    ProcessOptions options;
+    options.timeout_ms = 20000;
+    options.cancel = &track.cancelled;
+    std::string headers = run_process({"curl", "-s", "-f", "-L", "--max-time", "15", "-r", "0-0", "-D", "-",
+                                       "-o", "/dev/null", url}, options).output;
+    uint64_t total = 0;
+
+    size_t start = 0;
+    while (start < headers.size()) {
+        size_t end = headers.find('\n', start);
+        if (end == std::string::npos) end = headers.size();
+        // Redirects produce several header blocks; the last Content-Range wins
+        if (strncasecmp(headers.c_str() + start, "Content-Range:", 14) == 0) {
+            size_t slash = headers.find('/', start);
+            if (slash < end) total = std::strtoull(headers.c_str() + slash + 1, nullptr, 10);
+        }
+        start = end + 1;
+    }
+    return total;
+}
+
+bool StreamProxy::fetch_range(Track& track, uint64_t start, uint64_t end, std::string& out) {
+    std::string url;
+    {
+        std::lock_guard<std::mutex> lock(track.mutex);
+        url = track.stream_url;
+    }
+    out.clear();
+
+    // Retiring the track kills curl mid-chunk instead of waiting it out
+    ProcessOptions options;
+    options.timeout_ms = 35000;
+    options.cancel = &track.cancelled;
+    ProcessResult run = run_process({"curl", "-s", "-f", "-L", "--max-time", "30", "-r",
+                                     std::to_string(start) + "-" + std::to_string(end), url},
+                                    options, [&out](const char* data, size_t size) {
+                                        out.append(data, size);
+                                        return true;
+                                    });
+
+    // curl -f exits non-zero on 403/429; a short read means the connection was cut
+    return run.exit_code == 0 && out.size() == end - start + 1;
+}
+
+void StreamProxy::fetch_loop(std::shared_ptr<Track> track) {
+    int retries = 0;
+    auto retry = [&]() {
+        if (++retries > MAX_RETRIES || track->cancelled) return false;
+        // Throttled or expired: back off a little and ask yt-dlp for a fresh URL,
+        // both cut short when the track is retired
+        {
+            std::unique_lock<std::mutex> lock(track->mutex);
+            if (track->cv.wait_for(lock, std::chrono::milliseconds(500 * retries),
+                                   [&]() { return track->cancelled.load(); })) {
+                return false;
+            }
+        }
+        try {
+            std::string fresh = resolver.resolve(track->webpage_url, true, false, &track->cancelled);
+            std::lock_guard<std::mutex> lock(track->mutex);
+            track->stream_url = fresh;
+        } catch (const std::exception& e) {
+            // Keep the old URL; the next attempt may still succeed
+        }
+        return true;
+    };
+
+    uint64_t total = 0;
+    while (!track->cancelled && (total = fetch_size(*track)) == 0) {
+        if (!retry()) break;
+    }
+
+    size_t count = static_cast<size_t>((total + CHUNK_SIZE - 1) / CHUNK_SIZE);
+    {
+        std::lock_guard<std::mutex> lock(track->mutex);
+        track->total_size = total;
+        if (total == 0) track->failed = true;
+        else track->chunks.resize(count);
+    }
+    track->cv.notify_all();
+    if (total == 0) {
+        track->finished = true;
+        return;
+    }
+
+    // Read ahead to the end of the file as fast as upstream allows, jumping
+    // to where a reader waits and coming back for the gaps afterwards
+    size_t next = 0;
+    std::string chunk;
+    while (!track->cancelled) {
+        size_t index;
+        {
+            std::lock_guard<std::mutex> lock(track->mutex);
+            if (track->chunks_fetched == count) break;
+            if (track->wanted < count && track->chunks[track->wanted].empty()) next = track->wanted;
+            while (next < count && !track->chunks[next].empty()) next++;
+            if (next == count) {
+                next = 0;
+                while (!track->chunks[next].empty()) next++;
+            }
+            index = next;
+        }
+        uint64_t offset = index * CHUNK_SIZE;
+        if (!fetch_range(*track, offset, std::min(offset + CHUNK_SIZE, total) - 1, chunk)) {
+            if (!retry()) {
+                std::lock_guard<std::mutex> lock(track->mutex);
+                track->failed = true;
+                break;
+            }
+            continue;
+        }
+        retries = 0;
+        {
+            std::lock_guard<std::mutex> lock(track->mutex);
+            track->chunks[index].swap(chunk);
+            track->chunks_fetched++;
+        }
+        next = index + 1;
+        track->cv.notify_all();
+    }
+
+    bool complete;
+    {
+        std::lock_guard<std::mutex> lock(track->mutex);
+        complete = track->chunks_fetched == count;
+        track->complete = complete;
+    }
+    track->cv.notify_all();
+
+    // Tee the finished download to disk; chunks never change once fetched
+    if (complete && cache.enabled() && !cache.contains(track->webpage_url)) {
+        std::string tmp_path = cache.recording_path(track->webpage_url) + ".proxy";
+        std::ofstream file(tmp_path, std::ios::binary);
+        for (const std::string& piece : track->chunks) {
+            file.write(piece.data(), static_cast<std::streamsize>(piece.size()));
+        }
+        file.close();
+        if (file) cache.insert(track->webpage_url, tmp_path);
+    }
+    track->finished = true;
+}
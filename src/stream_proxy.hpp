@@ -0,0 +1,81 @@
+#ifndef STREAM_PROXY_HPP
+#define STREAM_PROXY_HPP
+
+#include "stream_resolver.hpp"
+#include "audio_cache.hpp"
+#include <string>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <cstdint>
+
+// Loopback HTTP server that mpv streams from instead of googlevideo. Each
+// track is pulled upstream in ranged chunks as fast as the link allows, so
+// mpv always reads from memory; a seek past what has arrived moves the
+// download there. Throttled or expired (403) chunks are retried after
+// re-resolving through yt-dlp, and finished downloads go into the audio cache.
+class StreamProxy {
+public:
+    StreamProxy(StreamResolver& resolver, AudioCache& cache);
+    ~StreamProxy();
+
+    // Enabled by VIBE_FI_STREAM_PROXY=1
+    bool enabled() const;
+
+    // Returns the http://127.0.0.1:<port>/track/<id> URL for mpv, or "" if the server could not start
+    std::string register_track(const std::string& webpage_url, const std::string& stream_url);
+
+private:
+    struct Track {
+        std::string webpage_url;
+        std::string stream_url;
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::vector<std::string> chunks; // CHUNK_SIZE bytes each (the last may be shorter), empty until fetched
+        size_t chunks_fetched;
+        size_t wanted;       // chunk a reader is waiting for; fetched next
+        uint64_t total_size; // 0 until the first response tells us
+        bool complete;
+        bool failed;
+        std::atomic<bool> cancelled;
+        std::atomic<bool> finished; // fetch_loop returned, so the fetcher joins at once
+        std::thread fetcher;
+    };
+
+    // What connections are served from. Serving threads are detached, so they
+    // hold this rather than the proxy, which may be gone before they finish.
+    struct Registry {
+        std::mutex mutex;
+        std::map<int, std::shared_ptr<Track>> tracks;
+    };
+
+    StreamResolver& resolver;
+    AudioCache& cache;
+    bool is_enabled;
+
+    int listen_fd;
+    int port;
+    std::atomic<bool> running;
+    std::thread accept_thread;
+
+    std::shared_ptr<Registry> registry;
+    std::vector<std::shared_ptr<Track>> retired; // evicted, until their fetcher has stopped
+    int next_id;
+
+    bool start();
+    void accept_loop();
+    // Joins the fetchers of retired tracks that have stopped, which frees their data
+    void reap_retired(bool wait);
+    static void serve(std::shared_ptr<Registry> registry, int client_fd);
+    void fetch_loop(std::shared_ptr<Track> track);
+    bool fetch_range(Track& track, uint64_t start, uint64_t end, std::string& out);
+    uint64_t fetch_size(Track& track);
+    // Under the track's lock, so a fetcher or reader about to wait cannot miss it
+    static void cancel(Track& track);
+};
+
+#endif // STREAM_PROXY_HPP
@@ -0,0 +1,55 @@
+#include "stream_resolver.hpp"
+#include "utils.hpp"
+#include <cstdlib>
+#include <cstring>
+
+// Treat URLs as expired a little early so playback never starts on a dying link
+static const time_t EXPIRY_MARGIN = 120;
+// Used when the URL carries no expire= parameter
+static const time_t DEFAULT_LIFETIME = 3600;
+
+StreamResolver::StreamResolver() {}
+
+time_t StreamResolver::parse_expiry(const std::string& stream_url) {
+    // googlevideo puts it in the query string or as a /expire/<ts>/ path segment
+    for (const char* key : {"expire=", "/expire/"}) {
+        size_t pos = stream_url.find(key);
+        if (pos != std::string::npos) {
+            long long value = std::strtoll(stream_url.c_str() + pos + strlen(key), nullptr, 10);
+            if (value > 0) return static_cast<time_t>(value);
+        }
+    }
+    return time(nullptr) + DEFAULT_LIFETIME;
+}
+
+bool StreamResolver::lookup(const std::string& webpage_url, ResolvedStream& out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = streams.find(webpage_url);
+    if (it == streams.end()) return false;
+    if (it->second.expires - EXPIRY_MARGIN <= time(nullptr)) {
+        streams.erase(it);
+        return false;
+    }
+    out = it->second;
+    return true;
+}
+
+void StreamResolver::remember(const std::string& webpage_url, const ResolvedStream& stream) {
+    std::lock_guard<std::mutex> lock(mutex);
+    streams[webpage_url] = stream;
+}
+
+std::string StreamResolver::resolve(const std::string& webpage_url, bool force_refresh, bool low_priority,
+                                    const std::atomic<bool>* cancel) {
+    ResolvedStream cached;
+    if (!force_refresh && lookup(webpage_url, cached)) {
+        return cached.stream_url;
+    }
+
+    // yt-dlp runs outside the lock; two callers racing on one URL just resolve twice
+    ResolvedStream stream;
+    stream.stream_url = get_youtube_stream_url(webpage_url, low_priority, cancel);
+    stream.expires = parse_expiry(stream.stream_url);
+    remember(webpage_url, stream);
+    return stream.stream_url;
+}
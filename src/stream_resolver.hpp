@@ -0,0 +1,36 @@
+#ifndef STREAM_RESOLVER_HPP
+#define STREAM_RESOLVER_HPP
+
+#include <string>
+#include <map>
+#include <mutex>
+#include <ctime>
+#include <atomic>
+
+struct ResolvedStream {
+    std::string stream_url;
+    time_t expires; // from googlevideo's expire= parameter
+};
+
+// Remembers yt-dlp results until the stream URL expires. Thread-safe, so
+// background warmers and the UI share one table.
+class StreamResolver {
+public:
+    StreamResolver();
+
+    // Cached URL if still valid, otherwise runs yt-dlp. Throws like get_youtube_stream_url.
+    std::string resolve(const std::string& webpage_url, bool force_refresh = false, bool low_priority = false,
+                        const std::atomic<bool>* cancel = nullptr);
+
+    // Never blocks; false if nothing valid is cached
+    bool lookup(const std::string& webpage_url, ResolvedStream& out);
+    void remember(const std::string& webpage_url, const ResolvedStream& stream);
+
+    static time_t parse_expiry(const std::string& stream_url);
+
+private:
+    std::mutex mutex;
+    std::map<std::string, ResolvedStream> streams;
+};
+
+#endif // STREAM_RESOLVER_HPP
@@ -0,0 +1,243 @@
+#include "subprocess.hpp"
+#include <spawn.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <cerrno>
+#include <chrono>
+#include <thread>
+#include <stdexcept>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+extern char** environ;
+
+ProcessSlots::ProcessSlots(int count) : available(count) {}
+
+bool ProcessSlots::acquire(const std::atomic<bool>* cancel) {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (available == 0) {
+        if (cancel && *cancel) return false;
+        cv.wait_for(lock, std::chrono::milliseconds(100));
+    }
+    available--;
+    return true;
+}
+
+void ProcessSlots::release() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        available++;
+    }
+    cv.notify_one();
+}
+
+// A pipe whose ends do not leak into children spawned by other threads, with
+// a non-blocking read end
+static void make_pipe(int fds[2]) {
+    // pipe2 sets close-on-exec as the pipe is made; where there is none (macOS)
+    // a spawn on another thread between pipe() and fcntl() can still inherit both ends
+#ifdef __linux__
+    if (pipe2(fds, O_CLOEXEC) != 0) throw std::runtime_error("Subprocess: pipe2() failed");
+#else
+    if (pipe(fds) != 0) throw std::runtime_error("Subprocess: pipe() failed");
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+#endif
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+}
+
+// Appends what fd has ready; false once it is closed (and then closes it)
+static bool read_ready(int& fd, std::string& out) {
+    char buffer[65536];
+    while (true) {
+        ssize_t n = read(fd, buffer, sizeof(buffer));
+        if (n > 0) {
+            out.append(buffer, n);
+        } else if (n == 0) {
+            close(fd);
+            fd = -1;
+            return false;
+        } else if (errno == EINTR) {
+            continue;
+        } else {
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+    }
+}
+
+Subprocess::Subprocess(const std::vector<std::string>& argv, bool low_priority, bool merge_stderr, bool capture_stderr)
+    : pid(-1), out_fd(-1), err_fd(-1), reaped(false), exit_code(-1) {
+    if (argv.empty()) throw std::runtime_error("Subprocess: empty argv");
+
+    int fds[2];
+    int err_fds[2] = {-1, -1};
+    make_pipe(fds);
+    if (capture_stderr && !merge_stderr) {
+        try {
+            make_pipe(err_fds);
+        } catch (const std::runtime_error&) {
+            close(fds[0]);
+            close(fds[1]);
+            throw;
+        }
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, 0, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_adddup2(&actions, fds[1], 1);
+    if (merge_stderr) posix_spawn_file_actions_adddup2(&actions, fds[1], 2);
+    else if (err_fds[1] >= 0) posix_spawn_file_actions_adddup2(&actions, err_fds[1], 2);
+    else posix_spawn_file_actions_addopen(&actions, 2, "/dev/null", O_WRONLY, 0);
+
+    // Own process group, so kill() also reaches anything the tool starts itself;
+    // signal handling is reset in case the parent blocks or ignores something
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    sigset_t none, defaults;
+    sigemptyset(&none);
+    sigemptyset(&defaults);
+    sigaddset(&defaults, SIGPIPE);
+    sigaddset(&defaults, SIGINT);
+    sigaddset(&defaults, SIGTERM);
+    posix_spawnattr_setsigmask(&attr, &none);
+    posix_spawnattr_setsigdefault(&attr, &defaults);
+    posix_spawnattr_setpgroup(&attr, 0);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+    std::vector<char*> args;
+    for (const auto& arg : argv) args.push_back(const_cast<char*>(arg.c_str()));
+    args.push_back(nullptr);
+
+    int err = posix_spawnp(&pid, args[0], &actions, &attr, args.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+    close(fds[1]);
+    if (err_fds[1] >= 0) close(err_fds[1]);
+    if (err != 0) {
+        close(fds[0]);
+        if (err_fds[0] >= 0) close(err_fds[0]);
+        throw std::runtime_error("Subprocess: cannot start " + argv[0]);
+    }
+    out_fd = fds[0];
+    err_fd = err_fds[0];
+
+    if (low_priority) {
+        setpriority(PRIO_PROCESS, pid, 19);
+#ifdef __linux__
+        // IOPRIO_WHO_PROCESS, IOPRIO_CLASS_IDLE
+        syscall(SYS_ioprio_set, 1, pid, 3 << 13);
+#endif
+    }
+}
+
+Subprocess::~Subprocess() {
+    if (!reaped) kill();
+    if (out_fd >= 0) close(out_fd);
+    if (err_fd >= 0) close(err_fd);
+}
+
+bool Subprocess::read_available(std::string& out) {
+    return out_fd >= 0 && read_ready(out_fd, out);
+}
+
+bool Subprocess::read_errors(std::string& out) {
+    return err_fd >= 0 && read_ready(err_fd, out);
+}
+
+bool Subprocess::wait_readable(int timeout_ms) {
+    // A closed pipe is -1, which poll() skips
+    struct pollfd entries[2] = {{out_fd, POLLIN, 0}, {err_fd, POLLIN, 0}};
+    return poll(entries, 2, timeout_ms) > 0;
+}
+
+void Subprocess::kill() {
+    if (reaped) return;
+    ::kill(-pid, SIGTERM);
+    for (int i = 0; i < 30; ++i) {
+        int status;
+        if (waitpid(pid, &status, WNOHANG) == pid) {
+            reaped = true;
+            exit_code = -1;
+            return;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ::kill(-pid, SIGKILL);
+    int status;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {}
+    reaped = true;
+    exit_code = -1;
+}
+
+int Subprocess::wait() {
+    if (reaped) return exit_code;
+    int status = 0;
+    pid_t done;
+    while ((done = waitpid(pid, &status, 0)) < 0 && errno == EINTR) {}
+    reaped = true;
+    exit_code = (done == pid && WIFEXITED(status)) ? WEXITSTATUS(status) : -1;
+    return exit_code;
+}
+
+ProcessResult run_process(const std::vector<std::string>& argv, const ProcessOptions& options,
+                          const std::function<bool(const char*, size_t)>& on_output) {
+    ProcessResult result;
+    if (options.slots && !options.slots->acquire(options.cancel)) return result;
+    struct SlotGuard {
+        ProcessSlots* slots;
+        ~SlotGuard() { if (slots) slots->release(); }
+    } guard{options.slots};
+
+    try {
+        Subprocess process(argv, options.low_priority, options.merge_stderr, options.errors != nullptr);
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(options.timeout_ms);
+        std::string chunk;
+        std::string& sink = on_output ? chunk : result.output;
+        bool stopped = false;
+        bool open = true;
+        bool errors_open = options.errors != nullptr;
+
+        while (open || errors_open) {
+            // Short waits, so a cancel or the deadline is noticed even while the tool is silent
+            int wait_ms = 100;
+            if (options.timeout_ms > 0) {
+                auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+                if (left.count() <= 0) {
+                    result.timed_out = true;
+                    stopped = true;
+                    break;
+                }
+                if (left.count() < wait_ms) wait_ms = static_cast<int>(left.count());
+            }
+            if (options.cancel && *options.cancel) {
+                stopped = true;
+                break;
+            }
+
+            process.wait_readable(wait_ms);
+            if (open) open = process.read_available(sink);
+            // Read to the end too: tools often report only as they exit
+            if (errors_open) errors_open = process.read_errors(*options.errors);
+            if (on_output && !chunk.empty()) {
+                bool more = on_output(chunk.data(), chunk.size());
+                chunk.clear();
+                if (!more) {
+                    stopped = true;
+                    break;
+                }
+            }
+        }
+
+        if (stopped) process.kill();
+        result.exit_code = process.wait();
+    } catch (const std::runtime_error&) {
+        // Tool missing or no fds left; reported as exit_code -1
+    }
+    return result;
+}
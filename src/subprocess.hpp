@@ -0,0 +1,84 @@
+#ifndef SUBPROCESS_HPP
+#define SUBPROCESS_HPP
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <sys/types.h>
+
+// Caps how many children of one kind run at once; callers past the cap wait
+class ProcessSlots {
+public:
+    explicit ProcessSlots(int count);
+
+    // False if `cancel` was set while waiting
+    bool acquire(const std::atomic<bool>* cancel = nullptr);
+    void release();
+
+private:
+    std::mutex mutex;
+    std::condition_variable cv;
+    int available;
+};
+
+// One external tool started with posix_spawn from an argv vector, never through
+// a shell, so arguments need no quoting. stdin and stderr go to /dev/null and
+// stdout is a non-blocking pipe the caller can poll alongside anything else;
+// stderr can have a pipe of its own.
+class Subprocess {
+public:
+    // Throws std::runtime_error if the program cannot be started. With merge_stderr,
+    // stderr shares the stdout pipe (for tools that report on stderr, like ffmpeg);
+    // with capture_stderr it is read apart, for tools whose stdout is data.
+    Subprocess(const std::vector<std::string>& argv, bool low_priority = false, bool merge_stderr = false,
+               bool capture_stderr = false);
+    ~Subprocess(); // Kills the child if it is still running
+    Subprocess(const Subprocess&) = delete;
+    Subprocess& operator=(const Subprocess&) = delete;
+
+    int output_fd() const { return out_fd; }
+
+    // Appends whatever output is ready without blocking; false once stdout is closed
+    bool read_available(std::string& out);
+    // The same for stderr, if it was captured; false once it is closed
+    bool read_errors(std::string& out);
+    // Blocks up to timeout_ms for output, errors or end of stream
+    bool wait_readable(int timeout_ms);
+
+    // SIGTERM to the child's process group, SIGKILL if it lingers
+    void kill();
+    // Reaps the child; its exit code, or -1 if it was killed by a signal
+    int wait();
+
+private:
+    pid_t pid;
+    int out_fd;
+    int err_fd; // -1 unless stderr is captured, and once it is closed
+    bool reaped;
+    int exit_code;
+};
+
+struct ProcessOptions {
+    int timeout_ms = 0;                         // 0 waits as long as it takes
+    bool low_priority = false;                  // nice 19, plus the idle I/O class on Linux
+    bool merge_stderr = false;                  // collect stderr along with stdout
+    std::string* errors = nullptr;              // or collect it here, apart from stdout
+    ProcessSlots* slots = nullptr;              // concurrency cap to take a slot from
+    const std::atomic<bool>* cancel = nullptr;  // set it from anywhere to kill the child
+};
+
+struct ProcessResult {
+    int exit_code = -1; // -1 if not started, killed, cancelled or timed out
+    bool timed_out = false;
+    std::string output; // stays empty when on_output takes the data
+};
+
+// Runs a tool to completion. With on_output, output is handed over as it
+// arrives instead of collected; returning false from it stops the child.
+ProcessResult run_process(const std::vector<std::string>& argv, const ProcessOptions& options = {},
+                          const std::function<bool(const char*, size_t)>& on_output = nullptr);
+
+#endif // SUBPROCESS_HPP
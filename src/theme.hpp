@@ -0,0 +1,85 @@
+#ifndef THEME_HPP
+#define THEME_HPP
+
+#include <ncurses.h>
+
+// What an element is, not how it looks. Each role is also its color pair number.
+enum ThemeRole {
+    ROLE_BORDER = 1, // Borders/Text
+    ROLE_ACTIVE,     // Progress/Active
+    ROLE_VISUALIZER,
+    ROLE_ALERT,      // Alerts/Help
+    ROLE_BACKGROUND, // Background elements
+    ROLE_SELECTED,   // Selected item
+    ROLE_COUNT
+};
+
+struct ThemeStyle {
+    short fg;
+    short bg; // -1 is the terminal's own background
+    attr_t attr;
+};
+
+struct Theme {
+    const char* name;
+    ThemeStyle styles[ROLE_COUNT]; // Indexed by role, 0 unused
+};
+
+// A plain character, or an ACS line-drawing code looked up once curses is running
+struct Glyph {
+    char ch;
+    bool acs;
+};
+
+struct GlyphSet {
+    const char* name;
+    Glyph bar;     // Visualizer columns
+    char progress; // Filled part of the seek bar
+    const char* wave; // Waveform seek bar, quietest level first
+    Glyph vline, hline, ulcorner, urcorner, llcorner, lrcorner, ttee, btee;
+};
+
+inline constexpr Theme THEMES[] = {
+    {"default", {{}, {COLOR_CYAN, -1, 0}, {COLOR_GREEN, -1, 0}, {COLOR_MAGENTA, -1, 0},
+                 {COLOR_RED, -1, 0}, {COLOR_BLUE, -1, 0}, {COLOR_BLACK, COLOR_CYAN, 0}}},
+    {"mono", {{}, {-1, -1, A_NORMAL}, {-1, -1, A_BOLD}, {-1, -1, A_BOLD},
+              {-1, -1, A_UNDERLINE}, {-1, -1, A_DIM}, {-1, -1, A_REVERSE}}},
+    {"amber", {{}, {COLOR_YELLOW, -1, 0}, {COLOR_YELLOW, -1, A_BOLD}, {COLOR_YELLOW, -1, 0},
+               {COLOR_RED, -1, 0}, {COLOR_YELLOW, -1, A_DIM}, {COLOR_BLACK, COLOR_YELLOW, 0}}},
+    {"ocean", {{}, {COLOR_BLUE, -1, 0}, {COLOR_CYAN, -1, 0}, {COLOR_CYAN, -1, 0},
+               {COLOR_MAGENTA, -1, 0}, {COLOR_BLUE, -1, 0}, {COLOR_WHITE, COLOR_BLUE, 0}}},
+    {"forest", {{}, {COLOR_GREEN, -1, 0}, {COLOR_YELLOW, -1, 0}, {COLOR_GREEN, -1, 0},
+                {COLOR_RED, -1, 0}, {COLOR_GREEN, -1, A_DIM}, {COLOR_BLACK, COLOR_GREEN, 0}}},
+};
+
+inline constexpr GlyphSet GLYPH_SETS[] = {
+    {"line", {'a', true}, '=', "_.:|", {'x', true}, {'q', true}, {'l', true}, {'k', true},
+     {'m', true}, {'j', true}, {'w', true}, {'v', true}},
+    {"block", {'0', true}, '#', "_-=#", {'x', true}, {'q', true}, {'l', true}, {'k', true},
+     {'m', true}, {'j', true}, {'w', true}, {'v', true}},
+    {"ascii", {'#', false}, '=', "_.:|", {'|', false}, {'-', false}, {'+', false}, {'+', false},
+     {'+', false}, {'+', false}, {'+', false}, {'+', false}},
+};
+
+constexpr bool name_equals(const char* a, const char* b) {
+    while (*a && *a == *b) { ++a; ++b; }
+    return *a == *b;
+}
+
+// Unknown or missing names fall back to the first entry
+template <typename T, size_t N>
+constexpr const T& find_by_name(const T (&table)[N], const char* name) {
+    for (size_t i = 0; name && i < N; ++i) {
+        if (name_equals(table[i].name, name)) return table[i];
+    }
+    return table[0];
+}
+
+static_assert(name_equals(find_by_name(THEMES, "ocean").name, "ocean"), "theme lookup");
+static_assert(name_equals(find_by_name(GLYPH_SETS, nullptr).name, "line"), "glyph fallback");
+
+inline chtype glyph(Glyph g) {
+    return g.acs ? NCURSES_ACS(g.ch) : static_cast<chtype>(static_cast<unsigned char>(g.ch));
+}
+
+#endif // THEME_HPP
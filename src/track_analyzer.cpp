@@ -0,0 +1,175 @@
+#include "track_analyzer.hpp"
+#include "waveform.hpp"
+#include "subprocess.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+static const double DEFAULT_TARGET_LUFS = -18.0; // ReplayGain 2.0 reference level
+static const double MAX_PEAK_DBTP = -1.0;        // headroom kept after gain
+static const double MIN_GAIN_DB = -24.0;
+static const double MAX_GAIN_DB = 12.0;          // mpv's default volume-gain-max
+static const int DECODE_TIMEOUT_MS = 10 * 60 * 1000;
+
+TrackAnalyzer::TrackAnalyzer(LibraryIndex& idx, bool with_waveforms, int workers_count)
+    : index(idx), waveforms(with_waveforms), max_workers(workers_count), is_enabled(true),
+      target(DEFAULT_TARGET_LUFS), stopping(false), stored(0) {
+    const char* setting = getenv("VIBE_FI_LOUDNESS_TARGET");
+    if (setting && *setting) {
+        char* end;
+        double value = strtod(setting, &end);
+        if (end != setting && *end == '\0') target = value;
+        else is_enabled = false; // "off", or anything else that is not a number
+    }
+}
+
+TrackAnalyzer::~TrackAnalyzer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        jobs.clear();
+    }
+    cv.notify_all();
+    for (auto& worker : workers) {
+        if (worker.joinable()) worker.join();
+    }
+}
+
+void TrackAnalyzer::missing(const std::string& key, bool& loudness, bool& waveform) {
+    TrackAnalysis known;
+    bool found = index.lookup(key, known);
+    loudness = is_enabled && !(found && known.has_loudness);
+    waveform = waveforms && !(found && !known.waveform.empty());
+}
+
+void TrackAnalyzer::request(const std::string& key, const std::string& file) {
+    if (file.empty()) return;
+    bool loudness, waveform;
+    missing(key, loudness, waveform);
+    if (!loudness && !waveform) return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!pending.insert(key).second) return;
+    jobs.push_back({key, file});
+    // Workers are started on first use, never more than the limit
+    while (static_cast<int>(workers.size()) < max_workers && workers.size() < jobs.size()) {
+        workers.emplace_back(&TrackAnalyzer::worker_loop, this);
+    }
+    cv.notify_one();
+}
+
+bool TrackAnalyzer::gain_for(const std::string& key, double& gain_db) {
+    TrackAnalysis analysis;
+    if (!is_enabled || !index.lookup(key, analysis) || !analysis.has_loudness) return false;
+    // ebur128 reports -70 LUFS for silence, where any gain is meaningless
+    if (analysis.loudness <= -70.0f) {
+        gain_db = 0.0;
+        return true;
+    }
+    double gain = target - analysis.loudness;
+    gain = std::min(gain, MAX_PEAK_DBTP - analysis.peak);
+    gain_db = std::max(MIN_GAIN_DB, std::min(MAX_GAIN_DB, gain));
+    return true;
+}
+
+void TrackAnalyzer::store(const std::string& key, const TrackAnalysis& analysis, bool loudness, bool waveform) {
+    if (loudness && analysis.has_loudness) index.store_loudness(key, analysis.loudness, analysis.peak);
+    if (waveform && !analysis.waveform.empty()) {
+        index.store_waveform(key, analysis.waveform);
+        stored++;
+    }
+}
+
+static bool read_value(const std::string& output, size_t from, const char* section, const char* label, float& out) {
+    size_t at = output.find(section, from);
+    if (at == std::string::npos) return false;
+    at = output.find(label, at);
+    if (at == std::string::npos) return false;
+    const char* start = output.c_str() + at + strlen(label);
+    char* end;
+    double value = strtod(start, &end);
+    if (end == start) return false;
+    out = static_cast<float>(value);
+    return true;
+}
+
+bool TrackAnalyzer::decode(const std::string& file, const Samples& samples, TrackAnalysis* loudness,
+                           const std::atomic<bool>* cancel) {
+    // The filter sees every channel at the file's own rate; -ac and -ar apply after it.
+    // framelog=verbose keeps the per-frame lines below the default log level, so
+    // only the summary is printed (on stderr, like all of ffmpeg's logging)
+    std::vector<std::string> argv = {"ffmpeg", "-nostdin", "-hide_banner", "-nostats", "-i", file, "-vn", "-sn"};
+    if (loudness) argv.insert(argv.end(), {"-af", "ebur128=peak=true:framelog=verbose"});
+    if (samples) argv.insert(argv.end(), {"-ac", "1", "-ar", std::to_string(SAMPLE_RATE), "-f", "s16le", "-"});
+    else argv.insert(argv.end(), {"-f", "null", "-"});
+
+    std::string log;
+    ProcessOptions options;
+    options.timeout_ms = DECODE_TIMEOUT_MS;
+    options.low_priority = true;
+    options.cancel = cancel;
+    if (loudness) options.errors = &log;
+    std::string carry; // a sample split across two reads
+    std::vector<int16_t> buffer;
+    ProcessResult run = run_process(argv, options, [&](const char* data, size_t size) {
+        carry.append(data, size);
+        size_t whole = carry.size() / sizeof(int16_t);
+        buffer.resize(whole);
+        memcpy(buffer.data(), carry.data(), whole * sizeof(int16_t));
+        if (samples) samples(buffer.data(), whole);
+        carry.erase(0, whole * sizeof(int16_t));
+        return true;
+    });
+    if (run.exit_code != 0) return false;
+    if (!loudness) return true;
+
+    size_t summary = log.rfind("Summary:");
+    if (summary == std::string::npos) return false;
+    if (!read_value(log, summary, "Integrated loudness:", "I:", loudness->loudness)) return false;
+    // Older ffmpeg builds without true peak support still give a usable loudness
+    if (!read_value(log, summary, "True peak:", "Peak:", loudness->peak)) loudness->peak = 0.0f;
+    loudness->has_loudness = true;
+    return true;
+}
+
+bool TrackAnalyzer::analyze(const std::string& file, bool loudness, bool waveform, TrackAnalysis& out,
+                            const std::atomic<bool>* cancel) {
+    WaveformReducer reducer(SAMPLE_RATE);
+    Samples samples;
+    if (waveform) samples = [&](const int16_t* data, size_t count) { reducer.feed(data, count); };
+    TrackAnalysis analysis;
+    if (!decode(file, samples, loudness ? &analysis : nullptr, cancel)) return false;
+    if (waveform) {
+        analysis.waveform = reducer.finish();
+        if (analysis.waveform.empty()) return false;
+    }
+    out = analysis;
+    return true;
+}
+
+void TrackAnalyzer::worker_loop() {
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [this]() { return stopping || !jobs.empty(); });
+            if (stopping) return;
+            job = jobs.front();
+            jobs.pop_front();
+        }
+
+        // The beat tracker may have measured it since, if it started playing
+        bool loudness, waveform;
+        missing(job.key, loudness, waveform);
+        TrackAnalysis analysis;
+        if (!loudness && !waveform) {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending.erase(job.key);
+        } else if (analyze(job.file, loudness, waveform, analysis, &stopping)) {
+            store(job.key, analysis, loudness, waveform);
+            std::lock_guard<std::mutex> lock(mutex);
+            pending.erase(job.key);
+        }
+        // Failures stay pending, so an undecodable file is not retried this session
+    }
+}
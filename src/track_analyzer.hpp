@@ -0,0 +1,79 @@
+#ifndef TRACK_ANALYZER_HPP
+#define TRACK_ANALYZER_HPP
+
+#include "library_index.hpp"
+#include <string>
+#include <vector>
+#include <deque>
+#include <set>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <cstdint>
+
+// Analyses each track once, in a small pool of low-priority workers, and keeps
+// the results in the library index: the EBU R128 loudness, which becomes a gain
+// for mpv to apply on load so playback itself does no loudness analysis, and
+// the mini-waveform for the seek bar. Whatever a track lacks comes from one
+// decode of it, which BeatTracker shares for the track playing.
+// VIBE_FI_LOUDNESS_TARGET sets the target in LUFS (default -18); "off" disables the loudness part.
+class TrackAnalyzer {
+public:
+    // The rate decode() hands samples over at
+    static const int SAMPLE_RATE = 11025;
+
+    using Samples = std::function<void(const int16_t* samples, size_t count)>;
+
+    TrackAnalyzer(LibraryIndex& index, bool waveforms = true, int max_workers = 2);
+    ~TrackAnalyzer();
+
+    bool loudness_enabled() const { return is_enabled; }
+
+    // Queues `file` for whatever is missing, stored under `key` (the path itself,
+    // or the URL a cached stream was downloaded from). Known or queued keys are skipped.
+    void request(const std::string& key, const std::string& file);
+    // Gain in dB that brings this track to the target without clipping; false if not measured yet
+    bool gain_for(const std::string& key, double& gain_db);
+    // Bumped whenever a waveform is stored, so callers know when to look again
+    uint64_t version() const { return stored; }
+
+    // What a decode of `key` should measure: the parts enabled here that the index lacks
+    void missing(const std::string& key, bool& loudness, bool& waveform);
+    // Stores what a decode done elsewhere measured
+    void store(const std::string& key, const TrackAnalysis& analysis, bool loudness, bool waveform);
+
+    // One ffmpeg run over the file: samples get the audio as mono 16-bit at
+    // SAMPLE_RATE, and with `loudness` ebur128 measures the decoded audio
+    // before it is downmixed. False if the file could not be decoded.
+    static bool decode(const std::string& file, const Samples& samples, TrackAnalysis* loudness,
+                       const std::atomic<bool>* cancel = nullptr);
+    // Both parts of one file in one decode; false if it could not be decoded
+    static bool analyze(const std::string& file, bool loudness, bool waveform, TrackAnalysis& out,
+                        const std::atomic<bool>* cancel = nullptr);
+
+private:
+    struct Job {
+        std::string key;
+        std::string file;
+    };
+
+    LibraryIndex& index;
+    bool waveforms;
+    int max_workers;
+    bool is_enabled;
+    double target;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<Job> jobs;
+    std::set<std::string> pending; // queued or being analysed
+    std::vector<std::thread> workers;
+    std::atomic<bool> stopping;
+    std::atomic<uint64_t> stored;
+
+    void worker_loop();
+};
+
+#endif // TRACK_ANALYZER_HPP
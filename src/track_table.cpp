@@ -0,0 +1,145 @@
+#include "track_table.hpp"
+#include <cstring>
+#include <functional>
+
+// Index tables are kept at most half full so probe runs stay short
+static size_t slot_for(size_t hash, size_t capacity) {
+    return hash & (capacity - 1);
+}
+
+static size_t hash_pair(StrId a, StrId b) {
+    uint64_t key = (static_cast<uint64_t>(a) << 32) | b;
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    return static_cast<size_t>(key);
+}
+
+StringPool::StringPool() : block_used(BLOCK_SIZE), total_bytes(0), slots(1024, EMPTY_SLOT) {
+    intern(""); // Id 0
+}
+
+char* StringPool::allocate(size_t size) {
+    // Oversized strings get a block of their own
+    if (size > BLOCK_SIZE / 4) {
+        blocks.emplace_back(new char[size]);
+        char* own = blocks.back().get();
+        // Keep filling the current block afterwards
+        if (blocks.size() > 1) std::swap(blocks[blocks.size() - 1], blocks[blocks.size() - 2]);
+        return own;
+    }
+    if (block_used + size > BLOCK_SIZE) {
+        blocks.emplace_back(new char[BLOCK_SIZE]);
+        block_used = 0;
+    }
+    char* out = blocks.back().get() + block_used;
+    block_used += size;
+    return out;
+}
+
+void StringPool::grow_index() {
+    std::vector<StrId> bigger(slots.size() * 2, EMPTY_SLOT);
+    for (StrId id = 0; id < strings.size(); ++id) {
+        size_t slot = slot_for(std::hash<std::string_view>()(std::string_view(strings[id], lengths[id])), bigger.size());
+        while (bigger[slot] != EMPTY_SLOT) slot = (slot + 1) & (bigger.size() - 1);
+        bigger[slot] = id;
+    }
+    slots.swap(bigger);
+}
+
+StrId StringPool::intern(std::string_view text) {
+    size_t hash = std::hash<std::string_view>()(text);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t slot = slot_for(hash, slots.size());
+    while (slots[slot] != EMPTY_SLOT) {
+        StrId id = slots[slot];
+        if (lengths[id] == text.size() && memcmp(strings[id], text.data(), text.size()) == 0) return id;
+        slot = (slot + 1) & (slots.size() - 1);
+    }
+
+    char* stored = allocate(text.size() + 1);
+    memcpy(stored, text.data(), text.size());
+    stored[text.size()] = '\0';
+    total_bytes += text.size() + 1;
+
+    StrId id = static_cast<StrId>(strings.size());
+    strings.push_back(stored);
+    lengths.push_back(static_cast<uint32_t>(text.size()));
+    slots[slot] = id;
+    if (strings.size() * 2 > slots.size()) grow_index();
+    return id;
+}
+
+const char* StringPool::c_str(StrId id) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return id < strings.size() ? strings[id] : strings[0];
+}
+
+size_t StringPool::count() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return strings.size();
+}
+
+size_t StringPool::bytes() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return total_bytes;
+}
+
+TrackTable::TrackTable() : slots(1024, EMPTY_SLOT) {
+    records.push_back({0, 0, 0}); // Id 0, the empty track
+    slots[slot_for(hash_pair(0, 0), slots.size())] = 0;
+}
+
+void TrackTable::grow_index() {
+    std::vector<TrackId> bigger(slots.size() * 2, EMPTY_SLOT);
+    for (TrackId id = 0; id < records.size(); ++id) {
+        size_t slot = slot_for(hash_pair(records[id].title, records[id].url), bigger.size());
+        while (bigger[slot] != EMPTY_SLOT) slot = (slot + 1) & (bigger.size() - 1);
+        bigger[slot] = id;
+    }
+    slots.swap(bigger);
+}
+
+TrackId TrackTable::add(std::string_view title, std::string_view url, int duration) {
+    StrId title_id = string_pool().intern(title);
+    StrId url_id = string_pool().intern(url);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t slot = slot_for(hash_pair(title_id, url_id), slots.size());
+    while (slots[slot] != EMPTY_SLOT) {
+        TrackRecord& existing = records[slots[slot]];
+        if (existing.title == title_id && existing.url == url_id) {
+            // A later source may know the duration when the first one did not
+            if (existing.duration == 0) existing.duration = duration;
+            return slots[slot];
+        }
+        slot = (slot + 1) & (slots.size() - 1);
+    }
+
+    TrackId id = static_cast<TrackId>(records.size());
+    records.push_back({title_id, url_id, static_cast<int32_t>(duration)});
+    slots[slot] = id;
+    if (records.size() * 2 > slots.size()) grow_index();
+    return id;
+}
+
+TrackRecord TrackTable::get(TrackId id) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return id < records.size() ? records[id] : records[0];
+}
+
+size_t TrackTable::count() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return records.size();
+}
+
+StringPool& string_pool() {
+    static StringPool pool;
+    return pool;
+}
+
+TrackTable& track_table() {
+    static TrackTable table;
+    return table;
+}
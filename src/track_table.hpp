@@ -0,0 +1,85 @@
+#ifndef TRACK_TABLE_HPP
+#define TRACK_TABLE_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+
+using StrId = uint32_t;
+using TrackId = uint32_t;
+
+const uint32_t EMPTY_SLOT = UINT32_MAX;
+
+// Interned strings packed into 64 KiB arena blocks. Every distinct string is
+// stored once; ids and c_str() pointers stay valid for the life of the process.
+class StringPool {
+public:
+    StringPool();
+
+    StrId intern(std::string_view text);
+    const char* c_str(StrId id) const;
+    size_t count() const;
+    size_t bytes() const;
+
+private:
+    static const size_t BLOCK_SIZE = 64 * 1024;
+
+    mutable std::mutex mutex;
+    std::vector<std::unique_ptr<char[]>> blocks;
+    size_t block_used;
+    size_t total_bytes;
+    std::vector<const char*> strings;
+    std::vector<uint32_t> lengths;
+    std::vector<StrId> slots; // open-addressed index of ids, EMPTY_SLOT when free
+
+    char* allocate(size_t size);
+    void grow_index();
+};
+
+// One row per distinct (title, url) pair; search results and playlist songs
+// that refer to the same video share a row.
+struct TrackRecord {
+    StrId title;
+    StrId url;
+    int32_t duration; // in seconds, 0 if unknown
+};
+
+class TrackTable {
+public:
+    TrackTable();
+
+    TrackId add(std::string_view title, std::string_view url, int duration);
+    TrackRecord get(TrackId id) const;
+    size_t count() const;
+
+private:
+    mutable std::mutex mutex;
+    std::vector<TrackRecord> records;
+    std::vector<TrackId> slots; // open-addressed on (title, url)
+
+    void grow_index();
+};
+
+// Process-wide tables shared by every view
+StringPool& string_pool();
+TrackTable& track_table();
+
+// What views hold instead of copies: a 4-byte handle into the track table.
+// Copying a list of these between views copies indices, never strings.
+struct TrackRef {
+    TrackId id = 0; // 0 is the empty track
+
+    TrackRef() = default;
+    TrackRef(const std::string& title, const std::string& url, int duration)
+        : id(track_table().add(title, url, duration)) {}
+
+    const char* title() const { return string_pool().c_str(track_table().get(id).title); }
+    const char* url() const { return string_pool().c_str(track_table().get(id).url); }
+    StrId url_id() const { return track_table().get(id).url; }
+    int duration() const { return track_table().get(id).duration; }
+};
+
+#endif // TRACK_TABLE_HPP
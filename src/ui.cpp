@@ -7,10 +7,51 @@
 #include <thread>
 #include <algorithm>
 #include <filesystem>
+#include <cstring>
+#include <csignal>
+#include <sys/ioctl.h>
+#include <unistd.h>
 
 namespace fs = std::filesystem;
 
-UI::UI(Player& p) : player(p), running(true), mode(AppMode::PLAYBACK), selection_index(0), scroll_offset(0), lyrics_scroll_offset(0), lyrics_auto_scroll(true) {
+// Duration column text; blank when unknown
+static std::string duration_label(int seconds) {
+    return seconds > 0 ? format_duration(seconds) : "";
+}
+
+// "5m ago" for today's plays, the date for older ones
+static std::string played_label(int64_t when) {
+    int64_t ago = static_cast<int64_t>(time(nullptr)) - when;
+    char buffer[32];
+    if (ago < 60) return "just now";
+    if (ago < 3600) snprintf(buffer, sizeof(buffer), "%lldm ago", static_cast<long long>(ago / 60));
+    else if (ago < 86400) snprintf(buffer, sizeof(buffer), "%lldh ago", static_cast<long long>(ago / 3600));
+    else {
+        time_t t = static_cast<time_t>(when);
+        struct tm local;
+        localtime_r(&t, &local);
+        strftime(buffer, sizeof(buffer), "%Y-%m-%d", &local);
+    }
+    return buffer;
+}
+
+// Only the flag is touched in the handler; the main loop does the rest
+static volatile sig_atomic_t winch_received = 0;
+
+static void on_sigwinch(int) {
+    winch_received = 1;
+}
+
+// A resize is applied once no SIGWINCH arrived for this long, or at the latest
+// after RESIZE_MAX_DELAY so a long drag still redraws along the way
+static const std::chrono::milliseconds RESIZE_SETTLE(40);
+static const std::chrono::milliseconds RESIZE_MAX_DELAY(150);
+// How often the session snapshot is brought up to date; it is also written on quit
+static const std::chrono::seconds SESSION_SAVE_INTERVAL(10);
+
+UI::UI(Player& p) : player(p), running(true), mode(AppMode::PLAYBACK), main_win(nullptr), visualizer_win(nullptr), status_win(nullptr), help_win(nullptr), lyrics_win(nullptr), playlist_warmer(stream_resolver, audio_cache), stream_proxy(stream_resolver, audio_cache), analyzer(library_index), beats(analyzer), waveform_version(0), selection_index(0), list_version(0), scroll_offset(0), lyrics_scroll_offset(0), lyrics_auto_scroll(true), lyrics_duration(0.0) {
+    help_cache.valid = false;
+
     set_escdelay(25);
     initscr();
     cbreak();
@@ -19,27 +60,56 @@ UI::UI(Player& p) : player(p), running(true), mode(AppMode::PLAYBACK), selection
     keypad(stdscr, TRUE);
     timeout(100); 
     
+    // Replaces curses' own handler, which would resize inside getch()
+    struct sigaction winch = {};
+    winch.sa_handler = on_sigwinch;
+    sigemptyset(&winch.sa_mask);
+    // SA_RESTART keeps reads in worker threads from failing with EINTR; getch()
+    // waits in poll(), which is never restarted, so it still wakes up at once
+    winch.sa_flags = SA_RESTART;
+    sigaction(SIGWINCH, &winch, nullptr);
+    resize_pending = false;
+    
     start_color();
     use_default_colors();
     
-    // Define colors
-    init_pair(1, COLOR_CYAN, -1);    // Borders/Text
-    init_pair(2, COLOR_GREEN, -1);   // Progress/Active
-    init_pair(3, COLOR_MAGENTA, -1); // Visualizer
-    init_pair(4, COLOR_RED, -1);     // Alerts/Help
-    init_pair(5, COLOR_BLUE, -1);    // Background elements
-    init_pair(6, COLOR_BLACK, COLOR_CYAN); // Selected item
+    // Define colors, one pair per theme role
+    theme = &find_by_name(THEMES, getenv("VIBE_FI_THEME"));
+    glyphs = &find_by_name(GLYPH_SETS, getenv("VIBE_FI_GLYPHS"));
+    for (int role = ROLE_BORDER; role < ROLE_COUNT; ++role) {
+        init_pair(role, theme->styles[role].fg, theme->styles[role].bg);
+    }
 
     refresh(); // Refresh stdscr before creating windows
     
-    // Initialize library
-    current_path = library.get_home_music_dir();
-    library_items = library.list_directory(current_path);
+    // Library is listed on first visit, in the background
+    library_loaded = false;
+    library_version = 0;
+    library_selected = 0;
+    filter_editing = false;
+    frame_stats = getenv("VIBE_FI_FRAME_STATS") != nullptr;
+    events.listen_on(EventHub::socket_path());
+    
+    // Startup defaults
+    startup_next = 0;
+    startup_playing = false;
+    startup_time = std::chrono::steady_clock::now();
+    first_frame_ms = -1.0;
+    first_audio_ms = -1.0;
+    
+    queue_source = QueueSource::NONE;
+    queue_failures = 0;
+    session_pending = false;
+    session_state_hash = 0;
+    session_queue_hash = 0;
+    session_lyrics_hash = 0;
+    session_saved_at = std::chrono::steady_clock::now();
+    history_most_played = false;
+    resume_position = -1.0;
+    recording_seeked = false;
     
     // Autoplay defaults
     autoplay_enabled = true;
-    playing_index = -1;
-    is_playing_from_playlist = false;
 }
 
 UI::~UI() {
@@ -49,6 +119,18 @@ UI::~UI() {
     if (help_win) delwin(help_win);
     if (main_win) delwin(main_win);
     endwin();
+    
+    if (getenv("VIBE_FI_STARTUP_TIMING")) {
+        fprintf(stderr, "vibe-fi: first frame %.1f ms, first audio %.1f ms\n", first_frame_ms, first_audio_ms);
+    }
+    if (frame_stats && !frame_times.empty()) {
+        std::sort(frame_times.begin(), frame_times.end());
+        double total = 0;
+        for (float t : frame_times) total += t;
+        size_t n = frame_times.size();
+        fprintf(stderr, "vibe-fi: %zu frames, mean %.3f ms, p50 %.3f ms, p99 %.3f ms, max %.3f ms\n", n, total / n,
+                frame_times[n / 2], frame_times[std::min(n - 1, n * 99 / 100)], frame_times[n - 1]);
+    }
 }
 
 WINDOW* UI::create_window(int height, int width, int starty, int startx) {
@@ -56,79 +138,241 @@ WINDOW* UI::create_window(int height, int width, int starty, int startx) {
     return local_win;
 }
 
+attr_t UI::style(ThemeRole role) const {
+    return COLOR_PAIR(role) | theme->styles[role].attr;
+}
+
 void UI::draw_borders(WINDOW* win, const std::string& title) {
-    wattron(win, COLOR_PAIR(1));
-    box(win, 0, 0);
+    int h, w;
+    getmaxyx(win, h, w);
+    auto it = chrome.find(win);
+    if (it != chrome.end() && it->second.h == h && it->second.w == w && it->second.title == title) {
+        wnoutrefresh(win);
+        return;
+    }
+    
+    const GlyphSet& g = *glyphs;
+    wattron(win, style(ROLE_BORDER));
+    wborder(win, glyph(g.vline), glyph(g.vline), glyph(g.hline), glyph(g.hline),
+            glyph(g.ulcorner), glyph(g.urcorner), glyph(g.llcorner), glyph(g.lrcorner));
     if (!title.empty()) {
         mvwprintw(win, 0, 2, " %s ", title.c_str());
     }
-    wattroff(win, COLOR_PAIR(1));
+    wattroff(win, style(ROLE_BORDER));
+    chrome[win] = {h, w, title};
     wnoutrefresh(win);
 }
 
+void UI::erase_interior(WINDOW* win) {
+    // The frame stays as drawn; a window without one yet is cleared whole
+    int h, w;
+    getmaxyx(win, h, w);
+    auto it = chrome.find(win);
+    if (it == chrome.end() || it->second.h != h || it->second.w != w) {
+        werase(win);
+        return;
+    }
+    wattrset(win, A_NORMAL);
+    for (int y = 1; y < h - 1; ++y) {
+        mvwhline(win, y, 1, ' ', w - 2);
+    }
+}
+
+void UI::invalidate_chrome() {
+    chrome.clear();
+}
+
 void UI::set_mode(AppMode new_mode) {
     mode = new_mode;
     selection_index = 0;
     scroll_offset = 0;
+    reset_list_filter();
+    if (mode != AppMode::SEARCH_RESULTS) search_job.reset();
     
-    if (mode == AppMode::PLAYLIST_BROWSER) {
+    if (mode == AppMode::LIBRARY_BROWSER) {
+        ensure_library_loaded();
+    } else if (mode == AppMode::PLAYLIST_BROWSER) {
         update_preview_songs();
+    } else if (mode == AppMode::HISTORY_VIEW) {
+        refresh_history();
     }
     
+    invalidate_chrome(); // clear() wipes every frame along with the screen
     clear();
     refresh();
 }
 
-void UI::run() {
-    int height, width;
-    getmaxyx(stdscr, height, width);
-
-    // Layout calculation
-    int help_h = 3;
-    int status_h = 5;
-    int main_h = height - status_h - help_h;
+UI::Layout UI::compute_layout(int height, int width) {
+    Layout next;
+    next.height = height;
+    next.width = width;
+    next.help_h = 3;
+    next.status_h = 5;
+    next.main_h = height - next.status_h - next.help_h;
     
     // Split main area: Top 40% for visualizer, Bottom 60% for lyrics
-    int viz_h = static_cast<int>(main_h * 0.4);
-    int lyrics_h = main_h - viz_h;
+    next.viz_h = static_cast<int>(next.main_h * 0.4);
+    next.lyrics_h = next.main_h - next.viz_h;
+    return next;
+}
+
+void UI::place_window(WINDOW* win, int height, int width, int starty) {
+    if (getmaxy(win) == height && getmaxx(win) == width && getbegy(win) == starty) return;
+    // Shrink before moving down so the window never hangs off the screen
+    if (getmaxy(win) > height || getmaxx(win) > width) wresize(win, height, width);
+    mvwin(win, starty, 0);
+    wresize(win, height, width);
+    chrome.erase(win);
+    touchwin(win);
+}
+
+void UI::poll_resize() {
+    auto now = std::chrono::steady_clock::now();
+    if (winch_received) {
+        winch_received = 0;
+        if (!resize_pending) resize_first = now;
+        resize_pending = true;
+        resize_last = now;
+        timeout(static_cast<int>(RESIZE_SETTLE.count()));
+    }
+    if (!resize_pending) return;
+    if (now - resize_last < RESIZE_SETTLE && now - resize_first < RESIZE_MAX_DELAY) return;
+    
+    resize_pending = false;
+    timeout(100);
+    struct winsize size;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) != 0 || size.ws_row == 0 || size.ws_col == 0) return;
+    if (size.ws_row == layout.height && size.ws_col == layout.width) return;
+    
+    resizeterm(size.ws_row, size.ws_col);
+    const Layout next = compute_layout(size.ws_row, size.ws_col);
+    
+    // Windows higher up first, so the ones below always have room to move into
+    place_window(visualizer_win, next.viz_h, next.width, 0);
+    place_window(main_win, next.main_h, next.width, 0);
+    place_window(lyrics_win, next.lyrics_h, next.width, next.viz_h);
+    place_window(status_win, next.status_h, next.width, next.main_h);
+    place_window(help_win, next.help_h, next.width, next.main_h + next.status_h);
+    layout = next;
+}
 
-    visualizer_win = create_window(viz_h, width, 0, 0); 
-    lyrics_win = create_window(lyrics_h, width, viz_h, 0);
-    main_win = create_window(main_h, width, 0, 0);       // Overlaps, used for other modes
-    status_win = create_window(status_h, width, main_h, 0);
-    help_win = create_window(help_h, width, main_h + status_h, 0);
+void UI::run() {
+    layout = compute_layout(LINES, COLS);
+
+    visualizer_win = create_window(layout.viz_h, layout.width, 0, 0); 
+    lyrics_win = create_window(layout.lyrics_h, layout.width, layout.viz_h, 0);
+    main_win = create_window(layout.main_h, layout.width, 0, 0);       // Overlaps, used for other modes
+    status_win = create_window(layout.status_h, layout.width, layout.main_h, 0);
+    help_win = create_window(layout.help_h, layout.width, layout.main_h + layout.status_h, 0);
 
     while (running) {
-        // Check for resize (simple handling)
-        int new_h, new_w;
-        getmaxyx(stdscr, new_h, new_w);
-        if (new_h != height || new_w != width) {
-            height = new_h;
-            width = new_w;
-            main_h = height - status_h - help_h;
-            int viz_h = static_cast<int>(main_h * 0.4);
-            int lyrics_h = main_h - viz_h;
-            
-            wresize(visualizer_win, viz_h, width);
-            wresize(lyrics_win, lyrics_h, width);
-            mvwin(lyrics_win, viz_h, 0);
-            
-            wresize(main_win, main_h, width);
-            wresize(status_win, status_h, width);
-            mvwin(status_win, main_h, 0);
-            wresize(help_win, help_h, width);
-            mvwin(help_win, height - help_h, 0);
-            clear();
-            refresh();
-        }
+        poll_resize();
 
+        auto frame_start = std::chrono::steady_clock::now();
         draw();
+        if (frame_stats && frame_times.size() < 1000000) {
+            frame_times.push_back(std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - frame_start).count());
+        }
+        if (first_frame_ms < 0) {
+            first_frame_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startup_time).count();
+        }
+        if (session_pending) apply_session();
+        publish_events();
+        poll_startup_queue();
+        poll_search();
+        poll_lyrics();
         handle_input();
+        player.flush_seek();
+        
+        process_player_events();
+        if (std::chrono::steady_clock::now() - session_saved_at >= SESSION_SAVE_INTERVAL) save_session();
+    }
+    save_session();
+}
+
+void UI::ensure_library_loaded() {
+    if (library_loaded) return;
+    // With several roots the browser starts on the list of them
+    open_library_path(library.get_roots().size() > 1 ? "" : library.get_root());
+    library_loaded = true;
+}
+
+void UI::open_library_path(const std::string& path) {
+    current_path = path;
+    find_query.clear();
+    if (path.empty()) library_items.open_roots(library.get_roots());
+    else library_items.open(path);
+    selection_index = 0;
+    scroll_offset = 0;
+    reset_list_filter();
+}
+
+void UI::set_startup_time(std::chrono::steady_clock::time_point time) {
+    startup_time = time;
+}
+
+void UI::queue_startup_inputs(const std::vector<std::string>& inputs) {
+    for (const auto& input : inputs) {
+        StartupItem item;
+        item.input = input;
+        std::string cached = is_url(input) ? audio_cache.lookup(input) : "";
+        if (!cached.empty()) {
+            item.local_path = cached;
+        } else if (is_url(input)) {
+            // A detached worker per URL; the promise keeps a quit from waiting on yt-dlp
+            auto promise = std::make_shared<std::promise<std::string>>();
+            item.stream_url = promise->get_future();
+            std::thread([promise, input]() {
+                try {
+                    promise->set_value(get_youtube_stream_url(input));
+                } catch (...) {
+                    promise->set_exception(std::current_exception());
+                }
+            }).detach();
+        } else if (fs::exists(input)) {
+            item.local_path = input;
+        } else {
+            show_message("Not Found: " + input);
+            continue;
+        }
+        startup_queue.push_back(std::move(item));
+    }
+}
+
+void UI::poll_startup_queue() {
+    // Items are handed to mpv strictly in argument order, each as soon as it is ready
+    while (startup_next < startup_queue.size()) {
+        StartupItem& item = startup_queue[startup_next];
+        std::string url_to_play = item.local_path;
+        if (item.stream_url.valid()) {
+            if (item.stream_url.wait_for(std::chrono::seconds(0)) != std::future_status::ready) break;
+            try {
+                url_to_play = item.stream_url.get();
+            } catch (const std::exception& e) {
+                show_message("Failed: " + item.input);
+                startup_next++;
+                continue;
+            }
+        }
         
-        // Autoplay check
-        if (autoplay_enabled && player.is_idle() && playing_index != -1) {
-            play_next();
+        try {
+            if (!startup_playing) {
+                prepare_track(item.local_path.empty() ? item.input : item.local_path, item.local_path);
+                player.load(url_to_play, "replace");
+                player.play();
+                last_played_path = url_to_play;
+                startup_playing = true;
+            } else {
+                player.load(url_to_play, "append-play");
+            }
+        } catch (const std::exception& e) {
+            show_message("Load Error: " + std::string(e.what()));
         }
+        startup_next++;
+    }
+    
+    if (startup_playing && first_audio_ms < 0 && player.get_position() > 0) {
+        first_audio_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startup_time).count();
     }
 }
 
@@ -153,10 +397,13 @@ void UI::draw() {
         draw_playlist_select_for_add(); // Reuse same drawing logic, maybe change title in draw func?
     } else if (mode == AppMode::LYRICS_VIEW) {
         draw_lyrics();
+    } else if (mode == AppMode::HISTORY_VIEW) {
+        draw_history();
     }
     
     update_status();
     update_help();
+    if (prompt.open) draw_prompt();
     doupdate();
 }
 
@@ -166,7 +413,7 @@ void UI::draw_playback() {
 }
 
 void UI::update_visualizer() {
-    werase(visualizer_win);
+    erase_interior(visualizer_win);
     draw_borders(visualizer_win, "VISUALIZER");
     
     int height, width;
@@ -184,9 +431,19 @@ void UI::update_visualizer() {
     // Symmetric Visualizer Logic
     // We calculate half the bars and mirror them
     int half_bars = num_bars / 2;
+    bool active = player.is_playing() && !player.is_paused() && !player.is_idle();
+    
+    // Once the track's beats are known, onsets kick the bars up and they fall
+    // back between beats; until then (and for uncached streams) they wander
+    bool beat_driven = active && beats.ready();
+    float pulse = beat_driven ? beats.pulse(player.get_position()) : 0.0f;
     
     for (int i = 0; i < half_bars; ++i) {
-        if (player.is_playing() && !player.is_paused() && !player.is_idle()) {
+        if (beat_driven) {
+            int kick = static_cast<int>(pulse * (draw_h - 1) * (0.6f + 0.4f * (rand() % 100) / 100.0f));
+            if (kick > bars[i]) bars[i] = kick;
+            else if (bars[i] > 0) bars[i]--;
+        } else if (active) {
             int max_h = draw_h;
             int target = rand() % max_h;
             
@@ -206,7 +463,11 @@ void UI::update_visualizer() {
     // Center bar (if odd)
     if (num_bars % 2 != 0) {
         int center = num_bars / 2;
-        if (player.is_playing() && !player.is_paused() && !player.is_idle()) {
+        if (beat_driven) {
+             int kick = static_cast<int>(pulse * (draw_h - 1));
+             if (kick > bars[center]) bars[center] = kick;
+             else if (bars[center] > 0) bars[center]--;
+        } else if (active) {
              int target = rand() % draw_h;
              if (bars[center] < target) bars[center] += 1;
              else if (bars[center] > target) bars[center] -= 1;
@@ -215,7 +476,8 @@ void UI::update_visualizer() {
         }
     }
     
-    wattron(visualizer_win, COLOR_PAIR(3) | A_BOLD);
+    chtype bar = glyph(glyphs->bar);
+    wattron(visualizer_win, style(ROLE_VISUALIZER) | A_BOLD);
     for (int i = 0; i < num_bars; ++i) {
         int bar_height = bars[i];
         
@@ -226,17 +488,17 @@ void UI::update_visualizer() {
                  // Use block characters for cleaner look if terminal supports, 
                  // but for ncurses safety stick to simple chars or ACS
                  // ACS_BLOCK is often solid
-                 mvwaddch(visualizer_win, draw_y, (i * bar_width) + 1 + k, ACS_CKBOARD); 
+                 mvwaddch(visualizer_win, draw_y, (i * bar_width) + 1 + k, bar);
             }
         }
     }
-    wattroff(visualizer_win, COLOR_PAIR(3) | A_BOLD);
+    wattroff(visualizer_win, style(ROLE_VISUALIZER) | A_BOLD);
     
     wnoutrefresh(visualizer_win);
 }
 
 void UI::draw_playlist_select_for_add() {
-    werase(main_win);
+    erase_interior(main_win);
     std::string title = (mode == AppMode::PLAYLIST_SELECT_FOR_MOVE) ? "MOVE SONG TO..." : "SELECT PLAYLIST TO ADD TO";
     draw_borders(main_win, title);
     
@@ -255,14 +517,14 @@ void UI::draw_playlist_select_for_add() {
             int y = i + 2;
             if (y >= height - 2) break;
             
-            if (i == selection_index) wattron(main_win, COLOR_PAIR(6));
+            if (i == selection_index) wattron(main_win, style(ROLE_SELECTED));
             
             std::string name = playlists[i].name;
             if (name.length() > 20) name = name.substr(0, 17) + "...";
             
             mvwprintw(main_win, y, 2, "%-20s %10d", name.c_str(), playlists[i].song_count);
             
-            if (i == selection_index) wattroff(main_win, COLOR_PAIR(6));
+            if (i == selection_index) wattroff(main_win, style(ROLE_SELECTED));
         }
     }
     
@@ -271,38 +533,182 @@ void UI::draw_playlist_select_for_add() {
     wnoutrefresh(main_win);
 }
 
+void UI::keep_selection_visible(int count, int rows) {
+    if (selection_index >= count) selection_index = std::max(0, count - 1);
+    if (selection_index < scroll_offset) scroll_offset = selection_index;
+    if (rows > 0 && selection_index >= scroll_offset + rows) scroll_offset = selection_index - rows + 1;
+    if (scroll_offset < 0) scroll_offset = 0;
+}
+
+bool UI::move_selection(int ch, int count) {
+    int page = 10;
+    if (main_win) page = std::max(1, getmaxy(main_win) - 3);
+    switch (ch) {
+        case KEY_UP: selection_index--; break;
+        case KEY_DOWN: selection_index++; break;
+        case KEY_PPAGE: selection_index -= page; break;
+        case KEY_NPAGE: selection_index += page; break;
+        case KEY_HOME: selection_index = 0; break;
+        case KEY_END: selection_index = count - 1; break;
+        default: return false;
+    }
+    selection_index = std::max(0, std::min(selection_index, count - 1));
+    return true;
+}
+
+void UI::sync_list_filter() {
+    // The key changes whenever the list behind the view does
+    uint64_t key = 1469598103934665603ULL ^ static_cast<uint64_t>(mode);
+    auto mix = [&key](uint64_t value) { key = (key ^ value) * 1099511628211ULL; };
+    
+    if (mode == AppMode::LIBRARY_BROWSER) {
+        mix(hash_string(current_path));
+        mix(hash_string(find_query));
+        mix(library_items.version());
+        mix(library_items.size());
+        list_filter.sync(key, library_items.size(), [this](size_t i) { return library_items[i].name(); });
+    } else if (mode == AppMode::HISTORY_VIEW) {
+        mix(list_version);
+        list_filter.sync(key, history_items.size(), [this](size_t i) { return history_items[i].title.c_str(); });
+    } else {
+        const std::vector<TrackRef>& songs = mode == AppMode::SEARCH_RESULTS ? search_results : current_playlist_songs;
+        mix(list_version);
+        list_filter.sync(key, songs.size(), [&songs](size_t i) { return songs[i].title(); });
+    }
+}
+
+void UI::reset_list_filter() {
+    list_filter.clear();
+    filter_editing = false;
+    typeahead.clear();
+}
+
+int UI::list_size() {
+    if (list_filter.active()) {
+        sync_list_filter();
+        return static_cast<int>(list_filter.size());
+    }
+    if (mode == AppMode::LIBRARY_BROWSER) return static_cast<int>(library_items.size());
+    if (mode == AppMode::SEARCH_RESULTS) return static_cast<int>(search_results.size());
+    if (mode == AppMode::HISTORY_VIEW) return static_cast<int>(history_items.size());
+    return static_cast<int>(current_playlist_songs.size());
+}
+
+int UI::list_row(int visible) {
+    return list_filter.active() ? static_cast<int>(list_filter.row(visible)) : visible;
+}
+
+std::string UI::filter_label() {
+    if (!filter_editing && !list_filter.active()) return "";
+    return "  /" + list_filter.query() + (filter_editing ? "_" : "");
+}
+
+bool UI::handle_list_keys(int ch) {
+    if (filter_editing) {
+        std::string query = list_filter.query();
+        if (ch == 27) {
+            reset_list_filter();
+        } else if (ch == 10) {
+            filter_editing = false; // Keep the filter, back to navigating it
+        } else if (ch == KEY_BACKSPACE || ch == 127) {
+            if (query.empty()) {
+                filter_editing = false;
+            } else {
+                query.pop_back();
+                list_filter.set_query(query);
+            }
+        } else if (ch >= 32 && ch < 127) {
+            sync_list_filter();
+            list_filter.set_query(query + static_cast<char>(ch));
+        } else {
+            return move_selection(ch, list_size());
+        }
+        selection_index = 0;
+        scroll_offset = 0;
+        return true;
+    }
+    
+    if (ch == '/') {
+        sync_list_filter();
+        filter_editing = true;
+        return true;
+    }
+    if (ch == 27 && list_filter.active()) {
+        // First ESC drops the filter, the next one leaves the view
+        int row = list_row(selection_index);
+        reset_list_filter();
+        selection_index = row;
+        return true;
+    }
+    if (move_selection(ch, list_size())) return true;
+    
+    // Type-ahead: letters and digits jump to the next row starting with what was typed
+    if (mode == AppMode::LIBRARY_BROWSER && ch < 127 && isalnum(ch)) {
+        auto now = std::chrono::steady_clock::now();
+        if (now - typeahead_at > std::chrono::seconds(1)) typeahead.clear();
+        typeahead_at = now;
+        typeahead += static_cast<char>(ch);
+        
+        sync_list_filter();
+        // A fresh prefix moves past the current row, a longer one may stay on it
+        size_t from = selection_index + (typeahead.size() == 1 ? 1 : 0);
+        size_t hit = list_filter.find_prefix(typeahead, from);
+        if (hit != ListFilter::NOT_FOUND) selection_index = static_cast<int>(hit);
+        return true;
+    }
+    return false;
+}
+
 void UI::draw_library() {
-    werase(main_win);
-    draw_borders(main_win, "LIBRARY: " + current_path);
+    erase_interior(main_win);
+    int count = list_size();
+    std::string scanning = library_items.loading() ? " (scanning " + std::to_string(library_items.size()) + "...)" : "";
+    std::string where = !find_query.empty() ? ": find \"" + find_query + "\"" : current_path.empty() ? "" : ": " + current_path;
+    draw_borders(main_win, "LIBRARY" + where + scanning + filter_label());
     
     int height, width;
     getmaxyx(main_win, height, width);
     int list_h = height - 2;
     
-    for (int i = 0; i < list_h && (i + scroll_offset) < library_items.size(); ++i) {
+    // The scan published more rows; follow the selected entry to its new place
+    if (library_items.version() != library_version) {
+        library_version = library_items.version();
+        if (selection_index > 0 && !list_filter.active()) selection_index = library_items.index_of(library_selected);
+    }
+    keep_selection_visible(count, list_h);
+    if (count > 0) library_selected = library_items[list_row(selection_index)].name_id;
+    
+    // Only the rows on screen, and 16 either side, are ever probed
+    std::vector<size_t> probe_rows;
+    for (int i = std::max(0, scroll_offset - 16); i < count && i < scroll_offset + list_h + 16; ++i) {
+        probe_rows.push_back(list_row(i));
+    }
+    library_items.probe_durations(probe_rows);
+    
+    for (int i = 0; i < list_h && (i + scroll_offset) < count; ++i) {
         int idx = i + scroll_offset;
-        const auto& item = library_items[idx];
+        LibraryItem item = library_items[list_row(idx)];
         
         if (idx == selection_index) {
-            wattron(main_win, COLOR_PAIR(6));
+            wattron(main_win, style(ROLE_SELECTED));
         }
         
-        std::string display_name = (item.is_directory ? "[DIR] " : "      ") + item.name;
-        if (!item.is_directory && !item.duration.empty()) {
-            display_name += " (" + item.duration + ")";
+        std::string display_name = std::string(item.is_directory ? "[DIR] " : "      ") + item.name();
+        if (!item.is_directory && item.duration > 0) {
+            display_name += " (" + format_duration(item.duration) + ")";
         }
         if (display_name.length() > width - 4) display_name = display_name.substr(0, width - 4);
         mvwprintw(main_win, i + 1, 2, "%s", display_name.c_str());
         
         if (idx == selection_index) {
-            wattroff(main_win, COLOR_PAIR(6));
+            wattroff(main_win, style(ROLE_SELECTED));
         }
     }
     wnoutrefresh(main_win);
 }
 
 void UI::draw_search_input() {
-    werase(main_win);
+    erase_interior(main_win);
     draw_borders(main_win, "SEARCH YOUTUBE");
     
     int height, width;
@@ -323,26 +729,26 @@ void UI::draw_search_input() {
     
     mvwprintw(main_win, box_y, box_x - 2, "> ");
     
-    wattron(main_win, COLOR_PAIR(6)); // Highlight background for input
+    wattron(main_win, style(ROLE_SELECTED)); // Highlight background for input
     mvwhline(main_win, box_y, box_x, ' ', box_width);
     mvwprintw(main_win, box_y, box_x, "%s", search_query.c_str());
     if (search_query.length() < box_width) {
         waddch(main_win, '_'); // Cursor
     }
-    wattroff(main_win, COLOR_PAIR(6));
+    wattroff(main_win, style(ROLE_SELECTED));
     
     wnoutrefresh(main_win);
 }
 
 void UI::draw_search_results() {
-    werase(main_win);
-    draw_borders(main_win, "SEARCH RESULTS");
+    erase_interior(main_win);
+    draw_borders(main_win, std::string(search_job ? "SEARCHING..." : "SEARCH RESULTS") + filter_label());
     
     int height, width;
     getmaxyx(main_win, height, width);
     
     if (search_results.empty()) {
-        std::string msg = "Searching...";
+        std::string msg = search_job ? "Searching..." : "No results.";
         mvwprintw(main_win, height/2, (width - msg.length())/2, "%s", msg.c_str());
     } else {
         // Header
@@ -350,18 +756,21 @@ void UI::draw_search_results() {
         mvwprintw(main_win, 1, 2, "%-4s %-50s %10s", "#", "Title", "Duration");
         wattroff(main_win, A_BOLD | A_UNDERLINE);
         
-        for (int i = 0; i < search_results.size(); ++i) {
-            int y = i + 2;
+        int count = list_size();
+        keep_selection_visible(count, height - 3);
+        for (int i = scroll_offset; i < count; ++i) {
+            int y = i - scroll_offset + 2;
             if (y >= height - 1) break;
             
-            if (i == selection_index) wattron(main_win, COLOR_PAIR(6));
+            if (i == selection_index) wattron(main_win, style(ROLE_SELECTED));
             
-            std::string title = search_results[i].title;
+            const SearchResult& result = search_results[list_row(i)];
+            std::string title = result.title();
             if (title.length() > 50) title = title.substr(0, 47) + "...";
             
-            mvwprintw(main_win, y, 2, "%-4d %-50s %10s", i + 1, title.c_str(), search_results[i].duration.c_str());
+            mvwprintw(main_win, y, 2, "%-4d %-50s %10s", list_row(i) + 1, title.c_str(), duration_label(result.duration()).c_str());
             
-            if (i == selection_index) wattroff(main_win, COLOR_PAIR(6));
+            if (i == selection_index) wattroff(main_win, style(ROLE_SELECTED));
         }
     }
     wnoutrefresh(main_win);
@@ -370,98 +779,111 @@ void UI::draw_search_results() {
 
 
 void UI::update_status() {
-    werase(status_win);
+    refresh_waveform();
+    erase_interior(status_win);
     draw_borders(status_win, "NOW PLAYING");
     
     int height, width;
     getmaxyx(status_win, height, width);
+    (void)height;
     
-    std::string title = player.get_metadata("media-title");
-    if (title.empty()) {
-        std::string filename = player.get_metadata("filename");
-        if (filename.empty()) {
-            title = "Not Playing";
-        } else {
-            title = filename;
+    char title[sizeof(status_line.title)];
+    if (!player.get_metadata_into("media-title", title, sizeof(title)) || title[0] == '\0') {
+        if (!player.get_metadata_into("filename", title, sizeof(title)) || title[0] == '\0') {
+            snprintf(title, sizeof(title), "%s", "Not Playing");
         }
     }
-    
-    // Center Title
-    if (title.length() > width - 4) title = title.substr(0, width - 7) + "...";
-    int title_x = (width - title.length()) / 2;
-    
-    wattron(status_win, COLOR_PAIR(1) | A_BOLD);
-    mvwprintw(status_win, 1, title_x, "%s", title.c_str());
-    wattroff(status_win, COLOR_PAIR(1) | A_BOLD);
-    
-    double pos = player.get_position();
+    double pos = player.get_display_position();
     double dur = player.get_duration();
-    int bar_width = width - 4;
-    
-    if (dur > 0) {
-        int filled = static_cast<int>((pos / dur) * bar_width);
-        mvwprintw(status_win, 2, 2, "[");
-        wattron(status_win, COLOR_PAIR(2));
-        for (int i = 0; i < bar_width - 2; ++i) {
-            waddch(status_win, i < filled ? '=' : ' ');
+    play_history.update(pos, dur);
+    StatusLine& line = status_line;
+    line.update(width, title, pos, dur, waveform, glyphs->wave, glyphs->progress,
+                static_cast<int>(beats.bpm() + 0.5), player.get_volume());
+    
+    wattron(status_win, style(ROLE_BORDER) | A_BOLD);
+    mvwaddstr(status_win, 1, line.title_x, line.title_line);
+    wattroff(status_win, style(ROLE_BORDER) | A_BOLD);
+    
+    if (line.bar[0]) {
+        mvwaddch(status_win, 2, 2, '[');
+        wattron(status_win, style(ROLE_ACTIVE));
+        if (line.bar_wave) {
+            // Played part highlighted, the rest in the background color
+            int split = std::max(0, std::min(static_cast<int>(strlen(line.bar)), line.filled));
+            waddnstr(status_win, line.bar, split);
+            wattroff(status_win, style(ROLE_ACTIVE));
+            wattron(status_win, style(ROLE_BACKGROUND));
+            waddstr(status_win, line.bar + split);
+            wattroff(status_win, style(ROLE_BACKGROUND));
+        } else {
+            waddstr(status_win, line.bar);
+            wattroff(status_win, style(ROLE_ACTIVE));
         }
-        wattroff(status_win, COLOR_PAIR(2));
-        wprintw(status_win, "]");
-        
-        int min_pos = static_cast<int>(pos) / 60;
-        int sec_pos = static_cast<int>(pos) % 60;
-        int min_dur = static_cast<int>(dur) / 60;
-        int sec_dur = static_cast<int>(dur) % 60;
-        
-        mvwprintw(status_win, 3, 2, "%02d:%02d / %02d:%02d", min_pos, sec_pos, min_dur, sec_dur);
+        waddch(status_win, ']');
+        mvwaddstr(status_win, 3, 2, line.time);
     }
     
-    std::string vol_str = "Vol: " + std::to_string(player.get_volume()) + "%";
-    mvwprintw(status_win, 3, width - vol_str.length() - 2, "%s", vol_str.c_str());
+    if (line.bpm[0]) mvwaddstr(status_win, 3, (width - static_cast<int>(strlen(line.bpm))) / 2, line.bpm);
+    mvwaddstr(status_win, 3, width - static_cast<int>(strlen(line.volume)) - 2, line.volume);
+    
     wnoutrefresh(status_win);
 }
 
 void UI::update_help() {
     werase(help_win);
-    auto now = std::chrono::steady_clock::now();
-    if (!message.empty() && std::chrono::duration_cast<std::chrono::seconds>(now - message_time).count() < 3) {
-        wattron(help_win, COLOR_PAIR(4) | A_BOLD);
-        mvwprintw(help_win, 1, 2, "MSG: %s", message.c_str());
-        wattroff(help_win, COLOR_PAIR(4) | A_BOLD);
+    const char* msg = messages.current(std::chrono::steady_clock::now());
+    if (msg) {
+        wattron(help_win, style(ROLE_ALERT) | A_BOLD);
+        mvwaddstr(help_win, 1, 2, "MSG: ");
+        waddstr(help_win, msg);
+        wattroff(help_win, style(ROLE_ALERT) | A_BOLD);
     } else {
-        wattron(help_win, COLOR_PAIR(4));
-        if (mode == AppMode::PLAYBACK) {
-             std::string auto_str = autoplay_enabled ? "ON" : "OFF";
-             mvwprintw(help_win, 1, 2, "[ESC] Quit [SPACE] Pause [Q] Queue [L] Library [S] Search [P] Playlist [R] Replay [O] Autoplay:%s", auto_str.c_str());
+        HelpCache& cache = help_cache;
+        if (!cache.valid || cache.mode != mode || cache.autoplay != autoplay_enabled) {
+            const char* text = "[ENTER] Play [ESC] Back";
+            if (mode == AppMode::PLAYBACK)
+                 text = nullptr;
+            else if (mode == AppMode::LIBRARY_BROWSER)
+                 text = "[ENTER] Select [BKSP] Up [/] Filter [^F] Find [A-Z] Jump [ESC] Back";
+            else if (mode == AppMode::SEARCH_INPUT)
+                 text = "[ENTER] Search [ESC] Cancel";
+            else if (mode == AppMode::SEARCH_RESULTS)
+                 text = "[ENTER] Play [A] Add to Playlist [S] New Search [/] Filter [ESC] Back";
+            else if (mode == AppMode::PLAYLIST_BROWSER)
+                 text = "[ENTER] View [N] New [D] Delete [R] Rename [ESC] Back";
+            else if (mode == AppMode::PLAYLIST_VIEW)
+                 text = "[ENTER] Play [D] Del [M] Move [W] Warm [SHIFT+W] Offline [/] Find [ESC] Back";
+            else if (mode == AppMode::PLAYLIST_SELECT_FOR_ADD)
+                 text = "[ENTER] Select [N] New Playlist [ESC] Cancel";
+            else if (mode == AppMode::LYRICS_VIEW)
+                 text = "[UP/DOWN] Scroll [ESC] Back";
+            else if (mode == AppMode::HISTORY_VIEW)
+                 text = "[ENTER] Play [R] Resume [TAB] Recent/Most Played [/] Filter [ESC] Back";
+            else if (mode == AppMode::INTRO)
+                 text = "Welcome! Press [ENTER] to browse library.";
+            
+            if (text) {
+                snprintf(cache.text, sizeof(cache.text), "%s", text);
+            } else {
+                snprintf(cache.text, sizeof(cache.text),
+                         "[ESC] Quit [SPACE] Pause [N/B] Next/Prev [H] Shuffle [T] Repeat [Q] Queue [L] Library [S] Search [P] Playlist [Y] History [R] Replay [O] Autoplay:%s",
+                         autoplay_enabled ? "ON" : "OFF");
+            }
+            cache.mode = mode;
+            cache.autoplay = autoplay_enabled;
+            cache.valid = true;
         }
-        else if (mode == AppMode::LIBRARY_BROWSER)
-             mvwprintw(help_win, 1, 2, "[ENTER] Select [BKSP] Up [ESC] Back");
-        else if (mode == AppMode::SEARCH_INPUT)
-             mvwprintw(help_win, 1, 2, "[ENTER] Search [ESC] Cancel");
-        else if (mode == AppMode::SEARCH_RESULTS)
-             mvwprintw(help_win, 1, 2, "[ENTER] Play [A] Add to Playlist [S] New Search [ESC] Back");
-        else if (mode == AppMode::PLAYLIST_BROWSER)
-             mvwprintw(help_win, 1, 2, "[ENTER] View [N] New [D] Delete [R] Rename [ESC] Back");
-        else if (mode == AppMode::PLAYLIST_VIEW)
-             mvwprintw(help_win, 1, 2, "[ENTER] Play [D] Remove [M] Move [ESC] Back");
-        else if (mode == AppMode::PLAYLIST_SELECT_FOR_ADD)
-             mvwprintw(help_win, 1, 2, "[ENTER] Select [N] New Playlist [ESC] Cancel");
-        else if (mode == AppMode::LYRICS_VIEW)
-             mvwprintw(help_win, 1, 2, "[UP/DOWN] Scroll [ESC] Back");
-        else
-             mvwprintw(help_win, 1, 2, "[ENTER] Play [ESC] Back");
         
-        if (mode == AppMode::INTRO)
-             mvwprintw(help_win, 1, 2, "Welcome! Press [ENTER] to browse library.");
-        wattroff(help_win, COLOR_PAIR(4));
+        wattron(help_win, style(ROLE_ALERT));
+        mvwaddstr(help_win, 1, 2, cache.text);
+        wattroff(help_win, style(ROLE_ALERT));
     }
     wnoutrefresh(help_win);
 }
 
 void UI::show_message(const std::string& msg) {
-    message = msg;
-    message_time = std::chrono::steady_clock::now();
-    update_help();
+    messages.push(msg);
+    if (help_win) update_help();
 }
 
 void UI::handle_input() {
@@ -469,7 +891,8 @@ void UI::handle_input() {
     if (ch == ERR) return;
 
     try {
-        if (mode == AppMode::PLAYBACK) handle_playback_input(ch);
+        if (prompt.open) handle_prompt_input(ch);
+        else if (mode == AppMode::PLAYBACK) handle_playback_input(ch);
         else if (mode == AppMode::LIBRARY_BROWSER) handle_library_input(ch);
         else if (mode == AppMode::SEARCH_INPUT) handle_search_input_input(ch);
         else if (mode == AppMode::SEARCH_RESULTS) handle_search_results_input(ch);
@@ -478,6 +901,7 @@ void UI::handle_input() {
         else if (mode == AppMode::PLAYLIST_SELECT_FOR_ADD) handle_playlist_select_for_add_input(ch);
         else if (mode == AppMode::PLAYLIST_SELECT_FOR_MOVE) handle_playlist_select_for_move_input(ch);
         else if (mode == AppMode::LYRICS_VIEW) handle_lyrics_input(ch);
+        else if (mode == AppMode::HISTORY_VIEW) handle_history_input(ch);
         else if (mode == AppMode::INTRO) handle_intro_input(ch);
     } catch (const std::exception& e) {
         show_message(std::string("Error: ") + e.what());
@@ -495,6 +919,7 @@ void UI::handle_playback_input(int ch) {
             if (!playing_playlist_name.empty()) {
                 current_playlist_name = playing_playlist_name;
                 current_playlist_songs = playlist_manager.get_playlist_songs(current_playlist_name);
+                list_version++;
                 selection_index = 0; // Or try to find the current song index?
                 set_mode(AppMode::PLAYLIST_VIEW);
             } else if (!search_results.empty()) {
@@ -504,14 +929,52 @@ void UI::handle_playback_input(int ch) {
             }
             break;
         case 'r': case 'R': 
-            if (!last_played_path.empty()) {
+            if (queue_source != QueueSource::NONE && play_queue.current() != -1) {
+                play_queue_track(play_queue.current());
+                show_message("Replaying...");
+            } else if (!last_played_path.empty()) {
+                stop_recording();
                 player.load(last_played_path);
                 player.play();
                 show_message("Replaying...");
             }
             break;
-        case KEY_LEFT: player.seek(-5.0); break;
-        case KEY_RIGHT: player.seek(5.0); break;
+        case 'n': case 'N': case 'b': case 'B': {
+            bool back = ch == 'b' || ch == 'B';
+            if (queue_source == QueueSource::NONE) {
+                show_message("Nothing queued.");
+                break;
+            }
+            int index = back ? play_queue.previous() : play_queue.skip();
+            if (index == -1) show_message(back ? "Start of queue." : "End of queue.");
+            else play_queue_track(index);
+            break;
+        }
+        case 'h': case 'H':
+            play_queue.set_shuffle(!play_queue.shuffle());
+            queue_upcoming();
+            show_message(std::string("Shuffle: ") + (play_queue.shuffle() ? "ON" : "OFF"));
+            break;
+        case 't': case 'T': {
+            static const char* names[] = {"OFF", "ALL", "ONE"};
+            RepeatMode repeat = play_queue.repeat() == RepeatMode::OFF ? RepeatMode::ALL :
+                                play_queue.repeat() == RepeatMode::ALL ? RepeatMode::ONE : RepeatMode::OFF;
+            play_queue.set_repeat(repeat);
+            queue_upcoming();
+            show_message(std::string("Repeat: ") + names[static_cast<int>(repeat)]);
+            break;
+        }
+        // Held keys pile up into one target that goes to mpv once per frame
+        case KEY_LEFT: player.seek(-5.0, SeekMode::RELATIVE, SeekPrecision::EXACT); recording_seeked = true; break;
+        case KEY_RIGHT: player.seek(5.0, SeekMode::RELATIVE, SeekPrecision::EXACT); recording_seeked = true; break;
+        case KEY_SLEFT: player.seek(-30.0); recording_seeked = true; break;
+        case KEY_SRIGHT: player.seek(30.0); recording_seeked = true; break;
+        case '0': case '1': case '2': case '3': case '4':
+        case '5': case '6': case '7': case '8': case '9':
+            player.seek((ch - '0') * 10.0, SeekMode::PERCENT);
+            recording_seeked = true;
+            break;
+        case 'c': case 'C': show_message(audio_cache.stats()); break;
         case '+': case '=': player.set_volume(player.get_volume() + 5); break;
         case '-': case '_': player.set_volume(player.get_volume() - 5); break;
         case 'o': case 'O': 
@@ -522,6 +985,7 @@ void UI::handle_playback_input(int ch) {
             playlists = playlist_manager.list_playlists();
             set_mode(AppMode::PLAYLIST_BROWSER);
             break;
+        case 'y': case 'Y': set_mode(AppMode::HISTORY_VIEW); break;
 
         case KEY_UP: 
             if (lyrics_scroll_offset > 0) lyrics_scroll_offset--; 
@@ -535,63 +999,84 @@ void UI::handle_playback_input(int ch) {
 }
 
 void UI::handle_library_input(int ch) {
+    if (handle_list_keys(ch)) return;
     switch (ch) {
         case 27: set_mode(AppMode::PLAYBACK); break; 
-        case KEY_UP: 
-            if (selection_index > 0) {
-                selection_index--;
-                if (selection_index < scroll_offset) scroll_offset = selection_index;
-            }
-            break;
-        case KEY_DOWN:
-            if (selection_index < library_items.size() - 1) {
-                selection_index++;
-                int height, w; 
-                getmaxyx(main_win, height, w);
-                if (selection_index >= scroll_offset + height - 2) scroll_offset++;
+        case KEY_BACKSPACE:
+        case 127: {
+            const auto& roots = library.get_roots();
+            if (!find_query.empty()) {
+                open_library_path(find_from);
+            } else if (roots.size() > 1 && std::find(roots.begin(), roots.end(), current_path) != roots.end()) {
+                open_library_path("");
+            } else if (!current_path.empty() && current_path != "/") {
+                open_library_path(fs::path(current_path).parent_path().string());
             }
             break;
-        case KEY_BACKSPACE:
-        case 127:
-            if (current_path != "/") {
-                current_path = fs::path(current_path).parent_path().string();
-                library_items = library.list_directory(current_path);
+        }
+        case 6: // Ctrl+F
+            open_prompt("Find in Library", [this](const std::string& query) {
+                if (query.empty()) return;
+                std::string from = find_query.empty() ? current_path : find_from;
+                current_path.clear();
+                library_items.open_find(library.get_roots(), query);
                 selection_index = 0; scroll_offset = 0;
-            }
+                reset_list_filter();
+                find_query = query;
+                find_from = from;
+            });
             break;
         case 10: // Enter
-            if (library_items.empty()) break;
-            auto& item = library_items[selection_index];
+            if (list_size() == 0) break;
+            LibraryItem item = library_items[list_row(selection_index)];
             if (item.is_directory) {
-                current_path = item.path;
-                library_items = library.list_directory(current_path);
-                selection_index = 0; scroll_offset = 0;
+                open_library_path(item.path());
             } else {
-                player.stop(); // Stop current playback
-                fetch_current_lyrics(item.path); // Fetch BEFORE loading/playing
-                player.load(item.path);
-                last_played_path = item.path;
-                player.set_property("force-media-title", item.path); 
-                player.play();
+                play_local_queue(list_row(selection_index));
                 set_mode(AppMode::PLAYBACK);
             }
             break;
     }
 }
 
+void UI::publish_events() {
+    events.poll();
+    if (!events.has_subscribers()) return;
+    
+    // Everything here was read by update_status this frame; no extra mpv calls
+    const StatusLine& cache = status_line;
+    events.track(cache.title, cache.duration);
+    if (events.position_due()) events.position(cache.position, cache.duration);
+    
+    const auto& lines = current_lyrics_data.synced_lyrics;
+    if (current_lyrics_data.has_synced && !lines.empty()) {
+        auto after = std::upper_bound(lines.begin(), lines.end(), cache.position,
+                                      [](double t, const LyricLine& line) { return t < line.timestamp; });
+        int index = static_cast<int>(after - lines.begin()) - 1;
+        if (index >= 0) events.lyric(index, lines[index].text);
+    }
+}
+
+void UI::poll_search() {
+    if (!search_job) return;
+    size_t had = search_results.size();
+    bool running = search_job->poll(search_results);
+    if (search_results.size() != had) list_version++;
+    if (running) return;
+    if (search_job->failed()) show_message("Search failed.");
+    else if (search_results.empty()) show_message("No results found.");
+    search_job.reset();
+}
+
 void UI::handle_search_input_input(int ch) {
     if (ch == 27) {
         set_mode(AppMode::PLAYBACK);
     } else if (ch == 10) { // Enter
+        // Results fill in as yt-dlp prints them; leaving the view cancels the search
         set_mode(AppMode::SEARCH_RESULTS);
-        show_message("Searching...");
-        draw(); // Force draw to show "Searching..."
-        try {
-            search_results = search_youtube(search_query);
-            if (search_results.empty()) show_message("No results found.");
-        } catch (const std::exception& e) {
-            show_message("Search failed.");
-        }
+        search_results.clear();
+        list_version++;
+        search_job.reset(new SearchJob(search_query));
     } else if (ch == KEY_BACKSPACE || ch == 127) {
         if (!search_query.empty()) search_query.pop_back();
     } else if (isprint(ch)) {
@@ -600,6 +1085,7 @@ void UI::handle_search_input_input(int ch) {
 }
 
 void UI::handle_search_results_input(int ch) {
+    if (handle_list_keys(ch)) return;
     switch (ch) {
         case 27: set_mode(AppMode::PLAYBACK); break;
         case 's': case 'S':
@@ -607,45 +1093,19 @@ void UI::handle_search_results_input(int ch) {
             selection_index = 0;
             set_mode(AppMode::SEARCH_INPUT);
             break;
-        case KEY_UP: if (selection_index > 0) selection_index--; break;
-        case KEY_DOWN: if (selection_index < search_results.size() - 1) selection_index++; break;
         case 10: // Enter
-            if (!search_results.empty()) {
+            if (list_size() > 0) {
                 show_message("Resolving...");
                 wnoutrefresh(help_win);
                 doupdate(); 
                 
-                try {
-                    player.stop(); // Stop current playback
-                    show_message("Resolving stream...");
-                    wnoutrefresh(help_win);
-                    doupdate();
-                    std::string stream_url = get_youtube_stream_url(search_results[selection_index].url);
-                    
-                    fetch_current_lyrics(search_results[selection_index].title); // Fetch BEFORE loading/playing
-                    
-                    player.load(stream_url);
-                    last_played_path = stream_url;
-                    player.set_property("force-media-title", search_results[selection_index].title);
-                    
-                    // Set autoplay context
-                    
-                    // Set autoplay context
-                    playing_index = selection_index;
-                    is_playing_from_playlist = false;
-                    
-                    player.play();
-                    set_mode(AppMode::PLAYBACK);
-                } catch (const std::exception& e) {
-                    show_message(std::string("Cannot play: ") + e.what());
-                }
+                // The results become the queue, for autoplay, skipping and shuffle
+                if (play_stream_queue(search_results, list_row(selection_index))) set_mode(AppMode::PLAYBACK);
             }
             break;
         case 'a': case 'A':
-            if (!search_results.empty()) {
-                song_to_add.title = search_results[selection_index].title;
-                song_to_add.url = search_results[selection_index].url;
-                song_to_add.duration = search_results[selection_index].duration;
+            if (list_size() > 0) {
+                song_to_add = search_results[list_row(selection_index)];
                 
                 playlists = playlist_manager.list_playlists();
                 // Always allow entering selection mode so user can create new playlist
@@ -661,11 +1121,12 @@ void UI::update_preview_songs() {
         preview_songs.clear();
         return;
     }
-    preview_songs = playlist_manager.get_playlist_songs(playlists[selection_index].name);
+    // The preview never scrolls, so it only needs as many songs as fit on screen
+    preview_songs = playlist_manager.get_playlist_songs(playlists[selection_index].name, LINES);
 }
 
 void UI::draw_playlists() {
-    werase(main_win);
+    erase_interior(main_win);
     draw_borders(main_win, "PLAYLISTS");
     
     int height, width;
@@ -684,10 +1145,10 @@ void UI::draw_playlists() {
 
     // Draw Separator
     for (int i = 1; i < height - 1; ++i) {
-        mvwaddch(main_win, i, list_width, ACS_VLINE);
+        mvwaddch(main_win, i, list_width, glyph(glyphs->vline));
     }
-    mvwaddch(main_win, 0, list_width, ACS_TTEE);
-    mvwaddch(main_win, height - 1, list_width, ACS_BTEE);
+    mvwaddch(main_win, 0, list_width, glyph(glyphs->ttee));
+    mvwaddch(main_win, height - 1, list_width, glyph(glyphs->btee));
 
     // Draw Playlist List (Left Side)
     wattron(main_win, A_BOLD | A_UNDERLINE);
@@ -698,7 +1159,7 @@ void UI::draw_playlists() {
         int y = i + 2;
         if (y >= height - 1) break;
         
-        if (i == selection_index) wattron(main_win, COLOR_PAIR(6));
+        if (i == selection_index) wattron(main_win, style(ROLE_SELECTED));
         
         std::string name = playlists[i].name;
         std::string count_str = " (" + std::to_string(playlists[i].song_count) + ")";
@@ -716,7 +1177,7 @@ void UI::draw_playlists() {
         
         mvwprintw(main_win, y, 2, "%s%s", name.c_str(), count_str.c_str());
         
-        if (i == selection_index) wattroff(main_win, COLOR_PAIR(6));
+        if (i == selection_index) wattroff(main_win, style(ROLE_SELECTED));
     }
 
     // Draw Preview (Right Side)
@@ -742,11 +1203,11 @@ void UI::draw_playlists() {
                 int y = i + 3;
                 if (y >= height - 1) break;
 
-                std::string title = preview_songs[i].title;
+                std::string title = preview_songs[i].title();
                 if (title.length() > max_title_len) title = title.substr(0, max_title_len - 3) + "...";
 
                 mvwprintw(main_win, y, preview_start_x + 2, "%-4d %-*s %10s", 
-                          i + 1, max_title_len, title.c_str(), preview_songs[i].duration.c_str());
+                          i + 1, max_title_len, title.c_str(), duration_label(preview_songs[i].duration()).c_str());
             }
         }
     }
@@ -755,8 +1216,8 @@ void UI::draw_playlists() {
 }
 
 void UI::draw_playlist_view() {
-    werase(main_win);
-    draw_borders(main_win, "PLAYLIST: " + current_playlist_name);
+    erase_interior(main_win);
+    draw_borders(main_win, "PLAYLIST: " + current_playlist_name + filter_label());
     
     int height, width;
     getmaxyx(main_win, height, width);
@@ -764,26 +1225,95 @@ void UI::draw_playlist_view() {
     if (current_playlist_songs.empty()) {
         mvwprintw(main_win, height/2, 2, "Playlist is empty.");
     } else {
-        int max_title_len = width - 20; // Adjust for index (4+1) and duration (1+10) + padding
+        int max_title_len = width - 22; // Adjust for warm state (2), index (4+1) and duration (1+10) + padding
         if (max_title_len < 10) max_title_len = 10;
 
         // Header
         wattron(main_win, A_BOLD | A_UNDERLINE);
-        mvwprintw(main_win, 1, 2, "%-4s %-*s %10s", "#", max_title_len, "Title", "Duration");
+        mvwprintw(main_win, 1, 2, "  %-4s %-*s %10s", "#", max_title_len, "Title", "Duration");
         wattroff(main_win, A_BOLD | A_UNDERLINE);
         
-        for (int i = 0; i < current_playlist_songs.size(); ++i) {
-            int y = i + 2;
+        // Only the visible window is formatted, however long the playlist is
+        int count = list_size();
+        keep_selection_visible(count, height - 3);
+        for (int i = scroll_offset; i < count; ++i) {
+            int y = i - scroll_offset + 2;
             if (y >= height - 1) break;
             
-            if (i == selection_index) wattron(main_win, COLOR_PAIR(6));
+            if (i == selection_index) wattron(main_win, style(ROLE_SELECTED));
             
-            std::string title = current_playlist_songs[i].title;
+            int row = list_row(i);
+            const PlaylistSong& song = current_playlist_songs[row];
+            std::string title = song.title();
             if (title.length() > max_title_len) title = title.substr(0, max_title_len - 3) + "...";
             
-            mvwprintw(main_win, y, 2, "%-4d %-*s %10s", i + 1, max_title_len, title.c_str(), current_playlist_songs[i].duration.c_str());
+            // Warm progress: . queued, ~ resolving, + ready, v downloading, * offline, ! failed
+            char state = ' ';
+            switch (playlist_warmer.get_state(song.url())) {
+                case WarmState::QUEUED: state = '.'; break;
+                case WarmState::RESOLVING: state = '~'; break;
+                case WarmState::RESOLVED: state = '+'; break;
+                case WarmState::DOWNLOADING: state = 'v'; break;
+                case WarmState::CACHED: state = '*'; break;
+                case WarmState::FAILED: state = '!'; break;
+                default: break;
+            }
+            
+            mvwprintw(main_win, y, 2, "%c %-4d %-*s %10s", state, row + 1, max_title_len, title.c_str(), duration_label(song.duration()).c_str());
             
-            if (i == selection_index) wattroff(main_win, COLOR_PAIR(6));
+            if (i == selection_index) wattroff(main_win, style(ROLE_SELECTED));
+        }
+    }
+    wnoutrefresh(main_win);
+}
+
+void UI::draw_history() {
+    erase_interior(main_win);
+    draw_borders(main_win, std::string(history_most_played ? "HISTORY: MOST PLAYED" : "HISTORY: RECENT") + filter_label());
+    
+    int height, width;
+    getmaxyx(main_win, height, width);
+    
+    if (history_items.empty()) {
+        std::string msg = history_most_played ? "Nothing played through yet." : "Nothing played yet.";
+        mvwprintw(main_win, height/2, (width - msg.length())/2, "%s", msg.c_str());
+    } else {
+        int max_title_len = width - 32; // index (4+1), two columns (1+10, 1+12) + padding
+        if (max_title_len < 10) max_title_len = 10;
+        
+        // Header
+        wattron(main_win, A_BOLD | A_UNDERLINE);
+        if (history_most_played) mvwprintw(main_win, 1, 2, "%-4s %-*s %10s %12s", "#", max_title_len, "Title", "Plays", "Listened");
+        else mvwprintw(main_win, 1, 2, "%-4s %-*s %10s %12s", "#", max_title_len, "Title", "Stopped at", "Played");
+        wattroff(main_win, A_BOLD | A_UNDERLINE);
+        
+        int count = list_size();
+        keep_selection_visible(count, height - 3);
+        for (int i = scroll_offset; i < count; ++i) {
+            int y = i - scroll_offset + 2;
+            if (y >= height - 1) break;
+            
+            if (i == selection_index) wattron(main_win, style(ROLE_SELECTED));
+            
+            int row = list_row(i);
+            const HistoryEntry& entry = history_items[row];
+            std::string title = entry.title;
+            if (title.length() > max_title_len) title = title.substr(0, max_title_len - 3) + "...";
+            
+            char first[16], second[32];
+            if (history_most_played) {
+                snprintf(first, sizeof(first), "%u", entry.plays);
+                snprintf(second, sizeof(second), "%lluh %02llum", static_cast<unsigned long long>(entry.listened / 3600),
+                         static_cast<unsigned long long>(entry.listened / 60 % 60));
+            } else {
+                // Blank when it played to the end, so what [R] would resume stands out
+                bool finished = entry.duration > 0 && entry.position + 5 >= entry.duration;
+                snprintf(first, sizeof(first), "%s", finished ? "" : duration_label(entry.position).c_str());
+                snprintf(second, sizeof(second), "%s", played_label(entry.last_played).c_str());
+            }
+            mvwprintw(main_win, y, 2, "%-4d %-*s %10s %12s", row + 1, max_title_len, title.c_str(), first, second);
+            
+            if (i == selection_index) wattroff(main_win, style(ROLE_SELECTED));
         }
     }
     wnoutrefresh(main_win);
@@ -792,34 +1322,13 @@ void UI::draw_playlist_view() {
 void UI::handle_playlists_input(int ch) {
     switch (ch) {
         case 27: set_mode(AppMode::PLAYBACK); break;
-        case KEY_UP: 
-            if (selection_index > 0) {
-                selection_index--; 
-                update_preview_songs();
-            }
-            break;
-        case KEY_DOWN: 
-            if (selection_index < playlists.size() - 1) {
-                selection_index++; 
-                update_preview_songs();
-            }
+        case KEY_UP: case KEY_DOWN: case KEY_PPAGE: case KEY_NPAGE: case KEY_HOME: case KEY_END:
+            move_selection(ch, static_cast<int>(playlists.size()));
+            update_preview_songs();
             break;
-        case 'n': case 'N': {
-            std::string name = get_user_input("New Playlist Name");
-            
-            if (name.length() > 0) {
-                if (playlist_manager.create_playlist(name)) {
-                    playlists = playlist_manager.list_playlists();
-                    show_message("Playlist created.");
-                    // Auto-select the new playlist
-                    selection_index = playlists.size() - 1;
-                    update_preview_songs();
-                } else {
-                    show_message("Playlist already exists.");
-                }
-            }
+        case 'n': case 'N':
+            prompt_new_playlist();
             break;
-        }
     case 'd': case 'D':
             if (!playlists.empty()) {
                 playlist_manager.delete_playlist(playlists[selection_index].name);
@@ -832,25 +1341,25 @@ void UI::handle_playlists_input(int ch) {
         case 'r': case 'R': {
             if (!playlists.empty()) {
                 std::string old_name = playlists[selection_index].name;
-                std::string new_name = get_user_input("Rename Playlist to");
-                
-                if (!new_name.empty() && new_name != old_name) {
-                    if (playlist_manager.rename_playlist(old_name, new_name)) {
-                        playlists = playlist_manager.list_playlists();
-                        
-                        // Find and select the renamed playlist
-                        for (int i=0; i < playlists.size(); ++i) {
-                            if (playlists[i].name == new_name) {
-                                selection_index = i;
-                                break;
+                open_prompt("Rename Playlist to", [this, old_name](const std::string& new_name) {
+                    if (!new_name.empty() && new_name != old_name) {
+                        if (playlist_manager.rename_playlist(old_name, new_name)) {
+                            playlists = playlist_manager.list_playlists();
+                            
+                            // Find and select the renamed playlist
+                            for (int i=0; i < playlists.size(); ++i) {
+                                if (playlists[i].name == new_name) {
+                                    selection_index = i;
+                                    break;
+                                }
                             }
+                            update_preview_songs();
+                            show_message("Playlist renamed.");
+                        } else {
+                            show_message("Rename failed (Name exists?)");
                         }
-                        update_preview_songs();
-                        show_message("Playlist renamed.");
-                    } else {
-                        show_message("Rename failed (Name exists?)");
                     }
-                }
+                });
             }
             break;
         }
@@ -858,6 +1367,7 @@ void UI::handle_playlists_input(int ch) {
             if (!playlists.empty()) {
                 current_playlist_name = playlists[selection_index].name;
                 current_playlist_songs = playlist_manager.get_playlist_songs(current_playlist_name);
+                list_version++;
                 selection_index = 0;
                 set_mode(AppMode::PLAYLIST_VIEW);
             }
@@ -866,24 +1376,35 @@ void UI::handle_playlists_input(int ch) {
 }
 
 void UI::handle_playlist_view_input(int ch) {
+    if (handle_list_keys(ch)) return;
     switch (ch) {
         case 27: 
             playlists = playlist_manager.list_playlists();
             set_mode(AppMode::PLAYLIST_BROWSER); 
             break;
-        case KEY_UP: if (selection_index > 0) selection_index--; break;
-        case KEY_DOWN: if (selection_index < current_playlist_songs.size() - 1) selection_index++; break;
         case 'd': case 'D':
-            if (!current_playlist_songs.empty()) {
-                playlist_manager.remove_song_from_playlist(current_playlist_name, selection_index);
+            if (list_size() > 0) {
+                playlist_manager.remove_song_from_playlist(current_playlist_name, list_row(selection_index));
                 current_playlist_songs = playlist_manager.get_playlist_songs(current_playlist_name);
-                if (selection_index >= current_playlist_songs.size() && selection_index > 0) selection_index--;
+                list_version++;
+                if (selection_index >= list_size() && selection_index > 0) selection_index--;
                 show_message("Song removed.");
             }
             break;
-        case 'm': case 'M':
+        case 'w': case 'W':
             if (!current_playlist_songs.empty()) {
-                song_to_move_index = selection_index;
+                bool download = (ch == 'W');
+                if (download && !audio_cache.enabled()) {
+                    show_message("Downloading needs the audio cache (set VIBE_FI_AUDIO_CACHE_MB).");
+                    break;
+                }
+                playlist_warmer.warm(current_playlist_songs, download);
+                show_message(download ? "Downloading playlist in the background..." : "Warming playlist in the background...");
+            }
+            break;
+        case 'm': case 'M':
+            if (list_size() > 0) {
+                song_to_move_index = list_row(selection_index);
                 song_to_move_origin_playlist = current_playlist_name;
                 
                 playlists = playlist_manager.list_playlists();
@@ -892,28 +1413,13 @@ void UI::handle_playlist_view_input(int ch) {
             }
             break;
         case 10: // Enter
-            if (!current_playlist_songs.empty()) {
+            if (list_size() > 0) {
                 show_message("Resolving...");
                 wnoutrefresh(help_win);
                 doupdate();
-                try {
-                    player.stop(); // Stop current playback
-                    fetch_current_lyrics(current_playlist_songs[selection_index].title); // Fetch BEFORE loading/playing
-                    
-                    std::string stream_url = get_youtube_stream_url(current_playlist_songs[selection_index].url);
-                    player.load(stream_url);
-                    last_played_path = stream_url;
-                    player.set_property("force-media-title", current_playlist_songs[selection_index].title);
+                if (play_stream_queue(current_playlist_songs, list_row(selection_index))) {
                     playing_playlist_name = current_playlist_name;
-                    
-                    // Set autoplay context
-                    playing_index = selection_index;
-                    is_playing_from_playlist = true;
-                    
-                    player.play();
                     set_mode(AppMode::PLAYBACK);
-                } catch (const std::exception& e) {
-                    show_message(std::string("Cannot play: ") + e.what());
                 }
             }
             break;
@@ -924,8 +1430,9 @@ void UI::handle_playlist_select_for_add_input(int ch) {
         case 27: 
             set_mode(AppMode::SEARCH_RESULTS); 
             break;
-        case KEY_UP: if (selection_index > 0) selection_index--; break;
-        case KEY_DOWN: if (selection_index < playlists.size() - 1) selection_index++; break;
+        case KEY_UP: case KEY_DOWN: case KEY_PPAGE: case KEY_NPAGE: case KEY_HOME: case KEY_END:
+            move_selection(ch, static_cast<int>(playlists.size()));
+            break;
         case 10: // Enter
             if (!playlists.empty()) {
                 if (playlist_manager.add_song_to_playlist(playlists[selection_index].name, song_to_add)) {
@@ -936,22 +1443,9 @@ void UI::handle_playlist_select_for_add_input(int ch) {
                 }
             }
             break;
-        case 'n': case 'N': {
-            std::string name = get_user_input("New Playlist Name");
-            
-            if (name.length() > 0) {
-                if (playlist_manager.create_playlist(name)) {
-                    playlists = playlist_manager.list_playlists();
-                    show_message("Playlist created.");
-                    // Auto-select the new playlist
-                    selection_index = playlists.size() - 1;
-                } else {
-                    show_message("Playlist already exists.");
-                }
-            }
-            draw_playlist_select_for_add();
+        case 'n': case 'N':
+            prompt_new_playlist();
             break;
-        }
     }
 }
 
@@ -961,11 +1455,13 @@ void UI::handle_playlist_select_for_move_input(int ch) {
             // Return to playlist view without doing anything
             current_playlist_name = song_to_move_origin_playlist;
             current_playlist_songs = playlist_manager.get_playlist_songs(current_playlist_name);
+            list_version++;
             selection_index = song_to_move_index;
             set_mode(AppMode::PLAYLIST_VIEW); 
             break;
-        case KEY_UP: if (selection_index > 0) selection_index--; break;
-        case KEY_DOWN: if (selection_index < playlists.size() - 1) selection_index++; break;
+        case KEY_UP: case KEY_DOWN: case KEY_PPAGE: case KEY_NPAGE: case KEY_HOME: case KEY_END:
+            move_selection(ch, static_cast<int>(playlists.size()));
+            break;
         case 10: // Enter
             if (!playlists.empty()) {
                 std::string dest_playlist = playlists[selection_index].name;
@@ -979,6 +1475,7 @@ void UI::handle_playlist_select_for_move_input(int ch) {
                         // Return to origin playlist view
                         current_playlist_name = song_to_move_origin_playlist;
                         current_playlist_songs = playlist_manager.get_playlist_songs(current_playlist_name);
+                        list_version++;
                         
                         // Adjust selection index if we removed the last item
                         if (selection_index >= current_playlist_songs.size() && selection_index > 0) {
@@ -992,27 +1489,15 @@ void UI::handle_playlist_select_for_move_input(int ch) {
                 }
             }
             break;
-        case 'n': case 'N': {
-             // Allow creating new playlist to move to
-            std::string name = get_user_input("New Playlist Name");
-            
-            if (name.length() > 0) {
-                if (playlist_manager.create_playlist(name)) {
-                    playlists = playlist_manager.list_playlists();
-                    show_message("Playlist created.");
-                    selection_index = playlists.size() - 1;
-                } else {
-                    show_message("Playlist already exists.");
-                }
-            }
-            draw_playlist_select_for_add(); // Refresh title will be correct because mode is set
+        case 'n': case 'N':
+            // Allow creating new playlist to move to
+            prompt_new_playlist();
             break;
-        }
     }
 }
 
 void UI::draw_intro() {
-    werase(main_win);
+    erase_interior(main_win);
     draw_borders(main_win, "");
     
     int height, width;
@@ -1028,18 +1513,18 @@ void UI::draw_intro() {
     };
     
     int start_y = (height - ascii_art.size()) / 2 - 2;
-    wattron(main_win, COLOR_PAIR(1) | A_BOLD);
+    wattron(main_win, style(ROLE_BORDER) | A_BOLD);
     for (int i = 0; i < ascii_art.size(); ++i) {
         int start_x = (width - ascii_art[i].length()) / 2;
         if (start_x < 0) start_x = 0;
         mvwprintw(main_win, start_y + i, start_x, "%s", ascii_art[i].c_str());
     }
-    wattroff(main_win, COLOR_PAIR(1) | A_BOLD);
+    wattroff(main_win, style(ROLE_BORDER) | A_BOLD);
     
     std::string welcome = "Welcome to Vibe-Fi";
     mvwprintw(main_win, start_y + ascii_art.size() + 2, (width - welcome.length()) / 2, "%s", welcome.c_str());
     
-    std::string instruction = "Press [L] Library  [S] Search  [P] Playlists  [ESC] Quit";
+    std::string instruction = "Press [L] Library  [S] Search  [P] Playlists  [Y] History  [ESC] Quit";
     mvwprintw(main_win, start_y + ascii_art.size() + 4, (width - instruction.length()) / 2, "%s", instruction.c_str());
     
     wnoutrefresh(main_win);
@@ -1049,7 +1534,7 @@ void UI::draw_lyrics() {
     // Determine target window based on mode
     WINDOW* target_win = (mode == AppMode::LYRICS_VIEW) ? main_win : lyrics_win;
     
-    werase(target_win);
+    erase_interior(target_win);
     draw_borders(target_win, "LYRICS");
     
     int height, width;
@@ -1085,12 +1570,12 @@ void UI::draw_lyrics() {
             if (idx >= current_lyrics_data.synced_lyrics.size()) break;
             
             if (idx == active_index) {
-                wattron(target_win, A_BOLD | COLOR_PAIR(2)); // Highlight active line
+                wattron(target_win, A_BOLD | style(ROLE_ACTIVE)); // Highlight active line
                 std::string line = "> " + current_lyrics_data.synced_lyrics[idx].text;
                 int start_x = (width - line.length()) / 2;
                 if (start_x < 0) start_x = 0;
                 mvwprintw(target_win, i + 1, start_x, "%s", line.c_str());
-                wattroff(target_win, A_BOLD | COLOR_PAIR(2));
+                wattroff(target_win, A_BOLD | style(ROLE_ACTIVE));
             } else {
                 std::string line = current_lyrics_data.synced_lyrics[idx].text;
                 int start_x = (width - line.length()) / 2;
@@ -1115,7 +1600,7 @@ void UI::draw_lyrics() {
             int start_x = (width - error_msg.length()) / 2;
             if (start_x < 0) start_x = 0;
             
-            wattron(target_win, COLOR_PAIR(1) | A_BOLD); // Red/Warning color
+            wattron(target_win, style(ROLE_BORDER) | A_BOLD); // Red/Warning color
             mvwprintw(target_win, start_y, start_x, "%s", error_msg.c_str());
             
             // Draw a box around it? Maybe too much. Let's just make it bold red.
@@ -1126,7 +1611,7 @@ void UI::draw_lyrics() {
             wattroff(target_win, A_BOLD);
             mvwprintw(target_win, start_y + 2, hint_x, "%s", hint.c_str());
             
-            wattroff(target_win, COLOR_PAIR(1));
+            wattroff(target_win, style(ROLE_BORDER));
             
         } else {
             // Normal Plain Lyrics
@@ -1169,6 +1654,26 @@ void UI::draw_lyrics() {
     wnoutrefresh(target_win);
 }
 
+void UI::handle_history_input(int ch) {
+    if (handle_list_keys(ch)) return;
+    switch (ch) {
+        case 27: set_mode(AppMode::PLAYBACK); break;
+        case '\t':
+            history_most_played = !history_most_played;
+            refresh_history();
+            selection_index = 0;
+            scroll_offset = 0;
+            reset_list_filter();
+            break;
+        case 10: case 'r': case 'R': // Enter plays from the start, R from where it stopped
+            if (list_size() > 0) {
+                HistoryEntry entry = history_items[list_row(selection_index)];
+                if (play_history_entry(entry, ch != 10)) set_mode(AppMode::PLAYBACK);
+            }
+            break;
+    }
+}
+
 void UI::handle_lyrics_input(int ch) {
     switch (ch) {
         case 27: set_mode(AppMode::PLAYBACK); break;
@@ -1198,123 +1703,478 @@ void UI::handle_intro_input(int ch) {
     } else if (ch == 'p' || ch == 'P') {
         playlists = playlist_manager.list_playlists();
         set_mode(AppMode::PLAYLIST_BROWSER);
+    } else if (ch == 'y' || ch == 'Y') {
+        set_mode(AppMode::HISTORY_VIEW);
     } else if (ch == 27 || ch == 'q' || ch == 'Q') { // ESC or Q
         running = false;
     }
 }
 
-void UI::play_next() {
-    if (playing_index == -1) return;
+void UI::load_stream(const std::string& webpage_url, const std::string& title) {
+    stop_recording();
+    
+    // A cached copy plays without yt-dlp or the network
+    std::string cached = audio_cache.lookup(webpage_url);
+    std::string url_to_play = cached;
+    if (url_to_play.empty()) {
+        url_to_play = stream_resolver.resolve(webpage_url);
+        std::string proxied = stream_proxy.enabled() ? stream_proxy.register_track(webpage_url, url_to_play) : "";
+        if (!proxied.empty()) {
+            // The proxy reads ahead, retries throttled chunks and fills the cache itself
+            url_to_play = proxied;
+        } else if (audio_cache.enabled()) {
+            // Record what mpv downloads anyway; kept only if the track plays through
+            player.set_property("stream-record", audio_cache.recording_path(webpage_url));
+            recording_url = webpage_url;
+            recording_seeked = false;
+        }
+    }
     
-    int next_index = playing_index + 1;
-    std::string next_url;
-    std::string next_title;
+    prepare_track(webpage_url, cached, title);
+    player.load(url_to_play);
+    last_played_path = url_to_play;
+    player.set_property("force-media-title", title);
+}
+
+void UI::prepare_track(const std::string& key, const std::string& file, const std::string& title) {
+    play_history.begin(key, title.empty() ? (is_url(key) ? key : fs::path(key).filename().string()) : title,
+                       is_url(key) ? PlaySource::STREAM : PlaySource::LOCAL);
+    resume_position = -1.0;
+    
+    // A track not measured yet plays unadjusted and is measured for next time
+    double gain = 0.0;
+    analyzer.gain_for(key, gain);
+    player.set_gain(gain);
+    // Beats need the audio on disk; uncached streams keep the free-running visualizer.
+    // The same decode measures the loudness and waveform if they are missing.
+    beats.start(key, file);
+    
+    waveform_key = key;
+    waveform.clear();
+    
+    // Whatever was being looked up belongs to the track being replaced
+    lyrics_path.clear();
+    lyrics_result = std::future<LyricsData>();
+    waveform_version = analyzer.version();
+    TrackAnalysis known;
+    if (library_index.lookup(key, known)) waveform = known.waveform;
+    status_line.valid = false;
+}
+
+void UI::refresh_waveform() {
+    // Picks up the waveform of the track playing once the background decode stores it
+    if (!waveform.empty() || waveform_key.empty() || analyzer.version() == waveform_version) return;
+    waveform_version = analyzer.version();
+    TrackAnalysis known;
+    if (library_index.lookup(waveform_key, known) && !known.waveform.empty()) {
+        waveform = known.waveform;
+        status_line.valid = false;
+    }
+}
+
+void UI::stop_recording() {
+    if (recording_url.empty()) return;
+    player.set_property("stream-record", "");
+    audio_cache.discard(recording_url);
+    recording_url.clear();
+}
+
+void UI::play_local_queue(size_t start_index) {
+    // Every file in this directory, starting from the selected one
+    std::vector<LibraryItem> files;
+    size_t start = 0;
+    for (size_t i = 0; i < library_items.size(); ++i) {
+        LibraryItem item = library_items[i];
+        if (item.is_directory) continue;
+        if (i == start_index) start = files.size();
+        files.push_back(item);
+    }
+    play_local_files(files, start);
+}
+
+void UI::play_local_files(const std::vector<LibraryItem>& files, size_t start) {
+    if (files.empty()) return;
+    local_queue = files;
+    stream_queue.clear();
+    session_queue_hash = 0; // Written out with the next snapshot
+    queue_source = QueueSource::LOCAL;
+    queue_failures = 0;
+    play_queue.reset(local_queue.size(), start);
+    play_queue_track(static_cast<int>(start));
+}
+
+bool UI::play_stream_queue(const std::vector<TrackRef>& songs, size_t start_index) {
+    // A copy, so browsing other playlists does not change what plays next
+    stream_queue = songs;
+    local_queue.clear();
+    session_queue_hash = 0;
+    queue_source = QueueSource::STREAMS;
+    queue_failures = 0;
+    play_queue.reset(stream_queue.size(), start_index);
+    return play_queue_track(static_cast<int>(start_index));
+}
+
+bool UI::play_queue_track(int index, bool fetch_lyrics) {
+    if (queue_source == QueueSource::LOCAL) {
+        const LibraryItem& item = local_queue[index];
+        std::string path = item.path();
+        stop_recording();
+        
+        // "replace" drops whatever was playing; the next file is appended up
+        // front so mpv can prefetch it and play on without a gap
+        prepare_track(path, path);
+        player.load(path);
+        last_played_path = path;
+        player.set_property("force-media-title", path);
+        player.play();
+        if (fetch_lyrics) fetch_current_lyrics(path, path, item.duration);
+        queue_upcoming();
+        return true;
+    }
     
-    if (is_playing_from_playlist) {
-        if (next_index < current_playlist_songs.size()) {
-            next_url = current_playlist_songs[next_index].url;
-            next_title = current_playlist_songs[next_index].title;
-        } else {
-            // End of playlist
-            playing_index = -1;
-            show_message("End of playlist.");
-            return;
-        }
+    const TrackRef& song = stream_queue[index];
+    try {
+        player.stop(); // Stop current playback
+        load_stream(song.url(), song.title());
+        player.play();
+        if (fetch_lyrics) fetch_current_lyrics(song.title(), last_played_path, song.duration());
+        queue_upcoming();
+        return true;
+    } catch (const std::exception& e) {
+        show_message(std::string("Cannot play: ") + e.what());
+        return false;
+    }
+}
+
+void UI::queue_upcoming() {
+    int next = play_queue.peek_next();
+    if (queue_source == QueueSource::LOCAL) {
+        // mpv only ever holds the file playing and the next one, which shuffle
+        // and repeat can change at any time
+        player.clear_upcoming();
+        if (next == -1) return;
+        std::string path = local_queue[next].path();
+        player.append(path);
+        // Measured ahead of time, so it starts at the right level
+        analyzer.request(path, path);
+    } else if (queue_source == QueueSource::STREAMS && next != -1 && next != play_queue.current()) {
+        // Resolved while this one plays, so autoplay switches at once
+        playlist_warmer.warm({stream_queue[next]}, false);
+    }
+}
+
+void UI::refresh_history() {
+    // Both come from memory and the end of the log, however long the history is
+    const size_t rows = 200;
+    history_items = history_most_played ? play_history.most_played(rows) : play_history.recent(rows);
+    list_version++;
+}
+
+bool UI::play_history_entry(const HistoryEntry& entry, bool resume) {
+    if (entry.source == PlaySource::STREAM) {
+        show_message("Resolving...");
+        wnoutrefresh(help_win);
+        doupdate();
+        if (!play_stream_queue({TrackRef(entry.title, entry.key, static_cast<int>(entry.duration))}, 0)) return false;
     } else {
-        if (next_index < search_results.size()) {
-            next_url = search_results[next_index].url;
-            next_title = search_results[next_index].title;
+        if (!fs::exists(entry.key)) {
+            show_message("Not Found: " + entry.key);
+            return false;
+        }
+        fs::path path(entry.key);
+        LibraryItem item{string_pool().intern(path.parent_path().string()), string_pool().intern(path.filename().string()),
+                         static_cast<int32_t>(entry.duration), false};
+        play_local_files({item}, 0);
+    }
+    // Picked up once the file is open; one that was nearly over starts again
+    if (resume && entry.position > 0 && (entry.duration == 0 || entry.position + 5 < entry.duration)) {
+        resume_position = entry.position;
+    }
+    return true;
+}
+
+bool UI::resume_session() {
+    const char* resume = getenv("VIBE_FI_RESUME");
+    if (resume && std::string(resume) == "0") return false;
+    Session session;
+    if (!session.load()) return false;
+    // Reading it is cheap; loading the track waits until the first frame is up
+    pending_session = std::move(session);
+    session_pending = true;
+    set_mode(AppMode::PLAYBACK);
+    return true;
+}
+
+void UI::apply_session() {
+    session_pending = false;
+    Session session = std::move(pending_session);
+    const SessionTrack& playing = session.queue[session.index];
+    
+    // The URL yt-dlp gave last time plays again while it is valid
+    if (session.streams && !session.stream.stream_url.empty()) stream_resolver.remember(playing.key, session.stream);
+    
+    local_queue.clear();
+    stream_queue.clear();
+    for (const SessionTrack& track : session.queue) {
+        if (session.streams) {
+            stream_queue.push_back(TrackRef(track.title, track.key, track.duration));
         } else {
-            // End of search results
-            playing_index = -1;
-            show_message("End of results.");
-            return;
+            fs::path path(track.key);
+            local_queue.push_back({string_pool().intern(path.parent_path().string()),
+                                   string_pool().intern(path.filename().string()), track.duration, false});
         }
     }
-    
-    try {
-        show_message("Autoplaying next: " + next_title);
+    queue_source = session.streams ? QueueSource::STREAMS : QueueSource::LOCAL;
+    queue_failures = 0;
+    // The files on disk already hold this queue and these lyrics
+    session_queue_hash = session.queue_hash;
+    session_lyrics_hash = session.lyrics_loaded ? session.lyrics_hash : 0;
+    autoplay_enabled = session.autoplay;
+    play_queue.set_repeat(session.repeat);
+    play_queue.set_shuffle(session.shuffle);
+    play_queue.reset(session.queue.size(), session.index);
+    
+    if (!session.streams && !fs::exists(playing.key)) {
+        show_message("Not Found: " + playing.key);
+        queue_source = QueueSource::NONE;
+        Session::discard();
+        return;
+    }
+    if (session.streams) {
+        show_message("Resuming...");
         wnoutrefresh(help_win);
         doupdate();
-        
-        player.stop(); // Stop current playback
-        std::string stream_url = get_youtube_stream_url(next_url);
-        fetch_current_lyrics(next_title); // Fetch BEFORE loading/playing
-        player.load(stream_url);
-        last_played_path = stream_url;
-        player.set_property("force-media-title", next_title);
-        player.play();
-        
-        playing_index = next_index;
-    } catch (const std::exception& e) {
-        show_message("Autoplay failed: " + std::string(e.what()));
-        playing_index = -1; // Stop autoplay on error
     }
+    if (!play_queue_track(static_cast<int>(session.index), !session.lyrics_loaded)) {
+        queue_source = QueueSource::NONE;
+        Session::discard();
+        return;
+    }
+    if (session.lyrics_loaded) {
+        current_lyrics_data = session.lyrics;
+        lyrics_scroll_offset = 0;
+        lyrics_auto_scroll = true;
+    }
+    if (session.position > 0) resume_position = session.position;
+    if (session.paused) player.pause();
 }
 
-std::string UI::get_user_input(const std::string& prompt) {
-    int height, width;
-    getmaxyx(stdscr, height, width);
-    
-    int win_h = 5;
-    int win_w = 40;
-    int start_y = (height - win_h) / 2;
-    int start_x = (width - win_w) / 2;
-    
-    WINDOW* input_win = newwin(win_h, win_w, start_y, start_x);
-    wbkgd(input_win, COLOR_PAIR(1)); 
-    box(input_win, 0, 0);
-    
-    mvwprintw(input_win, 0, 2, " %s ", prompt.c_str());
-    mvwprintw(input_win, 2, 2, "> ");
-    wnoutrefresh(input_win);
-    doupdate();
+void UI::save_session() {
+    session_saved_at = std::chrono::steady_clock::now();
+    int index = play_queue.current();
+    if (session_pending) return; // Not played yet; the files still hold it
+    if (queue_source == QueueSource::NONE || index == -1) {
+        // Stopped, or playing what was passed on the command line
+        if (session_state_hash != 0) Session::discard();
+        session_state_hash = 0;
+        session_queue_hash = 0;
+        session_lyrics_hash = 0;
+        return;
+    }
     
-    curs_set(1);
-    std::string input;
-    int ch;
+    Session session;
+    session.streams = queue_source == QueueSource::STREAMS;
+    session.index = static_cast<size_t>(index);
+    if (session.streams) stream_resolver.lookup(stream_queue[index].url(), session.stream);
+    session.shuffle = play_queue.shuffle();
+    session.repeat = play_queue.repeat();
+    session.autoplay = autoplay_enabled;
+    // A resume seek not applied yet is still where the track is
+    session.position = resume_position > 0 ? resume_position : player.get_position();
+    session.paused = player.is_paused();
+    session.lyrics = current_lyrics_data;
+    
+    // The queue, which can run to megabytes, only after it was replaced
+    if (session_queue_hash == 0) {
+        if (session.streams) {
+            session.queue.reserve(stream_queue.size());
+            for (const TrackRef& song : stream_queue) session.queue.push_back({song.url(), song.title(), song.duration()});
+        } else {
+            session.queue.reserve(local_queue.size());
+            for (const LibraryItem& item : local_queue) session.queue.push_back({item.path(), "", item.duration});
+        }
+        std::string contents = session.serialize_queue();
+        if (!Session::save(Session::queue_path(), contents)) return;
+        session_queue_hash = hash_string(contents);
+    }
+    // Lyrics still being looked up are looked up again on resume (no hash)
+    bool lyrics_pending = lyrics_result.valid() || !lyrics_path.empty();
+    std::string lyrics = lyrics_pending ? "" : session.serialize_lyrics();
+    uint64_t lyrics_hash = hash_string(lyrics);
+    if (!lyrics_pending && lyrics_hash != session_lyrics_hash) {
+        if (!Session::save(Session::lyrics_path(), lyrics)) return;
+        session_lyrics_hash = lyrics_hash;
+    }
     
-    while (true) {
-        ch = wgetch(input_win);
-        if (ch == 27) { // ESC
-            input = ""; // Cancel
-            break;
-        } else if (ch == 10) { // Enter
-            break;
-        } else if (ch == KEY_BACKSPACE || ch == 127) {
-            if (!input.empty()) {
-                input.pop_back();
-                mvwprintw(input_win, 2, 4, "%s ", input.c_str()); // Clear last char
-                wmove(input_win, 2, 4 + input.length());
-                wnoutrefresh(input_win);
-                doupdate();
+    std::string state = session.serialize_state(session_queue_hash, lyrics_pending ? 0 : session_lyrics_hash);
+    uint64_t state_hash = hash_string(state);
+    if (state_hash == session_state_hash) return;
+    if (Session::save(Session::path(), state)) session_state_hash = state_hash;
+}
+
+void UI::process_player_events() {
+    PlayerEvent event;
+    while (player.poll_event(event)) {
+        if (event.type == PlayerEventType::TRACK_CHANGED) {
+            // mpv moved on to the local file queue_upcoming() appended; dropping
+            // the finished one brings it back to position 0
+            if (queue_source == QueueSource::LOCAL && event.playlist_pos > 0) {
+                int index = play_queue.next();
+                if (index == -1) continue;
+                const LibraryItem& item = local_queue[index];
+                last_played_path = item.path();
+                player.set_property("force-media-title", last_played_path);
+                prepare_track(last_played_path, last_played_path);
+                fetch_current_lyrics(last_played_path, last_played_path, item.duration);
+                queue_upcoming();
             }
-        } else if (isprint(ch)) {
-            if (input.length() < win_w - 6) {
-                input += (char)ch;
-                mvwprintw(input_win, 2, 4, "%s", input.c_str());
-                wnoutrefresh(input_win);
-                doupdate();
+        } else if (event.type == PlayerEventType::FILE_LOADED) {
+            // Resuming from the history: the file is open, so the seek applies to it
+            if (resume_position > 0) player.seek(resume_position, SeekMode::ABSOLUTE, SeekPrecision::EXACT);
+            resume_position = -1.0;
+            if (!lyrics_path.empty() && player.get_metadata("path") == lyrics_path) start_lyrics_lookup();
+        } else if (event.type == PlayerEventType::FILE_ENDED) {
+            if (event.eof || event.error) play_history.end(event.eof);
+            // A stream recorded start to finish without seeks is a complete copy
+            if (!recording_url.empty() && event.eof && !recording_seeked) {
+                player.set_property("stream-record", "");
+                audio_cache.commit(recording_url);
+                analyzer.request(recording_url, audio_cache.cached_path(recording_url));
+                recording_url.clear();
             }
+            
+            if (event.error) queue_failures++;
+            else if (event.eof) queue_failures = 0;
+            // On repeat, a queue where nothing plays would otherwise go round forever
+            if (queue_source != QueueSource::NONE && queue_failures >= static_cast<int>(play_queue.size())) {
+                queue_source = QueueSource::NONE;
+                queue_failures = 0;
+                // Plays end here, on eof or error, or with begin() of the next one;
+                // never on IDLE, which can arrive after that next begin()
+                play_history.end();
+                player.stop();
+                show_message("Nothing in the queue would play.");
+            }
+            
+            // Autoplay for streams, which are loaded one at a time
+            if ((event.eof || event.error) && autoplay_enabled && queue_source == QueueSource::STREAMS) {
+                play_next();
+            }
+        } else if (event.type == PlayerEventType::PAUSE_CHANGED) {
+            play_history.set_paused(event.paused);
+            events.paused(event.paused);
         }
     }
-    
+}
+
+void UI::play_next() {
+    int index = play_queue.next();
+    if (index == -1) {
+        show_message("End of queue.");
+        return;
+    }
+    show_message(std::string("Autoplaying next: ") + stream_queue[index].title());
+    wnoutrefresh(help_win);
+    doupdate();
+    if (!play_queue_track(index)) queue_source = QueueSource::NONE; // Stop autoplay on error
+}
+
+void UI::open_prompt(const std::string& title, std::function<void(const std::string&)> on_submit) {
+    prompt.open = true;
+    prompt.title = title;
+    prompt.input.clear();
+    prompt.on_submit = on_submit;
+    prompt.win = newwin(prompt.h, prompt.w, 0, 0);
+    wbkgd(prompt.win, style(ROLE_BORDER));
+    curs_set(1);
+}
+
+void UI::close_prompt() {
+    if (!prompt.open) return;
+    delwin(prompt.win);
+    prompt.win = nullptr;
+    prompt.open = false;
     curs_set(0);
-    delwin(input_win);
     
-    // Force full redraw after popup
-    clear();
-    refresh();
-    draw(); 
+    // Only the rows the box covered need to go back to the terminal
+    for (WINDOW* win : {main_win, visualizer_win, lyrics_win, status_win, help_win}) {
+        int top = getbegy(win);
+        int first = std::max(prompt.y, top);
+        int last = std::min(prompt.y + prompt.h, top + getmaxy(win));
+        if (first < last) touchline(win, first - top, last - first);
+    }
+}
+
+void UI::draw_prompt() {
+    // Recentred every frame so a resize never leaves the box off screen
+    prompt.y = std::max(0, (LINES - prompt.h) / 2);
+    prompt.x = std::max(0, (COLS - prompt.w) / 2);
+    mvwin(prompt.win, prompt.y, prompt.x);
+    
+    werase(prompt.win);
+    const GlyphSet& g = *glyphs;
+    wborder(prompt.win, glyph(g.vline), glyph(g.vline), glyph(g.hline), glyph(g.hline),
+            glyph(g.ulcorner), glyph(g.urcorner), glyph(g.llcorner), glyph(g.lrcorner));
+    mvwprintw(prompt.win, 0, 2, " %s ", prompt.title.c_str());
+    mvwprintw(prompt.win, 2, 2, "> %s", prompt.input.c_str());
+    touchwin(prompt.win); // The views below were just redrawn over the same cells
+    wnoutrefresh(prompt.win); // Last, so the cursor ends up after the typed text
+}
+
+void UI::handle_prompt_input(int ch) {
+    if (ch == 27) { // ESC
+        close_prompt(); // Cancel
+    } else if (ch == 10) { // Enter
+        std::string input = prompt.input;
+        auto on_submit = prompt.on_submit;
+        close_prompt();
+        on_submit(input);
+    } else if (ch == KEY_BACKSPACE || ch == 127) {
+        if (!prompt.input.empty()) prompt.input.pop_back();
+    } else if (ch < 256 && isprint(ch)) {
+        if (prompt.input.length() < prompt.w - 6) prompt.input += (char)ch;
+    }
+}
+
+void UI::prompt_new_playlist() {
+    open_prompt("New Playlist Name", [this](const std::string& name) {
+        if (name.length() > 0) {
+            if (playlist_manager.create_playlist(name)) {
+                playlists = playlist_manager.list_playlists();
+                show_message("Playlist created.");
+                // Auto-select the new playlist
+                selection_index = playlists.size() - 1;
+                if (mode == AppMode::PLAYLIST_BROWSER) update_preview_songs();
+            } else {
+                show_message("Playlist already exists.");
+            }
+        }
+    });
+}
+
+void UI::fetch_current_lyrics(const std::string& title, const std::string& path, double duration_hint) {
+    lyrics_title = title;
+    lyrics_path = path;
+    lyrics_duration = duration_hint;
+    lyrics_result = std::future<LyricsData>();
+    current_lyrics_data = {"Fetching lyrics...", {}, false};
+    lyrics_scroll_offset = 0;
+    lyrics_auto_scroll = true;
     
-    return input;
+    // A gapless switch may have opened the file already; otherwise FILE_LOADED starts it
+    if (player.get_metadata("path") == path && player.get_duration() > 0) start_lyrics_lookup();
 }
 
-void UI::fetch_current_lyrics(std::string title_override) {
-    std::string title = title_override;
-    if (title.empty()) {
-        title = player.get_metadata("media-title");
-        if (title.empty()) title = player.get_metadata("filename");
+void UI::start_lyrics_lookup() {
+    // The player describes lyrics_path now, so its tags and duration are this track's
+    std::string title = lyrics_title;
+    lyrics_path.clear();
+    
+    // Local files are passed by path; only the file name says anything about the song
+    std::string local_path;
+    if (fs::exists(title)) {
+        local_path = title;
+        title = fs::path(title).filename().string();
     }
     
     // Remove extension if present (simple check)
@@ -1323,39 +2183,37 @@ void UI::fetch_current_lyrics(std::string title_override) {
         title = title.substr(0, last_dot);
     }
     
+    // "Artist - Title" titles are split by the lyrics manager; metadata only helps when there is no dash
     std::string artist = "";
-    std::string song_title = title;
-    
-    // 1. Try "Artist - Title" format
-    size_t dash_pos = title.find(" - ");
-    if (dash_pos != std::string::npos) {
-        artist = title.substr(0, dash_pos);
-        song_title = title.substr(dash_pos + 3);
+    if (title.find(" - ") == std::string::npos) {
+        artist = player.get_metadata("artist");
     }
     
-    // 2. If no artist, try metadata
-    if (artist.empty()) {
-         artist = player.get_metadata("artist");
-    }
+    double duration = lyrics_duration > 0 ? lyrics_duration : player.get_duration();
     
-    // 3. If still no artist, use "Unknown" or just try to search with title if API allows (it usually needs artist)
-    // But let's be smarter. If we have no artist, we can't really query the API effectively without one.
-    // However, we can try to assume the whole title is the song title and pass a dummy artist or try to extract from title more aggressively?
-    // Let's just use "Unknown" for now, but update the error message to be less specific about "Artist - Title".
-    
-    show_message("Fetching lyrics...");
-    wnoutrefresh(help_win);
-    doupdate(); 
-    
-    if (artist.empty()) {
-        // Try to fetch with empty artist? It might fail.
-        // Let's try to pass the whole title as song_title and see what happens if we pass " " as artist.
-        // Actually, let's just fail gracefully with a better message.
-        current_lyrics_data = {"Lyrics not found. Could not detect artist.", {}, false};
-    } else {
-        current_lyrics_data = lyrics_manager.fetch_lyrics(artist, song_title);
+    // Tags, cache and lrclib can take seconds; a detached worker with a copy of
+    // the manager, so neither the UI loop nor a quit waits on it
+    auto promise = std::make_shared<std::promise<LyricsData>>();
+    lyrics_result = promise->get_future();
+    LyricsManager manager = lyrics_manager;
+    std::thread([promise, manager, local_path, title, artist, duration]() mutable {
+        try {
+            promise->set_value(local_path.empty() ? manager.find_lyrics(title, artist, duration)
+                                                  : manager.find_lyrics_for_file(local_path, title, artist, duration));
+        } catch (...) {
+            promise->set_exception(std::current_exception());
+        }
+    }).detach();
+}
+
+void UI::poll_lyrics() {
+    // prepare_track() drops the future of a track that is no longer playing
+    if (!lyrics_result.valid() || lyrics_result.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return;
+    try {
+        current_lyrics_data = lyrics_result.get();
+    } catch (const std::exception&) {
+        current_lyrics_data = {"Lyrics lookup failed.", {}, false};
     }
-    
     lyrics_scroll_offset = 0;
     lyrics_auto_scroll = true;
 }
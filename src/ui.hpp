@@ -6,10 +6,28 @@
 #include "search.hpp"
 #include "playlist_manager.hpp"
 #include "lyrics.hpp"
+#include "audio_cache.hpp"
+#include "stream_resolver.hpp"
+#include "playlist_warmer.hpp"
+#include "stream_proxy.hpp"
+#include "list_filter.hpp"
+#include "event_hub.hpp"
+#include "library_index.hpp"
+#include "track_analyzer.hpp"
+#include "onset.hpp"
+#include "waveform.hpp"
+#include "play_queue.hpp"
+#include "play_history.hpp"
+#include "session.hpp"
+#include "status_line.hpp"
+#include "theme.hpp"
 #include <string>
 #include <vector>
 #include <ncurses.h>
 #include <chrono>
+#include <future>
+#include <functional>
+#include <map>
 
 enum class AppMode {
     PLAYBACK,
@@ -21,6 +39,7 @@ enum class AppMode {
     PLAYLIST_SELECT_FOR_ADD,
     PLAYLIST_SELECT_FOR_MOVE,
     LYRICS_VIEW,
+    HISTORY_VIEW,
     INTRO
 };
 
@@ -32,6 +51,13 @@ public:
     void run();
     void show_message(const std::string& msg);
     void set_mode(AppMode mode);
+    
+    // Resolves CLI arguments in the background; the first one plays as soon as
+    // it is ready and the rest are appended in order
+    void queue_startup_inputs(const std::vector<std::string>& inputs);
+    void set_startup_time(std::chrono::steady_clock::time_point time);
+    // Plays on from where the last run stopped; false if there is nothing to resume
+    bool resume_session();
 
 private:
     Player& player;
@@ -49,13 +75,66 @@ private:
     Library library;
     PlaylistManager playlist_manager;
     LyricsManager lyrics_manager;
-    std::vector<LibraryItem> library_items;
+    AudioCache audio_cache;
+    StreamResolver stream_resolver;
+    PlaylistWarmer playlist_warmer;
+    StreamProxy stream_proxy;
+    LibraryIndex library_index;
+    TrackAnalyzer analyzer;         // loudness and waveforms, ahead of time
+    BeatTracker beats;              // of the track playing, for the visualizer
+    std::string waveform_key;       // index key of the track playing
+    std::vector<uint8_t> waveform;  // its levels, empty until computed
+    uint64_t waveform_version;      // analyzer.version() when we last looked
+    DirectoryListing library_items;
+    uint64_t library_version;
+    StrId library_selected; // Keeps the cursor on its entry while a scan reorders rows
     std::vector<SearchResult> search_results;
+    std::unique_ptr<SearchJob> search_job; // Running search, if any
 
     int selection_index;
+    
+    // Compiled-in look, picked once at startup (VIBE_FI_THEME / VIBE_FI_GLYPHS)
+    const Theme* theme;
+    const GlyphSet* glyphs;
+    
+    // Frame and title last drawn on each bordered window; only redrawn when they change
+    struct Chrome {
+        int h;
+        int w;
+        std::string title;
+    };
+    std::map<WINDOW*, Chrome> chrome;
+    
+    // Window geometry for one terminal size, worked out once per resize
+    struct Layout {
+        int height;
+        int width;
+        int viz_h;
+        int lyrics_h;
+        int main_h;
+        int status_h;
+        int help_h;
+    };
+    Layout layout;
+    
+    // SIGWINCH bursts are coalesced; the layout is applied once the size settles
+    bool resize_pending;
+    std::chrono::steady_clock::time_point resize_first;
+    std::chrono::steady_clock::time_point resize_last;
+    
+    // "/" filter and type-ahead over the library, search results and playlist view
+    ListFilter list_filter;
+    // Bumped whenever search_results, current_playlist_songs or history_items change, so
+    // the filter knows its matches are stale without looking at every row
+    uint64_t list_version;
+    bool filter_editing;
+    std::string typeahead;
+    std::chrono::steady_clock::time_point typeahead_at;
     int scroll_offset;
     std::string search_query;
-    std::string current_path;
+    std::string current_path; // "" for the list of roots, or for find results
+    std::string find_query;   // set while the library shows find results
+    std::string find_from;    // where the find was started, to go back to
     
     std::vector<Playlist> playlists;
     std::string current_playlist_name;
@@ -67,26 +146,94 @@ private:
     LyricsData current_lyrics_data;
     int lyrics_scroll_offset;
     bool lyrics_auto_scroll;
+    // The lookup for the track playing runs on a worker. Until that track's file
+    // is open (lyrics_path), the player may still be describing the previous one.
+    std::string lyrics_title;
+    std::string lyrics_path;
+    double lyrics_duration;
+    std::future<LyricsData> lyrics_result;
     
-    std::string message;
-    std::chrono::steady_clock::time_point message_time;
+    MessageRing messages;
+    
+    // Status and help text, preformatted and only rebuilt when their inputs change
+    StatusLine status_line;
+    struct HelpCache {
+        char text[256];
+        AppMode mode;
+        bool autoplay;
+        bool valid;
+    };
+    HelpCache help_cache;
+    
+    // Status feed for bars and scripts, fed from what each frame already read
+    EventHub events;
     
     std::string last_played_path;
+    PlayHistory play_history;
+    std::vector<HistoryEntry> history_items;
+    bool history_most_played;
+    double resume_position; // seek there once the file is loaded, -1 if none
+    
+    // Startup state
+    struct StartupItem {
+        std::string input;
+        std::future<std::string> stream_url; // URLs only
+        std::string local_path;
+    };
+    std::vector<StartupItem> startup_queue;
+    size_t startup_next;
+    bool startup_playing;
+    std::chrono::steady_clock::time_point startup_time;
+    double first_frame_ms;
+    double first_audio_ms;
+    std::vector<float> frame_times; // draw() durations in ms, kept when VIBE_FI_FRAME_STATS is set
+    bool frame_stats;
+    bool library_loaded;
+    
+    // What the play queue walks: the files of one library directory, or the
+    // streams of the search results or playlist it was started from
+    enum class QueueSource { NONE, LOCAL, STREAMS };
+    QueueSource queue_source;
+    PlayQueue play_queue;
+    std::vector<LibraryItem> local_queue;
+    std::vector<TrackRef> stream_queue;
+    int queue_failures; // tracks in a row that would not play
+    
+    // Session snapshot: read before the first frame, played after it
+    Session pending_session;
+    bool session_pending;
+    // Hashes of the contents last written, so a file is only rewritten when it
+    // changed; the queue's is reset when a new queue starts
+    uint64_t session_state_hash;
+    uint64_t session_queue_hash;
+    uint64_t session_lyrics_hash;
+    std::chrono::steady_clock::time_point session_saved_at;
+    
+    // Stream currently being written through to the audio cache
+    std::string recording_url;
+    bool recording_seeked;
     
     // Autoplay state
     bool autoplay_enabled;
-    int playing_index;
-    bool is_playing_from_playlist;
 
     void draw();
     void draw_playback();
     void draw_library();
+    void keep_selection_visible(int count, int rows);
+    bool move_selection(int ch, int count);
+    bool handle_list_keys(int ch);
+    void sync_list_filter();
+    void reset_list_filter();
+    int list_size();
+    int list_row(int visible);
+    std::string filter_label();
     void draw_search_input();
     void draw_search_results();
     void draw_playlists();
     void draw_playlist_view();
     void draw_playlist_select_for_add();
     void draw_lyrics();
+    void draw_history();
     void draw_intro();
     
     // State for moving songs
@@ -95,8 +242,16 @@ private:
 
     // Helpers
     void update_preview_songs();
-    void fetch_current_lyrics(std::string title_override = "");
+    // title is a local path or a stream's title; path is what the player was given
+    void fetch_current_lyrics(const std::string& title, const std::string& path, double duration_hint);
+    void start_lyrics_lookup();
+    // Gain and beat analysis for a track about to load; file is "" for an uncached stream
+    void prepare_track(const std::string& key, const std::string& file, const std::string& title = "");
+    void refresh_waveform();
     void draw_borders(WINDOW* win, const std::string& title);
+    void erase_interior(WINDOW* win);
+    void invalidate_chrome();
+    attr_t style(ThemeRole role) const;
     
     void handle_input();
     void handle_playback_input(int ch);
@@ -108,6 +263,7 @@ private:
     void handle_playlist_select_for_add_input(int ch);
     void handle_playlist_select_for_move_input(int ch);
     void handle_lyrics_input(int ch);
+    void handle_history_input(int ch);
     void handle_intro_input(int ch);
 
 
@@ -115,13 +271,52 @@ private:
     void update_status();
     void update_help();
     
-    void play_next();
+    void play_next(); // autoplay, when a stream ends
+    void play_local_queue(size_t start_index);
+    void play_local_files(const std::vector<LibraryItem>& files, size_t start_index);
+    bool play_stream_queue(const std::vector<TrackRef>& songs, size_t start_index);
+    // Loads one entry of the queue in place of whatever plays
+    bool play_queue_track(int index, bool fetch_lyrics = true);
+    // Gets the entry after the current one ready: appended to mpv for local files, warmed for streams
+    void queue_upcoming();
+    void refresh_history();
+    void apply_session();
+    void save_session();
+    bool play_history_entry(const HistoryEntry& entry, bool resume);
+    void load_stream(const std::string& webpage_url, const std::string& title);
+    void stop_recording();
+    void process_player_events();
+    void poll_startup_queue();
+    void poll_search();
+    void poll_lyrics();
+    void publish_events();
+    void ensure_library_loaded();
+    // Lists a directory of the library, or the roots for ""
+    void open_library_path(const std::string& path);
     
     // Helper to create a window with a border
     WINDOW* create_window(int height, int width, int starty, int startx);
+    static Layout compute_layout(int height, int width);
+    void place_window(WINDOW* win, int height, int width, int starty);
+    void poll_resize();
     
     // Helper for user input
-    std::string get_user_input(const std::string& prompt);
+    // Text prompt drawn over the current view. While it is open it takes the
+    // keys, and the main loop keeps drawing, playing and autoplaying underneath.
+    struct Prompt {
+        bool open = false;
+        std::string title;
+        std::string input;
+        std::function<void(const std::string&)> on_submit;
+        WINDOW* win = nullptr;
+        int y = 0, x = 0, h = 5, w = 40;
+    };
+    Prompt prompt;
+    void open_prompt(const std::string& title, std::function<void(const std::string&)> on_submit);
+    void close_prompt();
+    void draw_prompt();
+    void handle_prompt_input(int ch);
+    void prompt_new_playlist();
 
 };
 
@@ -1,7 +1,6 @@
 #include "utils.hpp"
+#include "subprocess.hpp"
 #include <regex>
-#include <array>
-#include <memory>
 #include <stdexcept>
 #include <iostream>
 
@@ -10,21 +9,21 @@ bool is_url(const std::string& path) {
     return std::regex_search(path, url_regex);
 }
 
-std::string get_youtube_stream_url(const std::string& url) {
-    std::string result;
+ProcessSlots& yt_dlp_slots() {
+    static ProcessSlots slots(4);
+    return slots;
+}
+
+std::string get_youtube_stream_url(const std::string& url, bool low_priority, const std::atomic<bool>* cancel) {
     // Added --force-ipv4 to help with network issues and --no-progress to avoid escape sequences
-    std::string cmd = "yt-dlp --no-progress --force-ipv4 -g -f bestaudio \"" + url + "\" 2>/dev/null";
-    
-    std::unique_ptr<FILE, decltype(&pclose)> pipe(popen(cmd.c_str(), "r"), pclose);
-    if (!pipe) {
-        throw std::runtime_error("popen() failed!");
-    }
-    
-    // Read character by character to handle URLs of any length
-    int c;
-    while ((c = fgetc(pipe.get())) != EOF) {
-        result += static_cast<char>(c);
-    }
+    ProcessOptions options;
+    options.timeout_ms = 60000;
+    options.low_priority = low_priority;
+    // Background resolves share the slots; something about to play never queues behind them
+    if (low_priority) options.slots = &yt_dlp_slots();
+    options.cancel = cancel;
+    ProcessResult run = run_process({"yt-dlp", "--no-progress", "--force-ipv4", "-g", "-f", "bestaudio", url}, options);
+    std::string result = run.output;
     
     // Remove newline at the end
     if (!result.empty() && result.back() == '\n') {
@@ -38,29 +37,16 @@ std::string get_youtube_stream_url(const std::string& url) {
     return result;
 }
 
-std::string get_audio_duration(const std::string& path) {
-    std::string cmd = "ffprobe -v error -show_entries format=duration -of default=noprint_wrappers=1:nokey=1 \"" + path + "\" 2>/dev/null";
-    std::array<char, 128> buffer;
-    std::string result;
-    
-    std::unique_ptr<FILE, decltype(&pclose)> pipe(popen(cmd.c_str(), "r"), pclose);
-    if (!pipe) {
-        return "";
-    }
-    
-    if (fgets(buffer.data(), buffer.size(), pipe.get()) != nullptr) {
-        result = buffer.data();
-    }
-    
-    if (!result.empty() && result.back() == '\n') {
-        result.pop_back();
-    }
+double get_audio_duration(const std::string& path) {
+    ProcessOptions options;
+    options.timeout_ms = 15000;
+    ProcessResult run = run_process({"ffprobe", "-v", "error", "-show_entries", "format=duration",
+                                     "-of", "default=noprint_wrappers=1:nokey=1", path}, options);
     
     try {
-        double seconds = std::stod(result);
-        return format_duration(seconds);
+        return std::stod(run.output);
     } catch (...) {
-        return "";
+        return 0.0;
     }
 }
 
@@ -73,6 +59,24 @@ std::string format_duration(double seconds) {
     return std::string(buffer);
 }
 
+double parse_duration(const std::string& duration) {
+    // "m:ss" or "h:mm:ss", as printed by yt-dlp and format_duration
+    double total = 0.0;
+    size_t start = 0;
+    while (start <= duration.length()) {
+        size_t colon = duration.find(':', start);
+        std::string part = duration.substr(start, colon == std::string::npos ? std::string::npos : colon - start);
+        try {
+            total = total * 60.0 + std::stod(part);
+        } catch (...) {
+            return 0.0;
+        }
+        if (colon == std::string::npos) break;
+        start = colon + 1;
+    }
+    return total;
+}
+
 std::string sanitize_text(const std::string& text) {
     std::string result;
     for (char c : text) {
@@ -83,3 +87,44 @@ std::string sanitize_text(const std::string& text) {
     }
     return result;
 }
+
+std::string json_quote(const std::string& text) {
+    std::string out = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char buffer[8];
+            snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+            out += buffer;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+uint64_t hash_string(const std::string& text) {
+    // FNV-1a, stable across runs so it can name files on disk
+    uint64_t hash = 1469598103934665603ULL;
+    for (char c : text) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+std::string hash_hex(const std::string& text) {
+    char buffer[17];
+    snprintf(buffer, sizeof(buffer), "%016llx", static_cast<unsigned long long>(hash_string(text)));
+    return std::string(buffer);
+}
+
+std::string get_vibe_dir() {
+    const char* home = getenv("HOME");
+    if (home) {
+        return std::string(home) + "/.vibe-fi";
+    }
+    return ".vibe-fi";
+}
@@ -4,13 +4,25 @@
 #include <vector>
 #include <map>
 #include <string>
+#include <cstdint>
+#include <atomic>
 
-
+class ProcessSlots;
 
 bool is_url(const std::string& path);
-std::string get_youtube_stream_url(const std::string& url);
-std::string get_audio_duration(const std::string& path);
+// Gives up, throwing, once *cancel is set
+std::string get_youtube_stream_url(const std::string& url, bool low_priority = false,
+                                   const std::atomic<bool>* cancel = nullptr);
+// Shared cap on concurrent background yt-dlp processes (low-priority resolves, downloads)
+ProcessSlots& yt_dlp_slots();
+double get_audio_duration(const std::string& path);
 std::string format_duration(double seconds);
+double parse_duration(const std::string& duration);
 std::string sanitize_text(const std::string& text);
+// Quoted JSON string literal, control characters escaped
+std::string json_quote(const std::string& text);
+uint64_t hash_string(const std::string& text);
+std::string hash_hex(const std::string& text);
+std::string get_vibe_dir();
 
 #endif // UTILS_HPP
@@ -0,0 +1,35 @@
+#include "waveform.hpp"
+#include <cmath>
+#include <algorithm>
+
+static const double FLOOR_DB = -48.0; // and below is drawn as silence
+
+WaveformReducer::WaveformReducer(int sample_rate) : block(std::max(1, sample_rate / 20)), in_block(0), sum(0.0) {}
+
+void WaveformReducer::feed(const int16_t* samples, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        sum += static_cast<double>(samples[i]) * samples[i];
+        if (++in_block == block) {
+            blocks.push_back(static_cast<float>(std::sqrt(sum / block) / 32768.0));
+            sum = 0.0;
+            in_block = 0;
+        }
+    }
+}
+
+std::vector<uint8_t> WaveformReducer::finish() const {
+    std::vector<uint8_t> out;
+    if (blocks.empty()) return out;
+    out.assign(SLICES, 0);
+    size_t count = blocks.size();
+    for (int slice = 0; slice < SLICES; ++slice) {
+        size_t from = count * slice / SLICES;
+        size_t to = std::max(from + 1, count * (slice + 1) / SLICES);
+        float loudest = 0.0f;
+        for (size_t i = from; i < to && i < count; ++i) loudest = std::max(loudest, blocks[i]);
+        double db = loudest > 0.0f ? 20.0 * std::log10(loudest) : FLOOR_DB;
+        double level = std::max(0.0, std::min(1.0, (db - FLOOR_DB) / -FLOOR_DB));
+        out[slice] = static_cast<uint8_t>(level * 255.0 + 0.5);
+    }
+    return out;
+}
@@ -0,0 +1,28 @@
+#ifndef WAVEFORM_HPP
+#define WAVEFORM_HPP
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// Mini-waveforms for the seek bar, reduced from mono 16-bit audio as it is
+// decoded: the RMS of 50 ms blocks, then SLICES levels on a 48 dB scale, each
+// slice showing its loudest block so short hits stay visible. Only the block
+// energies are kept, a few KB even for an hour-long mix.
+class WaveformReducer {
+public:
+    static const int SLICES = 200;
+
+    explicit WaveformReducer(int sample_rate);
+    void feed(const int16_t* samples, size_t count);
+    // Empty if not even one block was fed
+    std::vector<uint8_t> finish() const;
+
+private:
+    int block; // samples per 50 ms
+    int in_block;
+    double sum;
+    std::vector<float> blocks;
+};
+
+#endif // WAVEFORM_HPP